@@ -0,0 +1,1300 @@
+#include "accelerators/bvh.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+#include <functional>
+
+#include "core/ray.h"
+#include "core/vec3.h"
+#include "core/bounds3.h"
+#include "core/shape.h"
+#include "core/error.h"
+#include "core/parallel.h"
+#include "core/morton.h"
+#include "core/render_stats.h"
+#include "core/trace.h"
+
+namespace lux {
+  namespace {
+    // Limited by the width of BVH_node::num_shapes
+    const unsigned kmax_leaf_shapes = 0xffff;
+
+    // Relative costs of visiting a node and of intersecting a shape, used by the SAH
+    const float ktraversal_cost = 0.125f;
+    const float kintersection_cost = 1.0f;
+
+    // Subtrees smaller than this are always built by the thread that reached them
+    const std::size_t kmin_task_shapes = 4096;
+
+    // Nodes with at least this many shapes have their bounds and SAH bins computed in parallel
+    const std::size_t kmin_parallel_binning_shapes = 1 << 16;
+
+    const unsigned knum_buckets = 12;
+    const unsigned knum_spatial_bins = 32;
+
+    // Quantized leaf references set the top bit, then pack the number of shapes minus one
+    // into the next 4 bits and the offset of the first shape into the remaining 27.
+    const std::uint32_t kleaf_ref_flag = 0x80000000u;
+    const unsigned kleaf_ref_count_shift = 27;
+    const std::uint32_t kmax_leaf_ref_shapes = 16;
+    const std::uint32_t kmax_leaf_ref_offset = (1u << kleaf_ref_count_shift) - 1;
+    const unsigned kmax_quantized = 255;
+
+    struct Build_shape_info {
+      Build_shape_info() : primitive(), bounds(), centroid() {}
+      Build_shape_info(const BVH_primitive & primitive, const Bounds3 & bounds)
+          : primitive(primitive), bounds(bounds), centroid(bounds.centroid()) {}
+
+      BVH_primitive primitive;
+      Bounds3 bounds;
+      Vec3 centroid;
+    };
+
+    // Nodes and leaf references of a subtree. Leaves index leaf_refs, except for builders
+    // that reorder the shape list in place, which leave it empty.
+    struct Build_output {
+      std::vector<BVH_node> nodes;
+      std::vector<Build_shape_info> leaf_refs;
+    };
+
+    struct Build_context {
+      Build_context(const std::vector<std::shared_ptr<Shape>> & shapes,
+                    const std::size_t num_primitives, const BVH_build_options & options)
+          : shapes(shapes),
+            options(options),
+            num_threads(options.num_threads ? options.num_threads : num_system_cores()),
+            max_task_depth(0),
+            num_references(num_primitives),
+            max_references(num_primitives * (1.0f + std::max(0.0f, options.max_reference_growth))),
+            min_overlap_area(0.0f)
+      {
+        // A few more tasks than threads, so the threads stay busy on unbalanced trees
+        for (unsigned n = 1; n < num_threads; n *= 2) ++max_task_depth;
+        if (max_task_depth) max_task_depth += 2;
+      }
+
+      const std::vector<std::shared_ptr<Shape>> & shapes;
+      const BVH_build_options & options;
+      unsigned num_threads;
+      unsigned max_task_depth;
+      std::atomic<std::size_t> num_references;
+      std::size_t max_references;
+      float min_overlap_area;
+    };
+
+    typedef std::function<void(Build_output &)> Subtree_builder;
+
+    struct Object_split {
+      Object_split()
+          : axis(0), bucket(0), cost(std::numeric_limits<float>::infinity()),
+            centroid_min(0.0f), bucket_scale(0.0f), left_bounds(), right_bounds() {}
+
+      unsigned bucket_of(const Build_shape_info & info) const
+      {
+        const unsigned kb = (info.centroid[axis] - centroid_min) * bucket_scale;
+        return std::min(kb, knum_buckets - 1);
+      }
+
+      unsigned axis;
+      unsigned bucket;    // Last bucket of the left child
+      float cost;         // Sum of the children surface areas weighted by their shape counts
+      float centroid_min;
+      float bucket_scale;
+      Bounds3 left_bounds;
+      Bounds3 right_bounds;
+    };
+
+    struct Spatial_split {
+      Spatial_split() : axis(0), position(0.0f), cost(std::numeric_limits<float>::infinity()) {}
+
+      unsigned axis;
+      float position;
+      float cost;
+    };
+
+    inline std::uint32_t make_leaf_ref(const std::uint32_t shapes_offset,
+                                       const std::uint32_t num_shapes)
+    {
+      return kleaf_ref_flag | ((num_shapes - 1) << kleaf_ref_count_shift) | shapes_offset;
+    }
+
+    inline std::uint32_t leaf_ref_offset(const std::uint32_t ref)
+    {
+      return ref & kmax_leaf_ref_offset;
+    }
+
+    inline std::uint32_t leaf_ref_num_shapes(const std::uint32_t ref)
+    {
+      return ((ref & ~kleaf_ref_flag) >> kleaf_ref_count_shift) + 1;
+    }
+
+    // Builds 2^exponent from its bits, exponent must be a normal float exponent
+    inline float exponent_to_scale(const int exponent)
+    {
+      const std::uint32_t kbits = static_cast<std::uint32_t>(exponent + 127) << 23;
+      float scale;
+      std::memcpy(&scale, &kbits, sizeof(scale));
+
+      return scale;
+    }
+
+    // Encoding checks its results with the same arithmetic traversal decodes them with
+    inline float dequantize(const float origin, const float scale, const unsigned q)
+    {
+      return origin + q * scale;
+    }
+
+    inline void dequantize_children(const BVH_quantized_node & node, Bounds3 children[2])
+    {
+      const Vec3 kscale(exponent_to_scale(node.scale_exponent[0]),
+                        exponent_to_scale(node.scale_exponent[1]),
+                        exponent_to_scale(node.scale_exponent[2]));
+      for (unsigned i = 0; i != 2; ++i) {
+        for (unsigned axis = 0; axis != 3; ++axis) {
+          children[i].p_min[axis] = dequantize(node.origin[axis], kscale[axis],
+                                               node.child_min[i][axis]);
+          children[i].p_max[axis] = dequantize(node.origin[axis], kscale[axis],
+                                               node.child_max[i][axis]);
+        }
+      }
+    }
+
+    // Smallest power of two scale that maps [origin, max] into kmax_quantized steps
+    int choose_scale_exponent(const float origin, const float max)
+    {
+      int exponent = -126;
+      if (max > origin) {
+        std::frexp((max - origin) / kmax_quantized, &exponent);
+        exponent = std::max(exponent, -126);
+      }
+      while (dequantize(origin, exponent_to_scale(exponent), kmax_quantized) < max) ++exponent;
+      ASSERT(exponent <= 127, "BVH bounds too large to be quantized");
+
+      return exponent;
+    }
+
+    // Sorts one chunk per thread, then merges the sorted chunks pairwise.
+    void parallel_sort(std::vector<std::uint64_t> & keys, const unsigned num_threads)
+    {
+      const std::size_t kcount = keys.size();
+      const std::size_t kchunk_size = (kcount + num_threads - 1) / num_threads;
+
+      parallel_for(kcount, [&](std::size_t first, std::size_t last)
+          {
+            std::sort(keys.begin() + first, keys.begin() + last);
+          }, num_threads);
+
+      for (std::size_t width = kchunk_size; width < kcount; width *= 2) {
+        for (std::size_t first = 0; first + width < kcount; first += 2 * width) {
+          std::inplace_merge(keys.begin() + first, keys.begin() + first + width,
+                             keys.begin() + std::min(kcount, first + 2 * width));
+        }
+      }
+    }
+
+    // Builds the two children of nodes[node_index]. When kspawn is set the second subtree
+    // is built on another thread into its own output, which is then appended after the
+    // first subtree with its child and leaf offsets rebased.
+    void build_children(const std::uint32_t node_index, const bool kspawn,
+                        const Subtree_builder & build_first,
+                        const Subtree_builder & build_second,
+                        Build_output & output)
+    {
+      if (!kspawn) {
+        build_first(output);
+        output.nodes[node_index].second_child_offset = output.nodes.size();
+        build_second(output);
+
+        return;
+      }
+
+      Build_output second_output;
+      std::future<void> second = std::async(std::launch::async, build_second,
+                                            std::ref(second_output));
+      build_first(output);
+      second.get();
+
+      const std::uint32_t knode_base = output.nodes.size();
+      const std::uint32_t kref_base = output.leaf_refs.size();
+      output.nodes[node_index].second_child_offset = knode_base;
+      for (std::size_t i = 0; i != second_output.nodes.size(); ++i) {
+        BVH_node & node = second_output.nodes[i];
+        if (node.num_shapes == 0) {
+          node.second_child_offset += knode_base;
+        }
+        else if (!second_output.leaf_refs.empty()) {
+          node.shapes_offset += kref_base;
+        }
+        output.nodes.push_back(node);
+      }
+      output.leaf_refs.insert(output.leaf_refs.end(), second_output.leaf_refs.begin(),
+                              second_output.leaf_refs.end());
+    }
+
+    // Bounds of the shapes and of their centroids over info[0, count).
+    void compute_bounds(const Build_shape_info * info, const std::size_t count,
+                        const unsigned num_threads, Bounds3 * pbounds,
+                        Bounds3 * pcentroid_bounds)
+    {
+      std::mutex merge_mutex;
+      parallel_for(count, [&](std::size_t first, std::size_t last)
+          {
+            Bounds3 local_bounds;
+            Bounds3 local_centroid_bounds;
+            for (std::size_t i = first; i != last; ++i) {
+              local_bounds = bounds_union(local_bounds, info[i].bounds);
+              local_centroid_bounds = bounds_union(local_centroid_bounds, info[i].centroid);
+            }
+
+            std::lock_guard<std::mutex> lock(merge_mutex);
+            *pbounds = bounds_union(*pbounds, local_bounds);
+            *pcentroid_bounds = bounds_union(*pcentroid_bounds, local_centroid_bounds);
+          }, num_threads);
+    }
+
+    // Bins the centroids along the widest axis of centroid_bounds and finds the bucket
+    // boundary with the smallest SAH cost.
+    Object_split find_object_split(const Build_shape_info * info, const std::size_t count,
+                                   const Bounds3 & centroid_bounds, const unsigned num_threads)
+    {
+      Object_split split;
+      split.axis = centroid_bounds.maximum_extent();
+      split.centroid_min = centroid_bounds.p_min[split.axis];
+      split.bucket_scale = knum_buckets /
+                           (centroid_bounds.p_max[split.axis] - split.centroid_min);
+
+      Bounds3 bucket_bounds[knum_buckets];
+      std::size_t bucket_count[knum_buckets] = {};
+      std::mutex merge_mutex;
+      parallel_for(count, [&](std::size_t first, std::size_t last)
+          {
+            Bounds3 local_bounds[knum_buckets];
+            std::size_t local_count[knum_buckets] = {};
+            for (std::size_t i = first; i != last; ++i) {
+              const unsigned kb = split.bucket_of(info[i]);
+              ++local_count[kb];
+              local_bounds[kb] = bounds_union(local_bounds[kb], info[i].bounds);
+            }
+
+            std::lock_guard<std::mutex> lock(merge_mutex);
+            for (unsigned b = 0; b != knum_buckets; ++b) {
+              bucket_count[b] += local_count[b];
+              bucket_bounds[b] = bounds_union(bucket_bounds[b], local_bounds[b]);
+            }
+          }, num_threads);
+
+      // Sweep from the right, then from the left, to get the cost of every split in
+      // O(buckets)
+      Bounds3 right_bounds[knum_buckets];
+      std::size_t right_count[knum_buckets];
+      Bounds3 accumulated;
+      std::size_t accumulated_count = 0;
+      for (unsigned b = knum_buckets - 1; b != 0; --b) {
+        accumulated = bounds_union(accumulated, bucket_bounds[b]);
+        accumulated_count += bucket_count[b];
+        right_bounds[b] = accumulated;
+        right_count[b] = accumulated_count;
+      }
+
+      accumulated = Bounds3();
+      accumulated_count = 0;
+      for (unsigned b = 0; b != knum_buckets - 1; ++b) {
+        accumulated = bounds_union(accumulated, bucket_bounds[b]);
+        accumulated_count += bucket_count[b];
+        const float kcost = accumulated_count * accumulated.surface_area() +
+                            right_count[b + 1] * right_bounds[b + 1].surface_area();
+        if (kcost < split.cost) {
+          split.cost = kcost;
+          split.bucket = b;
+          split.left_bounds = accumulated;
+          split.right_bounds = right_bounds[b + 1];
+        }
+      }
+
+      return split;
+    }
+
+    // Clips the part of the referenced shape inside clip, keeping the result inside the
+    // reference's current bounds.
+    Build_shape_info clip_reference(const Build_context & context, const Build_shape_info & ref,
+                                    const Bounds3 & clip)
+    {
+      const Bounds3 kclip = bounds_intersect(ref.bounds, clip);
+      if (kclip.is_empty()) return Build_shape_info(ref.primitive, kclip);
+
+      const Bounds3 kbounds = context.shapes[ref.primitive.shape]->clipped_primitive_bound(
+          ref.primitive.primitive, kclip);
+      return Build_shape_info(ref.primitive, bounds_intersect(kbounds, kclip));
+    }
+
+    // Bins the references' clipped bounds between planes along every axis, finding the
+    // plane with the smallest SAH cost.
+    Spatial_split find_spatial_split(const Build_context & context,
+                                     const std::vector<Build_shape_info> & refs,
+                                     const Bounds3 & bounds)
+    {
+      Spatial_split split;
+      for (unsigned axis = 0; axis != 3; ++axis) {
+        const float kmin = bounds.p_min[axis];
+        const float kextent = bounds.p_max[axis] - kmin;
+        if (kextent <= 0.0f) continue;
+
+        const float kbin_width = kextent / knum_spatial_bins;
+        const float kinv_bin_width = 1.0f / kbin_width;
+        const auto bin_of = [&](const float x)
+            {
+              const int kb = static_cast<int>((x - kmin) * kinv_bin_width);
+              return static_cast<unsigned>(std::min(std::max(kb, 0),
+                                                    static_cast<int>(knum_spatial_bins) - 1));
+            };
+
+        Bounds3 bin_bounds[knum_spatial_bins];
+        std::size_t entries[knum_spatial_bins] = {};
+        std::size_t exits[knum_spatial_bins] = {};
+        for (std::size_t i = 0; i != refs.size(); ++i) {
+          const unsigned kfirst_bin = bin_of(refs[i].bounds.p_min[axis]);
+          const unsigned klast_bin = bin_of(refs[i].bounds.p_max[axis]);
+          ++entries[kfirst_bin];
+          ++exits[klast_bin];
+
+          if (kfirst_bin == klast_bin) {
+            bin_bounds[kfirst_bin] = bounds_union(bin_bounds[kfirst_bin], refs[i].bounds);
+            continue;
+          }
+
+          for (unsigned b = kfirst_bin; b <= klast_bin; ++b) {
+            Bounds3 slab = bounds;
+            slab.p_min[axis] = kmin + b * kbin_width;
+            slab.p_max[axis] = (b == knum_spatial_bins - 1) ? bounds.p_max[axis]
+                                                            : kmin + (b + 1) * kbin_width;
+            bin_bounds[b] = bounds_union(bin_bounds[b],
+                                         clip_reference(context, refs[i], slab).bounds);
+          }
+        }
+
+        Bounds3 right_bounds[knum_spatial_bins];
+        std::size_t right_count[knum_spatial_bins];
+        Bounds3 accumulated;
+        std::size_t accumulated_count = 0;
+        for (unsigned b = knum_spatial_bins - 1; b != 0; --b) {
+          accumulated = bounds_union(accumulated, bin_bounds[b]);
+          accumulated_count += exits[b];
+          right_bounds[b] = accumulated;
+          right_count[b] = accumulated_count;
+        }
+
+        accumulated = Bounds3();
+        accumulated_count = 0;
+        for (unsigned b = 0; b != knum_spatial_bins - 1; ++b) {
+          accumulated = bounds_union(accumulated, bin_bounds[b]);
+          accumulated_count += entries[b];
+          const float kcost = accumulated_count * accumulated.surface_area() +
+                              right_count[b + 1] * right_bounds[b + 1].surface_area();
+          if (kcost < split.cost) {
+            split.cost = kcost;
+            split.axis = axis;
+            split.position = kmin + (b + 1) * kbin_width;
+          }
+        }
+      }
+
+      return split;
+    }
+
+    std::uint32_t make_leaf(const Bounds3 & bounds, const std::uint32_t shapes_offset,
+                            const std::size_t num_shapes, Build_output & output)
+    {
+      BVH_node leaf;
+      leaf.bounds = bounds;
+      leaf.shapes_offset = shapes_offset;
+      leaf.num_shapes = num_shapes;
+      leaf.axis = 0;
+      leaf.pad = 0;
+      output.nodes.push_back(leaf);
+
+      return output.nodes.size() - 1;
+    }
+
+    std::uint32_t make_interior(const Bounds3 & bounds, const unsigned axis,
+                                Build_output & output)
+    {
+      BVH_node node;
+      node.bounds = bounds;
+      node.second_child_offset = 0;
+      node.num_shapes = 0;
+      node.axis = axis;
+      node.pad = 0;
+      output.nodes.push_back(node);
+
+      return output.nodes.size() - 1;
+    }
+
+    // Binned SAH over shape_info[start, end), which is partitioned in place.
+    std::uint32_t sah_build(const Build_context & context,
+                            std::vector<Build_shape_info> & shape_info,
+                            const std::size_t start, const std::size_t end,
+                            const unsigned depth, Build_output & output)
+    {
+      const std::size_t knum_shapes = end - start;
+      const unsigned knum_binning_threads =
+          (knum_shapes >= kmin_parallel_binning_shapes) ? std::max(1u, context.num_threads >> depth)
+                                                       : 1;
+
+      Bounds3 bounds;
+      Bounds3 centroid_bounds;
+      compute_bounds(&shape_info[start], knum_shapes, knum_binning_threads, &bounds,
+                     &centroid_bounds);
+
+      unsigned axis = centroid_bounds.maximum_extent();
+
+      // A single shape, or all centroids on the same spot
+      bool leaf = knum_shapes == 1 || centroid_bounds.p_max[axis] == centroid_bounds.p_min[axis];
+
+      std::size_t mid = (start + end) / 2;
+      if (!leaf && knum_shapes <= 2) {
+        std::nth_element(&shape_info[start], &shape_info[mid], &shape_info[end - 1] + 1,
+                         [axis](const Build_shape_info & a, const Build_shape_info & b)
+                         {
+                           return a.centroid[axis] < b.centroid[axis];
+                         });
+      }
+      else if (!leaf) {
+        const Object_split ksplit = find_object_split(&shape_info[start], knum_shapes,
+                                                      centroid_bounds, knum_binning_threads);
+        const float kbounds_area = bounds.surface_area();
+        const float kleaf_cost = knum_shapes * kintersection_cost;
+        const float ksplit_cost = ktraversal_cost + ((kbounds_area > 0.0f) ?
+                                  kintersection_cost * ksplit.cost / kbounds_area : 0.0f);
+
+        if (knum_shapes > context.options.max_shapes_in_node || ksplit_cost < kleaf_cost) {
+          Build_shape_info * pmid = std::partition(&shape_info[start], &shape_info[end - 1] + 1,
+              [&ksplit](const Build_shape_info & info)
+              {
+                return ksplit.bucket_of(info) <= ksplit.bucket;
+              });
+          mid = pmid - &shape_info[0];
+          if (mid == start || mid == end) mid = (start + end) / 2;
+        }
+        else {
+          leaf = true;
+        }
+      }
+
+      if (leaf && knum_shapes > kmax_leaf_shapes) {
+        // Coincident centroids can't be separated by the SAH, split them in half
+        leaf = false;
+        mid = (start + end) / 2;
+      }
+
+      if (leaf) return make_leaf(bounds, start, knum_shapes, output);
+
+      const std::uint32_t knode_index = make_interior(bounds, axis, output);
+      const bool kspawn = depth < context.max_task_depth && knum_shapes >= kmin_task_shapes;
+      build_children(knode_index, kspawn,
+          [&](Build_output & child_output)
+          {
+            sah_build(context, shape_info, start, mid, depth + 1, child_output);
+          },
+          [&](Build_output & child_output)
+          {
+            sah_build(context, shape_info, mid, end, depth + 1, child_output);
+          }, output);
+
+      return knode_index;
+    }
+
+    // Linear BVH over shape_info[start, end), already sorted by Morton code.
+    std::uint32_t lbvh_build(const Build_context & context,
+                             const std::vector<Build_shape_info> & shape_info,
+                             const std::vector<std::uint32_t> & morton_codes,
+                             const std::size_t start, const std::size_t end,
+                             const int bit, const unsigned depth, Build_output & output)
+    {
+      const std::size_t knum_shapes = end - start;
+
+      // The shapes are sorted, so they are split where the current bit of their code changes
+      std::size_t mid = start;
+      int split_bit = bit;
+      if (knum_shapes > context.options.max_shapes_in_node) {
+        for (; split_bit >= 0; --split_bit) {
+          const std::uint32_t kmask = 1u << split_bit;
+          if ((morton_codes[start] & kmask) == (morton_codes[end - 1] & kmask)) continue;
+
+          mid = std::upper_bound(&morton_codes[start], &morton_codes[end - 1] + 1,
+                                 morton_codes[start] | (kmask - 1)) - &morton_codes[0];
+          break;
+        }
+
+        // Identical codes, fall back to an even split unless they fit in a leaf
+        if (split_bit < 0 && knum_shapes > kmax_leaf_shapes) mid = (start + end) / 2;
+      }
+
+      if (mid == start) {
+        Bounds3 bounds;
+        for (std::size_t i = start; i != end; ++i) {
+          bounds = bounds_union(bounds, shape_info[i].bounds);
+        }
+
+        return make_leaf(bounds, start, knum_shapes, output);
+      }
+
+      // Morton codes interleave the axes as ...zyxzyx
+      const std::uint32_t knode_index =
+          make_interior(Bounds3(), (split_bit >= 0) ? split_bit % 3 : 0, output);
+
+      const bool kspawn = depth < context.max_task_depth && knum_shapes >= kmin_task_shapes;
+      Bounds3 second_bounds;
+      build_children(knode_index, kspawn,
+          [&](Build_output & child_output)
+          {
+            lbvh_build(context, shape_info, morton_codes, start, mid, split_bit - 1, depth + 1,
+                       child_output);
+          },
+          [&](Build_output & child_output)
+          {
+            const std::uint32_t kroot = lbvh_build(context, shape_info, morton_codes, mid, end,
+                                                   split_bit - 1, depth + 1, child_output);
+            second_bounds = child_output.nodes[kroot].bounds;
+          }, output);
+
+      BVH_node & node = output.nodes[knode_index];
+      node.bounds = bounds_union(output.nodes[knode_index + 1].bounds, second_bounds);
+
+      return knode_index;
+    }
+
+    // SAH with spatial splits. References may be duplicated on both children, so each
+    // node owns its reference list and leaves copy theirs to the output.
+    std::uint32_t sbvh_build(Build_context & context, std::vector<Build_shape_info> & refs,
+                             const unsigned depth, Build_output & output)
+    {
+      const std::size_t knum_refs = refs.size();
+
+      Bounds3 bounds;
+      Bounds3 centroid_bounds;
+      compute_bounds(&refs[0], knum_refs, 1, &bounds, &centroid_bounds);
+
+      const unsigned kcentroid_axis = centroid_bounds.maximum_extent();
+      const bool kcoincident = centroid_bounds.p_max[kcentroid_axis] ==
+                               centroid_bounds.p_min[kcentroid_axis];
+
+      const float kbounds_area = bounds.surface_area();
+      const float kinv_bounds_area = (kbounds_area > 0.0f) ? 1.0f / kbounds_area : 0.0f;
+      float best_cost = knum_refs * kintersection_cost;
+      bool must_split = knum_refs > context.options.max_shapes_in_node;
+
+      Object_split object_split;
+      bool use_object_split = false;
+      if (knum_refs > 1 && !kcoincident) {
+        object_split = find_object_split(&refs[0], knum_refs, centroid_bounds, 1);
+        const float kcost = ktraversal_cost +
+                            kintersection_cost * object_split.cost * kinv_bounds_area;
+        if (kcost < best_cost || must_split) {
+          best_cost = kcost;
+          use_object_split = true;
+        }
+      }
+
+      // Only look for spatial splits where the object split children overlap noticeably
+      Spatial_split spatial_split;
+      bool use_spatial_split = false;
+      const float koverlap_area = use_object_split ?
+          bounds_intersect(object_split.left_bounds, object_split.right_bounds).surface_area() :
+          kbounds_area;
+      if (knum_refs > 1 && koverlap_area > context.min_overlap_area &&
+          context.num_references < context.max_references) {
+        spatial_split = find_spatial_split(context, refs, bounds);
+        const float kcost = ktraversal_cost +
+                            kintersection_cost * spatial_split.cost * kinv_bounds_area;
+        if (kcost < best_cost || (must_split && !use_object_split &&
+                                  spatial_split.cost < std::numeric_limits<float>::infinity())) {
+          best_cost = kcost;
+          use_spatial_split = true;
+        }
+      }
+
+      std::vector<Build_shape_info> left;
+      std::vector<Build_shape_info> right;
+      unsigned axis = kcentroid_axis;
+
+      if (use_spatial_split) {
+        axis = spatial_split.axis;
+        const float kposition = spatial_split.position;
+        std::size_t num_duplicated = 0;
+        for (std::size_t i = 0; i != knum_refs; ++i) {
+          const Build_shape_info & ref = refs[i];
+          if (ref.bounds.p_max[axis] <= kposition) {
+            left.push_back(ref);
+          }
+          else if (ref.bounds.p_min[axis] >= kposition) {
+            right.push_back(ref);
+          }
+          else {
+            Bounds3 left_clip = ref.bounds;
+            Bounds3 right_clip = ref.bounds;
+            left_clip.p_max[axis] = kposition;
+            right_clip.p_min[axis] = kposition;
+
+            const Build_shape_info kleft_ref = clip_reference(context, ref, left_clip);
+            const Build_shape_info kright_ref = clip_reference(context, ref, right_clip);
+            if (!kleft_ref.bounds.is_empty()) left.push_back(kleft_ref);
+            if (!kright_ref.bounds.is_empty()) right.push_back(kright_ref);
+            if (!kleft_ref.bounds.is_empty() && !kright_ref.bounds.is_empty()) ++num_duplicated;
+          }
+        }
+
+        if (left.empty() || right.empty()) {
+          use_spatial_split = false;
+          left.clear();
+          right.clear();
+        }
+        else {
+          context.num_references += num_duplicated;
+        }
+      }
+
+      if (!use_spatial_split && use_object_split) {
+        axis = object_split.axis;
+        for (std::size_t i = 0; i != knum_refs; ++i) {
+          if (object_split.bucket_of(refs[i]) <= object_split.bucket) {
+            left.push_back(refs[i]);
+          }
+          else {
+            right.push_back(refs[i]);
+          }
+        }
+      }
+
+      if ((left.empty() || right.empty()) && knum_refs > kmax_leaf_shapes) {
+        // Coincident centroids can't be separated by the SAH, split them in half
+        left.assign(refs.begin(), refs.begin() + knum_refs / 2);
+        right.assign(refs.begin() + knum_refs / 2, refs.end());
+      }
+
+      if (left.empty() || right.empty()) {
+        const std::uint32_t koffset = output.leaf_refs.size();
+        output.leaf_refs.insert(output.leaf_refs.end(), refs.begin(), refs.end());
+
+        return make_leaf(bounds, koffset, knum_refs, output);
+      }
+
+      // The node's list is no longer needed once split
+      std::vector<Build_shape_info>().swap(refs);
+
+      const std::uint32_t knode_index = make_interior(bounds, axis, output);
+      const bool kspawn = depth < context.max_task_depth &&
+                          left.size() + right.size() >= kmin_task_shapes;
+      build_children(knode_index, kspawn,
+          [&](Build_output & child_output)
+          {
+            sbvh_build(context, left, depth + 1, child_output);
+          },
+          [&](Build_output & child_output)
+          {
+            sbvh_build(context, right, depth + 1, child_output);
+          }, output);
+
+      return knode_index;
+    }
+  }
+
+  bool parse_bvh_builder(const std::string & name, BVH_builder * pbuilder)
+  {
+    if (name == "sah") *pbuilder = BVH_builder::ksah;
+    else if (name == "lbvh") *pbuilder = BVH_builder::klbvh;
+    else if (name == "sbvh") *pbuilder = BVH_builder::kspatial_sah;
+    else return false;
+
+    return true;
+  }
+
+  std::ostream & operator<<(std::ostream & os, const BVH_build_stats & stats)
+  {
+    os << stats.num_nodes << " nodes, " << stats.num_leaves << " leaves, "
+       << stats.num_references << " references, max depth " << stats.max_depth
+       << ", SAH cost " << stats.sah_cost << ", " << stats.memory_bytes / 1024 << " KiB"
+       << ", built in " << stats.build_seconds * 1000.0 << " ms";
+
+    return os;
+  }
+
+  BVH::BVH(const std::vector<std::shared_ptr<Shape>> & shapes, const BVH_build_options & options)
+      : m_options(options),
+        m_bounds(),
+        m_shapes(shapes),
+        m_nodes(),
+        m_primitives(),
+        m_quantized_nodes(),
+        m_quantized_root(0),
+        m_build_stats()
+  {
+    // Shapes of many primitives, like meshes, get a reference per primitive
+    std::vector<std::size_t> first_primitives(shapes.size() + 1, 0);
+    for (std::size_t i = 0; i != shapes.size(); ++i) {
+      first_primitives[i + 1] = first_primitives[i] + shapes[i]->num_primitives();
+    }
+    const std::size_t knum_primitives = first_primitives.back();
+    if (knum_primitives == 0) return;
+
+    TRACE_SCOPE_ARG("BVH build", "primitives", knum_primitives);
+    const std::chrono::steady_clock::time_point kstart = std::chrono::steady_clock::now();
+
+    Build_context context(shapes, knum_primitives, m_options);
+
+    std::vector<Build_shape_info> shape_info(knum_primitives);
+    parallel_for(knum_primitives, [&](std::size_t first, std::size_t last)
+        {
+          std::uint32_t shape = std::upper_bound(first_primitives.begin(),
+                                                 first_primitives.end(), first) -
+                                first_primitives.begin() - 1;
+          for (std::size_t i = first; i != last; ++i) {
+            while (i == first_primitives[shape + 1]) ++shape;
+            const BVH_primitive kprimitive = { shape,
+                                               static_cast<std::uint32_t>(
+                                                   i - first_primitives[shape]) };
+            shape_info[i] = Build_shape_info(
+                kprimitive, shapes[shape]->primitive_world_bound(kprimitive.primitive));
+          }
+        }, context.num_threads);
+
+    Build_output output;
+    output.nodes.reserve(2 * knum_primitives);
+
+    if (m_options.builder == BVH_builder::klbvh) {
+      // Sort the shapes along a Morton curve over their centroids
+      Bounds3 bounds;
+      Bounds3 centroid_bounds;
+      compute_bounds(&shape_info[0], shape_info.size(), context.num_threads, &bounds,
+                     &centroid_bounds);
+
+      std::vector<std::uint64_t> keys(shape_info.size());
+      parallel_for(shape_info.size(), [&](std::size_t first, std::size_t last)
+          {
+            for (std::size_t i = first; i != last; ++i) {
+              const std::uint64_t kcode =
+                  morton_code_3D(centroid_bounds.offset(shape_info[i].centroid));
+              keys[i] = (kcode << 32) | i;
+            }
+          }, context.num_threads);
+
+      parallel_sort(keys, context.num_threads);
+
+      std::vector<Build_shape_info> sorted_info;
+      std::vector<std::uint32_t> morton_codes;
+      sorted_info.reserve(keys.size());
+      morton_codes.reserve(keys.size());
+      for (std::size_t i = 0; i != keys.size(); ++i) {
+        sorted_info.push_back(shape_info[keys[i] & 0xffffffff]);
+        morton_codes.push_back(keys[i] >> 32);
+      }
+      shape_info.swap(sorted_info);
+
+      lbvh_build(context, shape_info, morton_codes, 0, shape_info.size(), 29, 0, output);
+    }
+    else if (m_options.builder == BVH_builder::kspatial_sah) {
+      Bounds3 root_bounds;
+      for (std::size_t i = 0; i != shape_info.size(); ++i) {
+        root_bounds = bounds_union(root_bounds, shape_info[i].bounds);
+      }
+      context.min_overlap_area = m_options.min_split_overlap * root_bounds.surface_area();
+
+      sbvh_build(context, shape_info, 0, output);
+      shape_info.swap(output.leaf_refs);
+    }
+    else {
+      sah_build(context, shape_info, 0, shape_info.size(), 0, output);
+    }
+
+    // Leaves are emitted from left to right, so shape_info now holds the primitive
+    // references in the order the leaves use them.
+    m_nodes.swap(output.nodes);
+    m_primitives.reserve(shape_info.size());
+    for (std::size_t i = 0; i != shape_info.size(); ++i) {
+      m_primitives.push_back(shape_info[i].primitive);
+    }
+
+    m_bounds = m_nodes[0].bounds;
+    compute_build_stats();
+
+    if (m_options.quantize_nodes) quantize();
+
+    const std::chrono::duration<double> kelapsed = std::chrono::steady_clock::now() - kstart;
+    m_build_stats.build_seconds = kelapsed.count();
+  }
+
+  BVH::BVH(const std::vector<std::shared_ptr<Shape>> & shapes,
+           std::vector<BVH_primitive> primitives, std::vector<BVH_node> nodes,
+           const BVH_build_options & options)
+      : m_options(options),
+        m_bounds(),
+        m_shapes(shapes),
+        m_nodes(),
+        m_primitives(),
+        m_quantized_nodes(),
+        m_quantized_root(0),
+        m_build_stats()
+  {
+    m_nodes.swap(nodes);
+    m_primitives.swap(primitives);
+    if (m_nodes.empty()) return;
+
+    TRACE_SCOPE_ARG("BVH load", "nodes", m_nodes.size());
+    m_bounds = m_nodes[0].bounds;
+    compute_build_stats();
+
+    if (m_options.quantize_nodes) quantize();
+  }
+
+  Bounds3 BVH::world_bound() const
+  {
+    return m_bounds;
+  }
+
+  bool BVH::refit()
+  {
+    if (is_quantized()) return false;
+    if (m_nodes.empty()) return true;
+
+    // Children are always stored after their parent, so a reverse sweep updates
+    // every child before the node that bounds it.
+    for (std::size_t i = m_nodes.size(); i-- != 0;) {
+      BVH_node & node = m_nodes[i];
+      if (node.num_shapes > 0) {
+        node.bounds = Bounds3();
+        for (std::uint32_t j = 0; j != node.num_shapes; ++j) {
+          const BVH_primitive & kprimitive = m_primitives[node.shapes_offset + j];
+          node.bounds = bounds_union(node.bounds, m_shapes[kprimitive.shape]->primitive_world_bound(
+                                                      kprimitive.primitive));
+        }
+      }
+      else {
+        node.bounds = bounds_union(m_nodes[i + 1].bounds, m_nodes[node.second_child_offset].bounds);
+      }
+    }
+    m_bounds = m_nodes[0].bounds;
+
+    const double kbuild_seconds = m_build_stats.build_seconds;
+    compute_build_stats();
+    m_build_stats.build_seconds = kbuild_seconds;
+
+    return true;
+  }
+
+  void BVH::compute_build_stats()
+  {
+    m_build_stats.num_nodes = m_nodes.size();
+    m_build_stats.num_leaves = 0;
+    m_build_stats.num_references = m_primitives.size();
+    m_build_stats.max_depth = 0;
+    m_build_stats.sah_cost = 0.0f;
+    m_build_stats.memory_bytes = memory_bytes();
+
+    const float kroot_area = m_nodes[0].bounds.surface_area();
+    const float kinv_root_area = (kroot_area > 0.0f) ? 1.0f / kroot_area : 0.0f;
+
+    // Depth of every node pending a visit, nodes are stored in depth first order
+    std::vector<std::pair<std::uint32_t, unsigned>> to_visit(1, std::make_pair(0u, 0u));
+    while (!to_visit.empty()) {
+      const std::uint32_t kindex = to_visit.back().first;
+      const unsigned kdepth = to_visit.back().second;
+      to_visit.pop_back();
+
+      const BVH_node & node = m_nodes[kindex];
+      const float karea_ratio = node.bounds.surface_area() * kinv_root_area;
+      m_build_stats.max_depth = std::max(m_build_stats.max_depth, kdepth);
+
+      if (node.num_shapes > 0) {
+        ++m_build_stats.num_leaves;
+        m_build_stats.sah_cost += karea_ratio * node.num_shapes * kintersection_cost;
+      }
+      else {
+        m_build_stats.sah_cost += karea_ratio * ktraversal_cost;
+        to_visit.push_back(std::make_pair(kindex + 1, kdepth + 1));
+        to_visit.push_back(std::make_pair(node.second_child_offset, kdepth + 1));
+      }
+    }
+  }
+
+  std::size_t BVH::memory_bytes() const
+  {
+    return m_nodes.size() * sizeof(BVH_node) +
+           m_shapes.size() * sizeof(std::shared_ptr<Shape>) +
+           m_quantized_nodes.size() * sizeof(BVH_quantized_node) +
+           m_primitives.size() * sizeof(BVH_primitive);
+  }
+
+  // Converts the full precision tree, which is released afterwards. Returns false,
+  // keeping the full precision tree, if leaf references can't address every primitive
+  // reference.
+  bool BVH::quantize()
+  {
+    if (m_nodes.empty() || m_primitives.size() > kmax_leaf_ref_offset) return false;
+
+    m_quantized_nodes.reserve(m_nodes.size() / 2);
+    m_quantized_root = quantize_subtree(0);
+
+    std::vector<BVH_node>().swap(m_nodes);
+    m_build_stats.memory_bytes = memory_bytes();
+
+    return true;
+  }
+
+  // Returns the reference to the subtree's quantized root, nodes are added in the same
+  // depth first order.
+  std::uint32_t BVH::quantize_subtree(const std::uint32_t node_index)
+  {
+    const BVH_node & node = m_nodes[node_index];
+    if (node.num_shapes > 0) {
+      return quantize_leaf(node.bounds, node.shapes_offset, node.num_shapes);
+    }
+
+    const std::uint32_t kquantized_index =
+        add_quantized_node(node.bounds, node.axis, m_nodes[node_index + 1].bounds,
+                           m_nodes[node.second_child_offset].bounds);
+    const std::uint32_t kfirst_child = quantize_subtree(node_index + 1);
+    const std::uint32_t ksecond_child = quantize_subtree(node.second_child_offset);
+    m_quantized_nodes[kquantized_index].child[0] = kfirst_child;
+    m_quantized_nodes[kquantized_index].child[1] = ksecond_child;
+
+    return kquantized_index;
+  }
+
+  // Leaves too large for a reference are split in halves under nodes that repeat
+  // their bounds.
+  std::uint32_t BVH::quantize_leaf(const Bounds3 & bounds, const std::uint32_t shapes_offset,
+                                   const std::uint32_t num_shapes)
+  {
+    if (num_shapes <= kmax_leaf_ref_shapes) return make_leaf_ref(shapes_offset, num_shapes);
+
+    const std::uint32_t khalf = num_shapes / 2;
+    const std::uint32_t kquantized_index = add_quantized_node(bounds, 0, bounds, bounds);
+    const std::uint32_t kfirst_child = quantize_leaf(bounds, shapes_offset, khalf);
+    const std::uint32_t ksecond_child = quantize_leaf(bounds, shapes_offset + khalf,
+                                                      num_shapes - khalf);
+    m_quantized_nodes[kquantized_index].child[0] = kfirst_child;
+    m_quantized_nodes[kquantized_index].child[1] = ksecond_child;
+
+    return kquantized_index;
+  }
+
+  std::uint32_t BVH::add_quantized_node(const Bounds3 & bounds, const unsigned split_axis,
+                                        const Bounds3 & first_bounds,
+                                        const Bounds3 & second_bounds)
+  {
+    BVH_quantized_node node;
+    node.origin = bounds.p_min;
+    node.axis = split_axis;
+    node.child[0] = node.child[1] = 0;
+
+    const Bounds3 kchildren[2] = { first_bounds, second_bounds };
+    for (unsigned axis = 0; axis != 3; ++axis) {
+      const float korigin = bounds.p_min[axis];
+      const int kexponent = choose_scale_exponent(korigin, bounds.p_max[axis]);
+      const float kscale = exponent_to_scale(kexponent);
+      node.scale_exponent[axis] = kexponent;
+
+      // Round outwards, then step further out while rounding errors leave the decoded
+      // plane inside the child
+      for (unsigned i = 0; i != 2; ++i) {
+        const float kmin = kchildren[i].p_min[axis];
+        const float kmax = kchildren[i].p_max[axis];
+        const float klow = std::floor((kmin - korigin) / kscale);
+        const float khigh = std::ceil((kmax - korigin) / kscale);
+
+        unsigned low = std::min(std::max(klow, 0.0f), static_cast<float>(kmax_quantized));
+        unsigned high = std::min(std::max(khigh, 0.0f), static_cast<float>(kmax_quantized));
+        while (low > 0 && dequantize(korigin, kscale, low) > kmin) --low;
+        while (high < kmax_quantized && dequantize(korigin, kscale, high) < kmax) ++high;
+
+        node.child_min[i][axis] = low;
+        node.child_max[i][axis] = high;
+      }
+    }
+
+    m_quantized_nodes.push_back(node);
+
+    return m_quantized_nodes.size() - 1;
+  }
+
+  bool BVH::intersect_quantized(const Ray & ray, float * phit,
+                                Surface_interaction * psurface_interaction,
+                                unsigned * pnode_visits) const
+  {
+    const Vec3 kdir = ray.get_direction();
+    const Vec3 kinv_dir(1.0f / kdir.x, 1.0f / kdir.y, 1.0f / kdir.z);
+    const unsigned kdir_is_neg[3] = { kinv_dir.x < 0.0f, kinv_dir.y < 0.0f, kinv_dir.z < 0.0f };
+
+    unsigned node_visits = 1;
+    if (!m_bounds.intersect_p(ray, kinv_dir, kdir_is_neg)) {
+      if (pnode_visits) *pnode_visits += node_visits;
+      add_render_count(knode_tests, node_visits);
+      return false;
+    }
+    unsigned primitive_tests = 0;
+
+    bool hit = false;
+    std::uint32_t refs_to_visit[64];
+    std::uint32_t to_visit_offset = 0;
+    std::uint32_t current_ref = m_quantized_root;
+
+    while (true) {
+      if (current_ref & kleaf_ref_flag) {
+        const std::uint32_t kend = leaf_ref_offset(current_ref) + leaf_ref_num_shapes(current_ref);
+        primitive_tests += leaf_ref_num_shapes(current_ref);
+        for (std::uint32_t i = leaf_ref_offset(current_ref); i != kend; ++i) {
+          const BVH_primitive & kprimitive = m_primitives[i];
+          float t;
+          if (m_shapes[kprimitive.shape]->intersect_primitive(ray, kprimitive.primitive, &t,
+                                                               psurface_interaction)) {
+            ray.set_t_max(t);
+            hit = true;
+          }
+        }
+      }
+      else {
+        // Both children are tested here, closest to the ray's origin first
+        const BVH_quantized_node & node = m_quantized_nodes[current_ref];
+        Bounds3 children[2];
+        dequantize_children(node, children);
+        node_visits += 2;
+
+        const unsigned knear = kdir_is_neg[node.axis];
+        const bool khit_near = children[knear].intersect_p(ray, kinv_dir, kdir_is_neg);
+        const bool khit_far = children[1 - knear].intersect_p(ray, kinv_dir, kdir_is_neg);
+        if (khit_near) {
+          if (khit_far) refs_to_visit[to_visit_offset++] = node.child[1 - knear];
+          current_ref = node.child[knear];
+          continue;
+        }
+        if (khit_far) {
+          current_ref = node.child[1 - knear];
+          continue;
+        }
+      }
+
+      if (to_visit_offset == 0) break;
+      current_ref = refs_to_visit[--to_visit_offset];
+    }
+
+    if (hit) *phit = ray.get_t_max();
+    if (pnode_visits) *pnode_visits += node_visits;
+    add_render_count(knode_tests, node_visits);
+    add_render_count(kprimitive_tests, primitive_tests);
+
+    return hit;
+  }
+
+  bool BVH::intersect_p_quantized(const Ray & ray) const
+  {
+    const Vec3 kdir = ray.get_direction();
+    const Vec3 kinv_dir(1.0f / kdir.x, 1.0f / kdir.y, 1.0f / kdir.z);
+    const unsigned kdir_is_neg[3] = { kinv_dir.x < 0.0f, kinv_dir.y < 0.0f, kinv_dir.z < 0.0f };
+
+    // Counted locally and added to the thread's stats once, on return
+    unsigned node_tests = 1;
+    unsigned primitive_tests = 0;
+    const auto count_tests = [&node_tests, &primitive_tests]()
+        {
+          add_render_count(knode_tests, node_tests);
+          add_render_count(kprimitive_tests, primitive_tests);
+        };
+    if (!m_bounds.intersect_p(ray, kinv_dir, kdir_is_neg)) {
+      count_tests();
+      return false;
+    }
+
+    std::uint32_t refs_to_visit[64];
+    std::uint32_t to_visit_offset = 0;
+    std::uint32_t current_ref = m_quantized_root;
+
+    while (true) {
+      if (current_ref & kleaf_ref_flag) {
+        const std::uint32_t kend = leaf_ref_offset(current_ref) + leaf_ref_num_shapes(current_ref);
+        for (std::uint32_t i = leaf_ref_offset(current_ref); i != kend; ++i) {
+          ++primitive_tests;
+          const BVH_primitive & kprimitive = m_primitives[i];
+          if (m_shapes[kprimitive.shape]->intersect_p_primitive(ray, kprimitive.primitive)) {
+            count_tests();
+            return true;
+          }
+        }
+      }
+      else {
+        const BVH_quantized_node & node = m_quantized_nodes[current_ref];
+        Bounds3 children[2];
+        dequantize_children(node, children);
+        node_tests += 2;
+
+        const bool khit_first = children[0].intersect_p(ray, kinv_dir, kdir_is_neg);
+        const bool khit_second = children[1].intersect_p(ray, kinv_dir, kdir_is_neg);
+        if (khit_first) {
+          if (khit_second) refs_to_visit[to_visit_offset++] = node.child[1];
+          current_ref = node.child[0];
+          continue;
+        }
+        if (khit_second) {
+          current_ref = node.child[1];
+          continue;
+        }
+      }
+
+      if (to_visit_offset == 0) break;
+      current_ref = refs_to_visit[--to_visit_offset];
+    }
+    count_tests();
+
+    return false;
+  }
+
+  bool BVH::intersect(const Ray & ray, float * phit,
+                      Surface_interaction * psurface_interaction,
+                      unsigned * pnode_visits) const
+  {
+    if (is_quantized()) {
+      return intersect_quantized(ray, phit, psurface_interaction, pnode_visits);
+    }
+    if (m_nodes.empty()) return false;
+
+    const Vec3 kdir = ray.get_direction();
+    const Vec3 kinv_dir(1.0f / kdir.x, 1.0f / kdir.y, 1.0f / kdir.z);
+    const unsigned kdir_is_neg[3] = { kinv_dir.x < 0.0f, kinv_dir.y < 0.0f, kinv_dir.z < 0.0f };
+
+    bool hit = false;
+    std::uint32_t nodes_to_visit[64];
+    std::uint32_t to_visit_offset = 0;
+    std::uint32_t current_node_index = 0;
+
+    unsigned node_visits = 0;
+    unsigned primitive_tests = 0;
+    while (true) {
+      const BVH_node & node = m_nodes[current_node_index];
+      ++node_visits;
+      if (node.bounds.intersect_p(ray, kinv_dir, kdir_is_neg)) {
+        if (node.num_shapes > 0) {
+          primitive_tests += node.num_shapes;
+          for (std::uint32_t i = 0; i != node.num_shapes; ++i) {
+            const BVH_primitive & kprimitive = m_primitives[node.shapes_offset + i];
+            float t;
+            if (m_shapes[kprimitive.shape]->intersect_primitive(ray, kprimitive.primitive, &t,
+                                                                 psurface_interaction)) {
+              ray.set_t_max(t);
+              hit = true;
+            }
+          }
+          if (to_visit_offset == 0) break;
+          current_node_index = nodes_to_visit[--to_visit_offset];
+        }
+        else {
+          // Visit the child closest to the ray's origin first
+          if (kdir_is_neg[node.axis]) {
+            nodes_to_visit[to_visit_offset++] = current_node_index + 1;
+            current_node_index = node.second_child_offset;
+          }
+          else {
+            nodes_to_visit[to_visit_offset++] = node.second_child_offset;
+            current_node_index = current_node_index + 1;
+          }
+        }
+      }
+      else {
+        if (to_visit_offset == 0) break;
+        current_node_index = nodes_to_visit[--to_visit_offset];
+      }
+    }
+
+    if (hit) *phit = ray.get_t_max();
+    if (pnode_visits) *pnode_visits += node_visits;
+    add_render_count(knode_tests, node_visits);
+    add_render_count(kprimitive_tests, primitive_tests);
+
+    return hit;
+  }
+
+  bool BVH::intersect_p(const Ray & ray) const
+  {
+    if (is_quantized()) return intersect_p_quantized(ray);
+    if (m_nodes.empty()) return false;
+
+    const Vec3 kdir = ray.get_direction();
+    const Vec3 kinv_dir(1.0f / kdir.x, 1.0f / kdir.y, 1.0f / kdir.z);
+    const unsigned kdir_is_neg[3] = { kinv_dir.x < 0.0f, kinv_dir.y < 0.0f, kinv_dir.z < 0.0f };
+
+    std::uint32_t nodes_to_visit[64];
+    std::uint32_t to_visit_offset = 0;
+    std::uint32_t current_node_index = 0;
+
+    unsigned node_tests = 0;
+    unsigned primitive_tests = 0;
+    const auto count_tests = [&node_tests, &primitive_tests]()
+        {
+          add_render_count(knode_tests, node_tests);
+          add_render_count(kprimitive_tests, primitive_tests);
+        };
+    while (true) {
+      const BVH_node & node = m_nodes[current_node_index];
+      ++node_tests;
+      if (node.bounds.intersect_p(ray, kinv_dir, kdir_is_neg)) {
+        if (node.num_shapes > 0) {
+          for (std::uint32_t i = 0; i != node.num_shapes; ++i) {
+            ++primitive_tests;
+            const BVH_primitive & kprimitive = m_primitives[node.shapes_offset + i];
+            if (m_shapes[kprimitive.shape]->intersect_p_primitive(ray, kprimitive.primitive)) {
+              count_tests();
+              return true;
+            }
+          }
+          if (to_visit_offset == 0) break;
+          current_node_index = nodes_to_visit[--to_visit_offset];
+        }
+        else {
+          if (kdir_is_neg[node.axis]) {
+            nodes_to_visit[to_visit_offset++] = current_node_index + 1;
+            current_node_index = node.second_child_offset;
+          }
+          else {
+            nodes_to_visit[to_visit_offset++] = node.second_child_offset;
+            current_node_index = current_node_index + 1;
+          }
+        }
+      }
+      else {
+        if (to_visit_offset == 0) break;
+        current_node_index = nodes_to_visit[--to_visit_offset];
+      }
+    }
+    count_tests();
+
+    return false;
+  }
+
+  float average_node_visits(const BVH & bvh, const std::vector<Ray> & rays)
+  {
+    if (rays.empty()) return 0.0f;
+
+    unsigned long long total_visits = 0;
+    for (std::size_t i = 0; i != rays.size(); ++i) {
+      // The BVH shortens t_max on hits, so every ray is traced from a copy
+      const Ray kray = rays[i];
+      unsigned node_visits = 0;
+      float t;
+      Surface_interaction interaction;
+      bvh.intersect(kray, &t, &interaction, &node_visits);
+      total_visits += node_visits;
+    }
+
+    return static_cast<float>(total_visits) / rays.size();
+  }
+}
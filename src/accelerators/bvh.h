@@ -0,0 +1,195 @@
+#ifndef LUX_ACCELERATORS_BVH_H_
+#define LUX_ACCELERATORS_BVH_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+
+#include "core/bounds3.h"
+
+namespace lux { class Ray; class Shape; struct Surface_interaction; }
+
+namespace lux {
+  enum BVH_builder {
+    ksah,          // Binned Surface Area Heuristic, slower to build but faster to traverse
+    klbvh,         // Shapes sorted along a Morton curve, for quick turnaround
+    kspatial_sah   // SAH that may also split shapes between children, see below
+  };
+
+  // Parses sah, lbvh or sbvh, the spatial split SAH
+  bool parse_bvh_builder(const std::string & name, BVH_builder * pbuilder);
+
+  // The spatial split builder (SBVH) can place a shape in both children of a node,
+  // each with its bounds clipped to its side of the split plane. That pays off when
+  // large shapes overlap most of the scene, like the walls of a room.
+  struct BVH_build_options {
+    BVH_build_options()
+        : builder(BVH_builder::ksah),
+          max_shapes_in_node(4),
+          num_threads(0),
+          max_reference_growth(0.3f),
+          min_split_overlap(1e-5f),
+          quantize_nodes(false) {}
+
+    BVH_builder builder;
+    unsigned max_shapes_in_node;
+    unsigned num_threads;        // 0 uses every core
+
+    // Spatial splits stop once the shape references exceed (1 + growth) times the shapes
+    float max_reference_growth;
+
+    // Spatial splits are only tried where the children of the best object split overlap
+    // by more than this fraction of the root surface area
+    float min_split_overlap;
+
+    // Stores the tree as BVH_quantized_nodes once built, see below. Trees with more shape
+    // references than a quantized leaf can address keep their full precision nodes.
+    bool quantize_nodes;
+  };
+
+  struct BVH_build_stats {
+    BVH_build_stats()
+        : build_seconds(0.0),
+          sah_cost(0.0f),
+          num_nodes(0),
+          num_leaves(0),
+          num_references(0),
+          max_depth(0),
+          memory_bytes(0) {}
+
+    double build_seconds;
+    float sah_cost;
+    std::size_t num_nodes;
+    std::size_t num_leaves;
+    std::size_t num_references;  // Shape references in the leaves, more than shapes on a SBVH
+    unsigned max_depth;
+    std::size_t memory_bytes;    // Nodes and leaf references
+  };
+
+  std::ostream & operator<<(std::ostream & os, const BVH_build_stats & stats);
+
+  // Leaf reference to a primitive of a shape, e.g. a triangle of a mesh. shape indexes the
+  // shapes the tree was built over.
+  struct BVH_primitive {
+    std::uint32_t shape;
+    std::uint32_t primitive;
+  };
+
+  // Node of the flattened tree. Interior nodes store their first child right after them.
+  struct BVH_node {
+    Bounds3 bounds;
+    union {
+      std::uint32_t shapes_offset;       // leaf
+      std::uint32_t second_child_offset; // interior
+    };
+    std::uint16_t num_shapes;            // 0 for interior nodes
+    std::uint8_t axis;                   // interior node split axis
+    std::uint8_t pad;
+  };
+
+  // Interior node of a quantized BVH, 36 bytes against the 64 of two BVH_nodes. The
+  // bounds of both children are stored with 8 bits per plane, relative to the node's
+  // box, whose origin and power of two scale per axis are kept at full precision. They
+  // are rounded outwards, so the decoded boxes always contain the full precision ones.
+  // Children are node indices, or leaf references packing the offset and the number of
+  // shapes into 32 bits.
+  struct BVH_quantized_node {
+    Vec3 origin;
+    std::int8_t scale_exponent[3];
+    std::uint8_t axis;
+    std::uint8_t child_min[2][3];
+    std::uint8_t child_max[2][3];
+    std::uint32_t child[2];
+  };
+
+  // Bounding Volume Hierarchy flattened in depth first order, over the primitives of the
+  // shapes, see Shape::num_primitives. Large subtrees are built on their own threads.
+  class BVH final {
+    public:
+      explicit BVH(const std::vector<std::shared_ptr<Shape>> & shapes,
+                   const BVH_build_options & options = BVH_build_options());
+
+      // Adopts a tree flattened by an earlier build, e.g. loaded from a scene cache.
+      // primitives holds the leaf references in leaf order, like get_primitives() does.
+      BVH(const std::vector<std::shared_ptr<Shape>> & shapes,
+          std::vector<BVH_primitive> primitives, std::vector<BVH_node> nodes,
+          const BVH_build_options & options = BVH_build_options());
+
+      BVH(const BVH &) = delete;
+      BVH & operator=(const BVH &) = delete;
+
+      ~BVH() = default;
+
+      Bounds3 world_bound() const;
+
+      // Finds the closest intersection, updating the ray's t_max. If pnode_visits is
+      // given, the number of nodes tested against the ray is added to it.
+      bool intersect(const Ray & ray, float * phit, Surface_interaction * psurface_interaction,
+                     unsigned * pnode_visits = nullptr) const;
+
+      bool intersect_p(const Ray & ray) const;
+
+      // Recomputes every node's bounds from the current shape bounds in O(n), keeping
+      // the topology. Meant for shapes that moved, e.g. between frames of an animation;
+      // the SAH cost in the build stats shows how much the tree has degraded. Returns false
+      // on quantized trees, which can't be refit and have to be rebuilt.
+      bool refit();
+
+      // False if quantize_nodes wasn't set or the tree was too large to quantize. Quantizing
+      // releases the full precision nodes.
+      bool is_quantized() const { return m_nodes.empty() && !m_primitives.empty(); }
+
+      // Quantizes a tree built without quantize_nodes, e.g. once its full precision nodes
+      // were saved to a scene cache. Returns false if it was quantized already, is empty or
+      // is too large to quantize.
+      bool quantize();
+
+      // The shapes the tree was built over
+      const std::vector<std::shared_ptr<Shape>> & get_shapes() const { return m_shapes; }
+
+      // Primitive references in leaf order, a primitive appears more than once on a SBVH
+      const std::vector<BVH_primitive> & get_primitives() const { return m_primitives; }
+
+      // Empty on quantized trees
+      const std::vector<BVH_node> & get_nodes() const { return m_nodes; }
+      const std::vector<BVH_quantized_node> & get_quantized_nodes() const
+      {
+        return m_quantized_nodes;
+      }
+      const BVH_build_stats & get_build_stats() const { return m_build_stats; }
+
+    private:
+      void compute_build_stats();
+      std::size_t memory_bytes() const;
+
+      std::uint32_t quantize_subtree(const std::uint32_t node_index);
+      std::uint32_t quantize_leaf(const Bounds3 & bounds, const std::uint32_t shapes_offset,
+                                  const std::uint32_t num_shapes);
+      std::uint32_t add_quantized_node(const Bounds3 & bounds, const unsigned split_axis,
+                                       const Bounds3 & first_bounds,
+                                       const Bounds3 & second_bounds);
+
+      bool intersect_quantized(const Ray & ray, float * phit,
+                               Surface_interaction * psurface_interaction,
+                               unsigned * pnode_visits) const;
+      bool intersect_p_quantized(const Ray & ray) const;
+
+      const BVH_build_options m_options;
+      Bounds3 m_bounds;
+      std::vector<std::shared_ptr<Shape>> m_shapes;
+      std::vector<BVH_node> m_nodes;
+      std::vector<BVH_primitive> m_primitives;
+      std::vector<BVH_quantized_node> m_quantized_nodes;
+      std::uint32_t m_quantized_root;
+      BVH_build_stats m_build_stats;
+  };
+
+  // Average number of nodes visited by closest hit queries, to compare trees.
+  float average_node_visits(const BVH & bvh, const std::vector<Ray> & rays);
+}
+
+#endif
@@ -0,0 +1,522 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "core/camera.h"
+#include "core/mat4.h"
+#include "core/ray.h"
+#include "core/vec2.h"
+#include "core/vec3.h"
+#include "core/rgb_spectrum.h"
+#include "core/transform.h"
+#include "core/animated_transform.h"
+#include "core/shape.h"
+#include "core/shape_tables.h"
+#include "core/scene.h"
+#include "core/integrator.h"
+#include "core/rng.h"
+#include "core/render_settings.h"
+#include "materials/lambertian.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+#include "shapes/instance.h"
+#include "samplers/stratified.h"
+#include "loaders/scene_loader.h"
+#include "scenes/cornell_box.h"
+#include "scenes/stress_scenes.h"
+#include "bench/benchmark.h"
+#include "bench/convergence.h"
+#include "bench/scaling.h"
+#include "bench/perf_counters.h"
+
+// Inputs are cycled through, a power of two so the index is a mask
+const std::size_t kinput_count = 4096;
+const std::size_t kinput_mask = kinput_count - 1;
+
+lux::Vec3 uniform_sample_sphere(lux::RNG & rng)
+{
+  const float kz = 1.0f - 2.0f * rng();
+  const float kr = std::sqrt(std::max(0.0f, 1.0f - kz * kz));
+  const float kphi = 2.0f * 3.14159265f * rng();
+
+  return lux::Vec3(kr * std::cos(kphi), kr * std::sin(kphi), kz);
+}
+
+lux::Vec3 uniform_sample_box(lux::RNG & rng, const lux::Vec3 & min, const lux::Vec3 & max)
+{
+  return lux::Vec3(min.x + rng() * (max.x - min.x), min.y + rng() * (max.y - min.y),
+                   min.z + rng() * (max.z - min.z));
+}
+
+// Rays from outside the bounding sphere of radius around the origin towards points inside
+// it, so some hit a shape centered there and some miss it
+std::vector<lux::Ray> rays_towards_origin(lux::RNG & rng, const float radius)
+{
+  std::vector<lux::Ray> rays;
+  for (std::size_t i = 0; i != kinput_count; ++i) {
+    const lux::Vec3 korigin = 3.0f * radius * uniform_sample_sphere(rng);
+    const lux::Vec3 ktarget = uniform_sample_box(rng, lux::Vec3(-radius, -radius, -radius),
+                                                  lux::Vec3(radius, radius, radius));
+    rays.push_back(lux::Ray(korigin, normalize(ktarget - korigin)));
+  }
+
+  return rays;
+}
+
+std::vector<lux::Benchmark> shape_benchmarks(lux::RNG & rng)
+{
+  std::shared_ptr<lux::Material> pmaterial =
+      std::make_shared<lux::Lambertian>(lux::RGB_spectrum(0.5f));
+  const lux::RGB_spectrum kblack(0.0f);
+
+  std::shared_ptr<lux::Sphere> psphere =
+      std::make_shared<lux::Sphere>(lux::Transform(), pmaterial, kblack, 1.0f);
+  std::shared_ptr<lux::Triangle> ptriangle =
+      std::make_shared<lux::Triangle>(lux::Transform(), pmaterial, kblack,
+                                      lux::Vec3(-1.0f, -1.0f, 0.0f), lux::Vec3(1.0f, -1.0f, 0.0f),
+                                      lux::Vec3(0.0f, 1.0f, 0.0f));
+  std::shared_ptr<std::vector<lux::Ray>> prays =
+      std::make_shared<std::vector<lux::Ray>>(rays_towards_origin(rng, 1.0f));
+
+  std::vector<lux::Benchmark> benchmarks;
+  for (const std::shared_ptr<lux::Shape> & kpshape : { std::shared_ptr<lux::Shape>(psphere),
+                                                       std::shared_ptr<lux::Shape>(ptriangle) }) {
+    benchmarks.push_back({ (kpshape == psphere) ? "sphere_intersect" : "triangle_intersect", 1,
+                           [kpshape, prays](const std::size_t iterations)
+        {
+          unsigned hits = 0;
+          for (std::size_t i = 0; i != iterations; ++i) {
+            const lux::Ray kray = (*prays)[i & kinput_mask];
+            float t;
+            lux::Surface_interaction interaction;
+            hits += kpshape->intersect(kray, &t, &interaction);
+          }
+          lux::do_not_optimize(hits);
+        } });
+  }
+
+  return benchmarks;
+}
+
+std::vector<lux::Benchmark> scene_benchmarks(lux::RNG & rng)
+{
+  std::shared_ptr<lux::Scene> pscene = std::make_shared<lux::Scene>();
+  lux::Render_settings settings;
+  lux::add_cornell_box(pscene.get(), &settings);
+  pscene->finalize(lux::bvh_build_options(settings));
+
+  // Rays leaving points inside the box in every direction, like the bounces of a path.
+  // The shadow rays end at another point inside the box.
+  const lux::Vec3 kbox_min(-1.99f, 0.01f, -1.99f);
+  const lux::Vec3 kbox_max(1.99f, 3.99f, 1.99f);
+  std::shared_ptr<std::vector<lux::Ray>> prays = std::make_shared<std::vector<lux::Ray>>();
+  std::shared_ptr<std::vector<lux::Ray>> pshadow_rays =
+      std::make_shared<std::vector<lux::Ray>>();
+  for (std::size_t i = 0; i != kinput_count; ++i) {
+    const lux::Vec3 korigin = uniform_sample_box(rng, kbox_min, kbox_max);
+    prays->push_back(lux::Ray(korigin, uniform_sample_sphere(rng)));
+    pshadow_rays->push_back(lux::Ray(korigin, uniform_sample_box(rng, kbox_min, kbox_max) -
+                                              korigin, 0.999f));
+  }
+
+  // Points the camera sees, for estimate_direct
+  std::shared_ptr<std::vector<lux::Surface_interaction>> pinteractions =
+      std::make_shared<std::vector<lux::Surface_interaction>>();
+  std::shared_ptr<std::vector<lux::Vec2>> psamples = std::make_shared<std::vector<lux::Vec2>>();
+  const lux::Camera kcamera(lux::Vec2(512.0f, 512.0f), look_at(settings.eye, settings.look),
+                            settings.fov);
+  while (pinteractions->size() != kinput_count) {
+    lux::Camera_sample camera_sample;
+    camera_sample.raster_coord = lux::Vec2(512.0f * rng(), 512.0f * rng());
+    camera_sample.lens_coord = lux::Vec2(rng(), rng());
+    camera_sample.time = 0.0f;
+
+    lux::Surface_interaction interaction;
+    if (pscene->intersect(kcamera.generate_ray(camera_sample), &interaction) &&
+        interaction.pshape->get_le()[0] == 0.0f) {
+      pinteractions->push_back(interaction);
+      psamples->push_back(lux::Vec2(rng(), rng()));
+      psamples->push_back(lux::Vec2(rng(), rng()));
+    }
+  }
+
+  std::vector<lux::Benchmark> benchmarks;
+  benchmarks.push_back({ "scene_intersect", 1, [pscene, prays](const std::size_t iterations)
+      {
+        unsigned hits = 0;
+        for (std::size_t i = 0; i != iterations; ++i) {
+          const lux::Ray kray = (*prays)[i & kinput_mask];
+          lux::Surface_interaction interaction;
+          hits += pscene->intersect(kray, &interaction);
+        }
+        lux::do_not_optimize(hits);
+      } });
+  benchmarks.push_back({ "scene_intersect_p", 1,
+                         [pscene, pshadow_rays](const std::size_t iterations)
+      {
+        unsigned hits = 0;
+        for (std::size_t i = 0; i != iterations; ++i) {
+          const lux::Ray kray = (*pshadow_rays)[i & kinput_mask];
+          hits += pscene->intersect_p(kray);
+        }
+        lux::do_not_optimize(hits);
+      } });
+  benchmarks.push_back({ "estimate_direct", 0,
+                         [pscene, pinteractions, psamples](const std::size_t iterations)
+      {
+        const lux::Shape & klight = *pscene->get_lights()[0];
+        lux::RGB_spectrum sum(0.0f);
+        for (std::size_t i = 0; i != iterations; ++i) {
+          const std::size_t kindex = i & kinput_mask;
+          sum += lux::estimate_direct(*pscene, (*pinteractions)[kindex],
+                                      (*psamples)[2 * kindex], klight,
+                                      (*psamples)[2 * kindex + 1]);
+        }
+        lux::do_not_optimize(sum);
+      } });
+
+  return benchmarks;
+}
+
+std::vector<lux::Benchmark> camera_and_sampler_benchmarks(lux::RNG & rng)
+{
+  lux::Render_settings settings;
+  std::shared_ptr<lux::Camera> pcamera =
+      std::make_shared<lux::Camera>(lux::Vec2(1024.0f, 1024.0f),
+                                    look_at(lux::Vec3(0.0f, 2.0f, -5.8f), lux::Vec3()),
+                                    51.3f, 0.05f, 6.0f);
+  std::shared_ptr<std::vector<lux::Camera_sample>> pcamera_samples =
+      std::make_shared<std::vector<lux::Camera_sample>>(kinput_count);
+  for (lux::Camera_sample & camera_sample : *pcamera_samples) {
+    camera_sample.raster_coord = lux::Vec2(1024.0f * rng(), 1024.0f * rng());
+    camera_sample.lens_coord = lux::Vec2(rng(), rng());
+    camera_sample.time = 0.0f;
+  }
+
+  std::vector<lux::Benchmark> benchmarks;
+  benchmarks.push_back({ "camera_generate_ray", 0,
+                         [pcamera, pcamera_samples](const std::size_t iterations)
+      {
+        lux::Vec3 sum;
+        for (std::size_t i = 0; i != iterations; ++i) {
+          sum += pcamera->generate_ray((*pcamera_samples)[i & kinput_mask]).get_direction();
+        }
+        lux::do_not_optimize(sum);
+      } });
+
+  // The sampler of the path tracer with the default 8x8 samples and 5 bounces
+  benchmarks.push_back({ "stratified_start_pixel", 0,
+                         [settings](const std::size_t iterations)
+      {
+        lux::Stratified_sampler sampler(settings.samples_x, settings.samples_y,
+                                        settings.max_depth * 3, true);
+        for (std::size_t i = 0; i != iterations; ++i) sampler.start_pixel();
+        lux::do_not_optimize(sampler.get_1D());
+      } });
+
+  benchmarks.push_back({ "rng", 0, [](const std::size_t iterations)
+      {
+        lux::RNG rng;
+        float sum = 0.0f;
+        for (std::size_t i = 0; i != iterations; ++i) sum += rng();
+        lux::do_not_optimize(sum);
+      } });
+
+  std::shared_ptr<std::vector<lux::Mat4>> pmatrices = std::make_shared<std::vector<lux::Mat4>>();
+  for (std::size_t i = 0; i != kinput_count; ++i) {
+    const lux::Transform ktransform = lux::rotate_x(360.0f * rng()) *
+                                      lux::rotate_y(360.0f * rng()) *
+                                      lux::scale(0.5f + rng(), 0.5f + rng(), 0.5f + rng()) *
+                                      lux::translate(uniform_sample_sphere(rng));
+    pmatrices->push_back(ktransform.get_matrix());
+  }
+  benchmarks.push_back({ "mat4_inverse", 0, [pmatrices](const std::size_t iterations)
+      {
+        float sum = 0.0f;
+        for (std::size_t i = 0; i != iterations; ++i) {
+          sum += inverse((*pmatrices)[i & kinput_mask])(0, 0);
+        }
+        lux::do_not_optimize(sum);
+      } });
+
+  return benchmarks;
+}
+
+// Moves every instance of the moving instances scene, then updates its BVH by refitting
+// it or by building it again, so the two costs of an animation frame can be compared
+std::vector<lux::Benchmark> animation_benchmarks(lux::RNG &)
+{
+  std::shared_ptr<lux::Scene> pscene = std::make_shared<lux::Scene>();
+  lux::Render_settings settings;
+  lux::add_stress_scene(lux::Stress_scene_type::kmoving_instances, 1000, pscene.get(),
+                        &settings);
+  const lux::BVH_build_options kbvh_options = lux::bvh_build_options(settings);
+  pscene->finalize(kbvh_options);
+
+  // Frames alternate between the instances' own transforms and ones moved sideways, so
+  // the instances don't drift away over the iterations
+  std::shared_ptr<std::vector<lux::Instance *>> pinstances =
+      std::make_shared<std::vector<lux::Instance *>>();
+  std::shared_ptr<std::vector<lux::Animated_transform>> pframes =
+      std::make_shared<std::vector<lux::Animated_transform>>();
+  const lux::Transform kmove = lux::translate(lux::Vec3(0.5f, 0.0f, 0.0f));
+  for (const std::shared_ptr<lux::Shape> & kpshape : pscene->get_shapes()) {
+    lux::Instance * pinstance = dynamic_cast<lux::Instance *>(kpshape.get());
+    if (!pinstance) continue;
+
+    const lux::Animated_transform & kinstance_to_world = pinstance->get_instance_to_world();
+    pinstances->push_back(pinstance);
+    pframes->push_back(kinstance_to_world);
+    pframes->push_back(lux::Animated_transform(kinstance_to_world.interpolate(0.0f) * kmove,
+                                               0.0f,
+                                               kinstance_to_world.interpolate(1.0f) * kmove,
+                                               1.0f));
+  }
+
+  const auto kmove_instances = [pinstances, pframes](const std::size_t frame)
+      {
+        for (std::size_t i = 0; i != pinstances->size(); ++i) {
+          (*pinstances)[i]->set_instance_to_world((*pframes)[2 * i + (frame & 1)]);
+        }
+      };
+
+  std::vector<lux::Benchmark> benchmarks;
+  benchmarks.push_back({ "instances_refit", 0,
+                         [pscene, kmove_instances](const std::size_t iterations)
+      {
+        bool refit = true;
+        for (std::size_t i = 0; i != iterations; ++i) {
+          kmove_instances(i + 1);
+          refit = pscene->refit() && refit;
+        }
+        lux::do_not_optimize(refit);
+      } });
+  benchmarks.push_back({ "instances_rebuild", 0,
+                         [pscene, kmove_instances, kbvh_options](const std::size_t iterations)
+      {
+        for (std::size_t i = 0; i != iterations; ++i) {
+          kmove_instances(i + 1);
+          pscene->finalize(kbvh_options);
+        }
+        lux::do_not_optimize(pscene->get_accelerator());
+      } });
+
+  return benchmarks;
+}
+
+void print_usage(const char * program)
+{
+  std::cerr << "Usage: " << program << " [options]\n"
+            << "Times the kernels of lux on inputs generated with a fixed seed.\n"
+            << "  --filter <text>        Only runs the benchmarks whose name contains text\n"
+            << "  --samples <count>      Timed runs of each benchmark\n"
+            << "  --min-time <ms>        Shortest time of a run\n"
+            << "  --json <file>          Writes the results as JSON\n"
+            << "  --label <text>         Label of the JSON results, e.g. a commit\n"
+            << "  --counters             Also reads the cycles, instructions, cache, branch\n"
+            << "                         and TLB misses of each benchmark\n"
+            << "With --time-to-error, renders the reference scenes in passes instead and\n"
+            << "reports the render time their error takes to reach a target.\n"
+            << "  --make-references      Renders the references the errors are measured against\n"
+            << "  --references <dir>     Directory of the references\n"
+            << "  --target <relMSE>      Error to reach\n"
+            << "  --time-limit <s>       Render time of each scene\n"
+            << "  --threads <count>      Render threads, 0 uses every core\n"
+            << "With --scaling, builds and renders the stress scenes at tenfold counts\n"
+            << "instead and reports build time, memory and rays/s.\n"
+            << "  --max-count <count>    Largest count, from 100\n";
+}
+
+// Measures or renders the references of the scenes whose name contains filter
+int run_time_to_error(const lux::Convergence_options & options, const bool make_references,
+                      const std::string & filter, const std::string & json_path,
+                      const std::string & label)
+{
+  std::vector<lux::Convergence_result> results;
+  for (const lux::Reference_scene & kscene : lux::reference_scenes()) {
+    if (kscene.name.find(filter) == std::string::npos) continue;
+
+    std::string error;
+    if (make_references) {
+      if (!lux::render_reference(kscene, options, &error)) {
+        std::cerr << error << std::endl;
+        return 1;
+      }
+      std::cout << "Rendered the reference of " << kscene.name << std::endl;
+      lux::clear_shape_tables();
+      continue;
+    }
+
+    results.push_back(lux::Convergence_result());
+    if (!lux::measure_convergence(kscene, options, &results.back(), &error)) {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+    std::cout << results.back() << std::endl;
+    lux::clear_shape_tables();
+  }
+
+  if (!json_path.empty() && !make_references) {
+    std::ofstream json(json_path);
+    lux::write_convergence_json(json, label, options, results);
+    if (!json) {
+      std::cerr << "Couldn't write " << json_path << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// Sweeps the counts of the stress scenes whose name contains filter
+int run_scaling(const lux::Scaling_options & options, const std::string & filter,
+                const std::string & json_path, const std::string & label)
+{
+  std::vector<lux::Scaling_point> points;
+  for (unsigned i = 0; i != lux::knum_stress_scene_types; ++i) {
+    const lux::Stress_scene_type ktype = static_cast<lux::Stress_scene_type>(i);
+    if (std::string(lux::stress_scene_name(ktype)).find(filter) == std::string::npos) continue;
+
+    for (unsigned long long count = options.min_count; count <= options.max_count;
+         count *= 10) {
+      try {
+        points.push_back(lux::measure_scaling(ktype, count, options));
+      }
+      catch (const std::length_error & exception) {
+        // Thrown when a shape table is full, which ends the sweep of this scene
+        std::cerr << "Couldn't add " << lux::stress_scene_name(ktype) << ":" << count << ": "
+                  << exception.what() << std::endl;
+        lux::clear_shape_tables();
+        break;
+      }
+      std::cout << points.back() << std::endl;
+      lux::clear_shape_tables();
+    }
+  }
+
+  if (!json_path.empty()) {
+    std::ofstream json(json_path);
+    lux::write_scaling_json(json, label, options, points);
+    if (!json) {
+      std::cerr << "Couldn't write " << json_path << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int main(int argc, char * argv[])
+{
+  lux::Benchmark_options options;
+  lux::Convergence_options convergence_options;
+  bool time_to_error = false;
+  bool make_references = false;
+  lux::Scaling_options scaling_options;
+  bool scaling = false;
+  std::string filter;
+  std::string json_path;
+  std::string label;
+  for (int i = 1; i < argc; ++i) {
+    const std::string koption = argv[i];
+    if (koption == "--time-to-error" || koption == "--make-references") {
+      time_to_error = true;
+      make_references = make_references || koption == "--make-references";
+      continue;
+    }
+    if (koption == "--scaling") {
+      scaling = true;
+      continue;
+    }
+    if (koption == "--counters") {
+      options.hardware_counters = true;
+      continue;
+    }
+    if (i + 1 == argc) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    const char * kvalue = argv[++i];
+
+    if (koption == "--filter") filter = kvalue;
+    else if (koption == "--samples") options.num_samples = std::strtoul(kvalue, nullptr, 10);
+    else if (koption == "--min-time") options.min_sample_seconds = std::atof(kvalue) / 1000.0;
+    else if (koption == "--json") json_path = kvalue;
+    else if (koption == "--label") label = kvalue;
+    else if (koption == "--references") convergence_options.reference_dir = kvalue;
+    else if (koption == "--target") convergence_options.target_rel_mse = std::atof(kvalue);
+    else if (koption == "--time-limit") {
+      convergence_options.time_limit_seconds = std::atof(kvalue);
+    }
+    else if (koption == "--threads") {
+      convergence_options.num_threads = std::strtoul(kvalue, nullptr, 10);
+      scaling_options.num_threads = convergence_options.num_threads;
+    }
+    else if (koption == "--max-count") {
+      scaling_options.max_count = std::strtoul(kvalue, nullptr, 10);
+    }
+    else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (options.num_samples == 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (scaling) return run_scaling(scaling_options, filter, json_path, label);
+  if (time_to_error) {
+    return run_time_to_error(convergence_options, make_references, filter, json_path, label);
+  }
+
+  // Containers and virtual machines often don't allow the counters, the timings still run
+  if (options.hardware_counters) {
+    const lux::Perf_counters kcounters;
+    if (!kcounters.is_open()) {
+      std::cerr << "Hardware counters unavailable, " << kcounters.get_error()
+                << ", only timing the benchmarks" << std::endl;
+      options.hardware_counters = false;
+    }
+    else if (!kcounters.get_error().empty()) {
+      std::cerr << "Some hardware counters are unavailable, " << kcounters.get_error()
+                << std::endl;
+    }
+  }
+
+  lux::RNG rng;
+  std::vector<lux::Benchmark> benchmarks = shape_benchmarks(rng);
+  for (std::vector<lux::Benchmark> (*padd)(lux::RNG &) : { scene_benchmarks,
+                                                          camera_and_sampler_benchmarks,
+                                                          animation_benchmarks }) {
+    std::vector<lux::Benchmark> more = padd(rng);
+    benchmarks.insert(benchmarks.end(), more.begin(), more.end());
+  }
+
+  std::vector<lux::Benchmark_result> results;
+  for (const lux::Benchmark & kbenchmark : benchmarks) {
+    if (kbenchmark.name.find(filter) == std::string::npos) continue;
+
+    results.push_back(lux::run_benchmark(kbenchmark, options));
+    std::cout << results.back() << std::endl;
+  }
+
+  if (!json_path.empty()) {
+    std::ofstream json(json_path);
+    lux::write_benchmark_json(json, label, results);
+    if (!json) {
+      std::cerr << "Couldn't write " << json_path << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
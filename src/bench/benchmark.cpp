@@ -0,0 +1,153 @@
+#include "bench/benchmark.h"
+
+#include <cstddef>
+#include <cmath>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <memory>
+
+namespace lux {
+  namespace {
+    double time_run(const Benchmark & benchmark, const std::size_t iterations)
+    {
+      const std::chrono::steady_clock::time_point kstart = std::chrono::steady_clock::now();
+      benchmark.body(iterations);
+      const std::chrono::duration<double> kelapsed = std::chrono::steady_clock::now() - kstart;
+
+      return kelapsed.count();
+    }
+  }
+
+  Benchmark_result run_benchmark(const Benchmark & benchmark, const Benchmark_options & options)
+  {
+    // Grows the iterations until a run is long enough to time, which also warms the caches
+    std::size_t iterations = 1;
+    for (;;) {
+      const double kseconds = time_run(benchmark, iterations);
+      if (kseconds >= options.min_sample_seconds) break;
+
+      const double kscale = (kseconds > 0.0) ? 1.2 * options.min_sample_seconds / kseconds
+                                             : 100.0;
+      iterations = static_cast<std::size_t>(iterations * std::min(kscale, 100.0)) + 1;
+    }
+
+    // Opening the counters is kept out of the timed samples
+    std::unique_ptr<Perf_counters> pcounters;
+    if (options.hardware_counters) {
+      pcounters.reset(new Perf_counters());
+      pcounters->start();
+    }
+
+    std::vector<double> ns_per_op(options.num_samples);
+    for (double & ns : ns_per_op) ns = time_run(benchmark, iterations) * 1e9 / iterations;
+
+    Benchmark_result result;
+    if (pcounters) {
+      result.counters_per_op = pcounters->stop();
+      for (double & value : result.counters_per_op.values) {
+        value /= static_cast<double>(iterations) * std::max(options.num_samples, 1u);
+      }
+    }
+    result.name = benchmark.name;
+    result.iterations = iterations;
+    result.num_samples = options.num_samples;
+    if (ns_per_op.empty()) return result;
+
+    double sum = 0.0;
+    for (const double kns : ns_per_op) sum += kns;
+    result.ns_per_op = sum / ns_per_op.size();
+
+    double squared_deviations = 0.0;
+    for (const double kns : ns_per_op) {
+      squared_deviations += (kns - result.ns_per_op) * (kns - result.ns_per_op);
+    }
+    if (ns_per_op.size() > 1) {
+      result.ns_per_op_stddev = std::sqrt(squared_deviations / (ns_per_op.size() - 1));
+    }
+    result.ns_per_op_min = *std::min_element(ns_per_op.begin(), ns_per_op.end());
+    result.rays_per_second = benchmark.rays_per_op * 1e9 / result.ns_per_op;
+
+    return result;
+  }
+
+  std::string json_string(const std::string & s)
+  {
+    std::string quoted("\"");
+    for (const char c : s) {
+      if (c == '"' || c == '\\') quoted += '\\';
+      quoted += c;
+    }
+
+    return quoted + "\"";
+  }
+
+  std::ostream & operator<<(std::ostream & os, const Benchmark_result & result)
+  {
+    const double krelative_stddev = (result.ns_per_op > 0.0)
+                                    ? 100.0 * result.ns_per_op_stddev / result.ns_per_op
+                                    : 0.0;
+    const std::ios::fmtflags kflags = os.flags();
+    os << std::left << std::setw(24) << result.name << std::right << std::fixed
+       << std::setprecision(2) << std::setw(12) << result.ns_per_op << " ns/op +- "
+       << std::setw(5) << krelative_stddev << "%  min " << std::setw(10)
+       << result.ns_per_op_min << " ns";
+    if (result.rays_per_second > 0.0) {
+      os << std::setw(10) << result.rays_per_second * 1e-6 << " Mrays/s";
+    }
+    os.flags(kflags);
+
+    // Counts per operation can be well below one, like cache misses
+    const Perf_counts & kcounts = result.counters_per_op;
+    const std::streamsize kprecision = os.precision(4);
+    bool first = true;
+    for (unsigned i = 0; i != knum_perf_counters; ++i) {
+      if (!kcounts.available[i]) continue;
+      os << (first ? "\n" + std::string(24, ' ') : std::string(",")) << " "
+         << perf_counter_name(static_cast<Perf_counter>(i)) << " " << kcounts.values[i];
+      first = false;
+    }
+    if (!first) os << " per op";
+    if (kcounts.available[Perf_counter::kcycles] &&
+        kcounts.available[Perf_counter::kinstructions] &&
+        kcounts.values[Perf_counter::kcycles] > 0.0) {
+      os << ", IPC " << kcounts.values[Perf_counter::kinstructions] /
+                        kcounts.values[Perf_counter::kcycles];
+    }
+    os.precision(kprecision);
+
+    return os;
+  }
+
+  void write_benchmark_json(std::ostream & os, const std::string & label,
+                            const std::vector<Benchmark_result> & results)
+  {
+    const std::ios::fmtflags kflags = os.flags();
+    os << std::setprecision(9);
+    os << "{\n  \"label\": " << json_string(label) << ",\n  \"benchmarks\": [";
+    for (std::size_t i = 0; i != results.size(); ++i) {
+      const Benchmark_result & kresult = results[i];
+      os << (i ? ",\n" : "\n") << "    { \"name\": " << json_string(kresult.name)
+         << ", \"iterations\": " << kresult.iterations
+         << ", \"samples\": " << kresult.num_samples
+         << ", \"ns_per_op\": " << kresult.ns_per_op
+         << ", \"ns_per_op_stddev\": " << kresult.ns_per_op_stddev
+         << ", \"ns_per_op_min\": " << kresult.ns_per_op_min
+         << ", \"rays_per_second\": " << kresult.rays_per_second;
+      // Only the counters that were read, per operation
+      const Perf_counts & kcounts = kresult.counters_per_op;
+      for (unsigned j = 0; j != knum_perf_counters; ++j) {
+        if (!kcounts.available[j]) continue;
+        os << ", \"" << perf_counter_name(static_cast<Perf_counter>(j)) << "_per_op\": "
+           << kcounts.values[j];
+      }
+      os << " }";
+    }
+    os << "\n  ]\n}\n";
+    os.flags(kflags);
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef LUX_BENCH_BENCHMARK_H_
+#define LUX_BENCH_BENCHMARK_H_
+
+#include <cstddef>
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <ostream>
+
+#include "bench/perf_counters.h"
+
+namespace lux {
+  // Keeps the compiler from optimizing away the computation of value
+  template<typename T>
+  inline void do_not_optimize(const T & value)
+  {
+    asm volatile("" : : "r,m"(value) : "memory");
+  }
+
+  // body(n) performs n operations of the kernel, cycling over inputs prepared beforehand
+  // with a fixed seed, so runs are repeatable.
+  struct Benchmark {
+    std::string name;
+    unsigned rays_per_op;  // 0 for kernels that don't trace rays
+    std::function<void(std::size_t)> body;
+  };
+
+  struct Benchmark_options {
+    unsigned num_samples = 10;         // Timed runs of each benchmark
+    double min_sample_seconds = 0.05;  // Iterations are added until a run takes this long
+    bool hardware_counters = false;    // Reads the perf_event_open counters of the samples
+  };
+
+  struct Benchmark_result {
+    std::string name;
+    std::size_t iterations = 0;  // Operations per sample
+    unsigned num_samples = 0;
+    double ns_per_op = 0.0;      // Mean over the samples
+    double ns_per_op_stddev = 0.0;
+    double ns_per_op_min = 0.0;
+    double rays_per_second = 0.0;
+    Perf_counts counters_per_op;  // Averaged over the samples, the unavailable ones are unset
+  };
+
+  // Picks the iterations from an untimed calibration run, then times the samples. The
+  // hardware counters, when asked for, count over the timed samples only.
+  Benchmark_result run_benchmark(const Benchmark & benchmark, const Benchmark_options & options);
+
+  // One line of a table, with the standard deviation relative to the mean, followed by a
+  // line of the hardware counters per operation if any was read
+  std::ostream & operator<<(std::ostream & os, const Benchmark_result & result);
+
+  // Quotes s for JSON output. Names and labels are plain text, only quotes and
+  // backslashes are escaped.
+  std::string json_string(const std::string & s);
+
+  // label identifies the run, e.g. a commit, when results are compared across runs
+  void write_benchmark_json(std::ostream & os, const std::string & label,
+                            const std::vector<Benchmark_result> & results);
+}
+
+#endif
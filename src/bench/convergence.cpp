@@ -0,0 +1,243 @@
+#include "bench/convergence.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <memory>
+
+#include "core/film.h"
+#include "core/film_stream.h"
+#include "core/image_writer.h"
+#include "core/post_process.h"
+#include "core/render_settings.h"
+#include "core/renderer.h"
+#include "core/rgb_spectrum.h"
+#include "core/scene.h"
+#include "scenes/cornell_box.h"
+#include "scenes/stress_scenes.h"
+#include "bench/benchmark.h"
+
+namespace lux {
+  namespace {
+    // The reference samples come from passes far after the ones the measurements take
+    const unsigned kreference_pass = 1u << 16;
+
+    // Added to the squared reference value of relMSE, so black pixels don't dominate it
+    const double krel_mse_epsilon = 1e-2;
+
+    std::string reference_path(const Convergence_options & options,
+                               const Reference_scene & scene)
+    {
+      return options.reference_dir + "/" + scene.name + ".pfm";
+    }
+
+    void set_up_scene(const Reference_scene & reference_scene,
+                      const Convergence_options & options, const unsigned samples,
+                      Scene * pscene, Render_settings * psettings)
+    {
+      reference_scene.add(pscene, psettings);
+      psettings->width = options.width;
+      psettings->height = options.height;
+      psettings->samples_x = samples;
+      psettings->samples_y = samples;
+      psettings->num_threads = options.num_threads;
+      pscene->finalize(bvh_build_options(*psettings));
+    }
+
+    // Reads the little endian PFM files write_image writes, into rows from the top
+    bool read_pfm(const std::string & path, const unsigned width, const unsigned height,
+                  std::vector<float> * pvalues)
+    {
+      std::ifstream file(path, std::ios::binary);
+      std::string magic;
+      unsigned file_width, file_height;
+      float scale;
+      file >> magic >> file_width >> file_height >> scale;
+      file.get();
+      if (!file || magic != "PF" || file_width != width || file_height != height ||
+          scale >= 0.0f) {
+        return false;
+      }
+
+      const std::size_t krow_count = std::size_t(3) * width;
+      std::vector<unsigned char> row(4 * krow_count);
+      pvalues->resize(krow_count * height);
+      for (unsigned y = height; y-- != 0;) {
+        file.read(reinterpret_cast<char *>(row.data()), row.size());
+        for (std::size_t i = 0; i != krow_count; ++i) {
+          const std::uint32_t kbits = row[4 * i] | (row[4 * i + 1] << 8) |
+                                      (row[4 * i + 2] << 16) |
+                                      (std::uint32_t(row[4 * i + 3]) << 24);
+          std::memcpy(&(*pvalues)[y * krow_count + i], &kbits, sizeof(kbits));
+        }
+      }
+
+      return static_cast<bool>(file);
+    }
+
+    void add_spheres_1k(Scene * pscene, Render_settings * psettings)
+    {
+      add_stress_scene(Stress_scene_type::krandom_spheres, 1000, pscene, psettings);
+    }
+
+    void add_lights_64(Scene * pscene, Render_settings * psettings)
+    {
+      add_stress_scene(Stress_scene_type::karea_lights, 64, pscene, psettings);
+    }
+
+    // Adds the pixels of film to psum, 3 values per pixel in scanline order
+    void accumulate(const Film & film, std::vector<double> * psum)
+    {
+      for (unsigned y = 0; y != film.get_height(); ++y) {
+        for (unsigned x = 0; x != film.get_width(); ++x) {
+          const RGB_spectrum & kpixel = film.pixel(x, y);
+          for (unsigned c = 0; c != 3; ++c) {
+            (*psum)[(std::size_t(y) * film.get_width() + x) * 3 + c] += kpixel[c];
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<Reference_scene> reference_scenes()
+  {
+    return { { "cornell_box", add_cornell_box }, { "spheres_1k", add_spheres_1k },
+             { "lights_64", add_lights_64 } };
+  }
+
+  bool render_reference(const Reference_scene & reference_scene,
+                        const Convergence_options & options, std::string * perror)
+  {
+    Scene scene;
+    Render_settings settings;
+    set_up_scene(reference_scene, options, options.reference_samples, &scene, &settings);
+
+    Film film(options.width, options.height);
+    Film_stream film_stream(&film, std::vector<std::unique_ptr<Image_stream>>());
+    render(scene, settings, &film_stream, kreference_pass);
+
+    const std::string kpath = reference_path(options, reference_scene);
+    if (!write_image(kpath, film, Image_format::kpfm, Post_process_options())) {
+      *perror = "Couldn't write " + kpath;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool measure_convergence(const Reference_scene & reference_scene,
+                           const Convergence_options & options, Convergence_result * presult,
+                           std::string * perror)
+  {
+    std::vector<float> reference;
+    const std::string kpath = reference_path(options, reference_scene);
+    if (!read_pfm(kpath, options.width, options.height, &reference)) {
+      *perror = "Couldn't read the reference " + kpath + ", render it with --make-references";
+      return false;
+    }
+
+    Scene scene;
+    Render_settings settings;
+    set_up_scene(reference_scene, options, options.pass_samples, &scene, &settings);
+
+    presult->scene = reference_scene.name;
+    presult->points.clear();
+    presult->seconds_to_target = -1.0;
+
+    std::vector<double> sum(reference.size(), 0.0);
+    double seconds = 0.0;
+    for (unsigned pass = 0; seconds < options.time_limit_seconds; ++pass) {
+      const std::chrono::steady_clock::time_point kstart = std::chrono::steady_clock::now();
+      Film film(options.width, options.height);
+      Film_stream film_stream(&film, std::vector<std::unique_ptr<Image_stream>>());
+      render(scene, settings, &film_stream, pass);
+      const std::chrono::duration<double> kpass_time = std::chrono::steady_clock::now() - kstart;
+      seconds += kpass_time.count();
+
+      accumulate(film, &sum);
+      double squared_error = 0.0;
+      double rel_squared_error = 0.0;
+      for (std::size_t i = 0; i != sum.size(); ++i) {
+        const double kerror = sum[i] / (pass + 1) - reference[i];
+        squared_error += kerror * kerror;
+        rel_squared_error += kerror * kerror /
+                             (double(reference[i]) * reference[i] + krel_mse_epsilon);
+      }
+
+      Convergence_point point;
+      point.seconds = seconds;
+      point.samples_per_pixel = (pass + 1) * options.pass_samples * options.pass_samples;
+      point.rmse = std::sqrt(squared_error / sum.size());
+      point.rel_mse = rel_squared_error / sum.size();
+      presult->points.push_back(point);
+
+      // Interpolates between the passes around the crossing, the error falls about as 1 / t
+      if (presult->seconds_to_target < 0.0 && point.rel_mse <= options.target_rel_mse) {
+        presult->seconds_to_target = point.seconds;
+        if (presult->points.size() > 1) {
+          const Convergence_point & kprevious = presult->points[presult->points.size() - 2];
+          const double kt = (1.0 / options.target_rel_mse - 1.0 / kprevious.rel_mse) /
+                            (1.0 / point.rel_mse - 1.0 / kprevious.rel_mse);
+          presult->seconds_to_target = kprevious.seconds + kt * (point.seconds -
+                                                                 kprevious.seconds);
+        }
+      }
+    }
+
+    return true;
+  }
+
+  std::ostream & operator<<(std::ostream & os, const Convergence_result & result)
+  {
+    os << std::left << std::setw(24) << result.scene << std::right;
+    if (result.seconds_to_target >= 0.0) {
+      os << " target reached in " << result.seconds_to_target << " s";
+    }
+    else {
+      os << " target not reached";
+    }
+    if (!result.points.empty()) {
+      const Convergence_point & klast = result.points.back();
+      os << ", " << klast.samples_per_pixel << " spp in " << klast.seconds << " s: RMSE "
+         << klast.rmse << ", relMSE " << klast.rel_mse;
+    }
+
+    return os;
+  }
+
+  void write_convergence_json(std::ostream & os, const std::string & label,
+                              const Convergence_options & options,
+                              const std::vector<Convergence_result> & results)
+  {
+    const std::ios::fmtflags kflags = os.flags();
+    os << std::setprecision(9);
+    os << "{\n  \"label\": " << json_string(label) << ",\n  \"resolution\": [" << options.width
+       << ", " << options.height << "],\n  \"target_rel_mse\": " << options.target_rel_mse
+       << ",\n  \"scenes\": [";
+    for (std::size_t i = 0; i != results.size(); ++i) {
+      const Convergence_result & kresult = results[i];
+      os << (i ? ",\n" : "\n") << "    { \"name\": " << json_string(kresult.scene)
+         << ", \"seconds_to_target\": ";
+      if (kresult.seconds_to_target >= 0.0) os << kresult.seconds_to_target;
+      else os << "null";
+      os << ",\n      \"points\": [";
+      for (std::size_t j = 0; j != kresult.points.size(); ++j) {
+        const Convergence_point & kpoint = kresult.points[j];
+        os << (j ? ", " : "") << "{ \"seconds\": " << kpoint.seconds
+           << ", \"spp\": " << kpoint.samples_per_pixel << ", \"rmse\": " << kpoint.rmse
+           << ", \"rel_mse\": " << kpoint.rel_mse << " }";
+      }
+      os << "] }";
+    }
+    os << "\n  ]\n}\n";
+    os.flags(kflags);
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef LUX_BENCH_CONVERGENCE_H_
+#define LUX_BENCH_CONVERGENCE_H_
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace lux { class Scene; struct Render_settings; }
+
+namespace lux {
+  // Scene of the time to error benchmark. add puts its shapes in pscene and sets the
+  // camera of psettings.
+  struct Reference_scene {
+    std::string name;
+    void (*add)(Scene * pscene, Render_settings * psettings);
+  };
+
+  std::vector<Reference_scene> reference_scenes();
+
+  struct Convergence_options {
+    unsigned width = 128;
+    unsigned height = 128;
+    unsigned pass_samples = 2;        // Each pass takes pass_samples^2 samples per pixel
+    unsigned reference_samples = 64;  // The reference takes reference_samples^2
+    double time_limit_seconds = 30.0;
+    double target_rel_mse = 0.1;
+    unsigned num_threads = 0;         // 0 uses every core
+    std::string reference_dir = "references";
+  };
+
+  // Error of the average of the passes rendered after seconds of render time
+  struct Convergence_point {
+    double seconds;
+    unsigned samples_per_pixel;
+    double rmse;
+    double rel_mse;  // Squared error over the squared reference value, averaged
+  };
+
+  struct Convergence_result {
+    std::string scene;
+    std::vector<Convergence_point> points;
+    double seconds_to_target = -1.0;  // Negative if the target wasn't reached in time
+  };
+
+  // Renders the reference of scene as a PFM file in options.reference_dir, with samples
+  // independent of the ones the measurements take. Returns false on I/O errors.
+  bool render_reference(const Reference_scene & scene, const Convergence_options & options,
+                        std::string * perror);
+
+  // Renders passes of scene until the time limit, measuring the error of their average
+  // against the stored reference after each one. Only render time is counted.
+  bool measure_convergence(const Reference_scene & scene, const Convergence_options & options,
+                           Convergence_result * presult, std::string * perror);
+
+  // The headline time to reach the target and the last error
+  std::ostream & operator<<(std::ostream & os, const Convergence_result & result);
+
+  void write_convergence_json(std::ostream & os, const std::string & label,
+                              const Convergence_options & options,
+                              const std::vector<Convergence_result> & results);
+}
+
+#endif
@@ -0,0 +1,146 @@
+#include "bench/perf_counters.h"
+
+#if defined(__linux__)
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <string>
+
+namespace lux {
+  namespace {
+    const char * const kcounter_names[knum_perf_counters] = {
+      "cycles", "instructions", "cache_misses", "branch_misses", "dtlb_misses"
+    };
+
+#if defined(__linux__)
+    void set_counter_event(const Perf_counter counter, perf_event_attr * pattr)
+    {
+      pattr->type = PERF_TYPE_HARDWARE;
+      switch (counter) {
+        case Perf_counter::kcycles:
+          pattr->config = PERF_COUNT_HW_CPU_CYCLES;
+          break;
+        case Perf_counter::kinstructions:
+          pattr->config = PERF_COUNT_HW_INSTRUCTIONS;
+          break;
+        case Perf_counter::kcache_misses:
+          pattr->config = PERF_COUNT_HW_CACHE_MISSES;
+          break;
+        case Perf_counter::kbranch_misses:
+          pattr->config = PERF_COUNT_HW_BRANCH_MISSES;
+          break;
+        default:
+          pattr->type = PERF_TYPE_HW_CACHE;
+          pattr->config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+          break;
+      }
+    }
+
+    // Returns -1 and sets errno if the counter can't be opened
+    int open_counter(const Perf_counter counter)
+    {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      set_counter_event(counter, &attr);
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      // The calling thread on any CPU, with no group leader
+      return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+  }
+
+  const char * perf_counter_name(const Perf_counter counter)
+  {
+    return kcounter_names[counter];
+  }
+
+  Perf_counts::Perf_counts()
+  {
+    for (unsigned i = 0; i != knum_perf_counters; ++i) {
+      available[i] = false;
+      values[i] = 0.0;
+    }
+  }
+
+  Perf_counters::Perf_counters()
+  {
+    for (unsigned i = 0; i != knum_perf_counters; ++i) {
+      m_fds[i] = -1;
+#if defined(__linux__)
+      m_fds[i] = open_counter(static_cast<Perf_counter>(i));
+      if (m_fds[i] < 0 && m_error.empty()) {
+        m_error = std::string(kcounter_names[i]) + ": " + std::strerror(errno);
+      }
+#endif
+    }
+#if !defined(__linux__)
+    m_error = "perf_event_open is only available on Linux";
+#endif
+  }
+
+  Perf_counters::~Perf_counters()
+  {
+#if defined(__linux__)
+    for (const int kfd : m_fds) {
+      if (kfd >= 0) ::close(kfd);
+    }
+#endif
+  }
+
+  bool Perf_counters::is_open() const
+  {
+    for (const int kfd : m_fds) {
+      if (kfd >= 0) return true;
+    }
+
+    return false;
+  }
+
+  void Perf_counters::start()
+  {
+#if defined(__linux__)
+    for (const int kfd : m_fds) {
+      if (kfd < 0) continue;
+      ::ioctl(kfd, PERF_EVENT_IOC_RESET, 0);
+      ::ioctl(kfd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  Perf_counts Perf_counters::stop()
+  {
+    Perf_counts counts;
+#if defined(__linux__)
+    for (const int kfd : m_fds) {
+      if (kfd >= 0) ::ioctl(kfd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    for (unsigned i = 0; i != knum_perf_counters; ++i) {
+      // The value, then the times the counter was enabled and actually counting
+      std::uint64_t values[3];
+      if (m_fds[i] < 0 || ::read(m_fds[i], values, sizeof(values)) != sizeof(values) ||
+          values[2] == 0) {
+        continue;
+      }
+
+      counts.available[i] = true;
+      counts.values[i] = static_cast<double>(values[0]) * values[1] / values[2];
+    }
+#endif
+
+    return counts;
+  }
+}
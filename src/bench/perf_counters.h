@@ -0,0 +1,54 @@
+#ifndef LUX_BENCH_PERF_COUNTERS_H_
+#define LUX_BENCH_PERF_COUNTERS_H_
+
+#include <string>
+
+namespace lux {
+  enum Perf_counter {
+    kcycles,
+    kinstructions,
+    kcache_misses,   // Last level cache misses
+    kbranch_misses,
+    kdtlb_misses,    // Data TLB read misses
+    knum_perf_counters
+  };
+
+  const char * perf_counter_name(const Perf_counter counter);
+
+  struct Perf_counts {
+    Perf_counts();
+
+    bool available[knum_perf_counters];
+    double values[knum_perf_counters];
+  };
+
+  // Hardware counters of the calling thread, read with perf_event_open and only counting
+  // user space. The counters the kernel or the CPU don't provide, e.g. in containers and
+  // virtual machines without a PMU, are left out, is_open() is false if none could be
+  // opened and get_error() tells why the first one couldn't.
+  class Perf_counters final {
+    public:
+      Perf_counters();
+      ~Perf_counters();
+
+      Perf_counters(const Perf_counters &) = delete;
+      Perf_counters & operator=(const Perf_counters &) = delete;
+
+      bool is_open() const;
+      bool is_available(const Perf_counter counter) const { return m_fds[counter] >= 0; }
+      const std::string & get_error() const { return m_error; }
+
+      // Resets the counters and starts counting
+      void start();
+
+      // Stops counting and returns the counts since start(), scaled up when the kernel
+      // multiplexed the counters with other events
+      Perf_counts stop();
+
+    private:
+      int m_fds[knum_perf_counters];
+      std::string m_error;
+  };
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include "bench/scaling.h"
+
+#include <cstddef>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+
+#include "core/film.h"
+#include "core/film_stream.h"
+#include "core/image_writer.h"
+#include "core/renderer.h"
+#include "core/render_settings.h"
+#include "core/render_stats.h"
+#include "core/resource_usage.h"
+#include "core/scene.h"
+#include "accelerators/bvh.h"
+#include "bench/benchmark.h"
+
+namespace lux {
+  Scaling_point measure_scaling(const Stress_scene_type type, const unsigned count,
+                                const Scaling_options & options)
+  {
+    Scaling_point point;
+    point.scene = stress_scene_name(type);
+    point.count = count;
+
+    const Resource_usage kstart_usage = get_resource_usage();
+    const std::chrono::steady_clock::time_point kstart = std::chrono::steady_clock::now();
+    Scene scene;
+    Render_settings settings;
+    add_stress_scene(type, count, &scene, &settings);
+    settings.num_threads = options.num_threads;
+    scene.finalize(bvh_build_options(settings));
+    const std::chrono::duration<double> kbuild_time = std::chrono::steady_clock::now() - kstart;
+    const Resource_usage kbuilt_usage = get_resource_usage();
+
+    point.num_shapes = scene.get_shapes().size();
+    point.num_lights = scene.get_lights().size();
+    point.build_seconds = kbuild_time.count();
+    point.bvh_bytes = scene.get_accelerator()->get_build_stats().memory_bytes;
+    point.resident_bytes = (kbuilt_usage.resident_bytes > kstart_usage.resident_bytes)
+                           ? kbuilt_usage.resident_bytes - kstart_usage.resident_bytes
+                           : 0;
+
+    settings.width = options.width;
+    settings.height = options.height;
+    settings.samples_x = options.samples;
+    settings.samples_y = options.samples;
+    Film film(settings.width, settings.height);
+    Film_stream film_stream(&film, std::vector<std::unique_ptr<Image_stream>>());
+    Render_stats stats;
+    const std::chrono::steady_clock::time_point krender_start = std::chrono::steady_clock::now();
+    render(scene, settings, &film_stream, 0, Render_progress(), &stats);
+    const std::chrono::duration<double> krender_time =
+        std::chrono::steady_clock::now() - krender_start;
+
+    point.render_seconds = krender_time.count();
+    const double krays = double(stats.counters[kcamera_rays]) + stats.counters[kindirect_rays] +
+                         stats.counters[kshadow_rays];
+    point.rays_per_second = (point.render_seconds > 0.0) ? krays / point.render_seconds : 0.0;
+
+    return point;
+  }
+
+  std::ostream & operator<<(std::ostream & os, const Scaling_point & point)
+  {
+    const std::ios::fmtflags kflags = os.flags();
+    os << std::left << std::setw(20) << point.scene << std::right << std::setw(10)
+       << point.count << std::setw(10) << point.num_shapes << " shapes" << std::setw(8)
+       << point.num_lights << " lights" << std::fixed << std::setprecision(2)
+       << std::setw(10) << point.build_seconds * 1000.0 << " ms build" << std::setw(10)
+       << point.bvh_bytes / (1024.0 * 1024.0) << " MiB BVH" << std::setw(10)
+       << point.resident_bytes / (1024.0 * 1024.0) << " MiB resident" << std::setw(8)
+       << point.rays_per_second * 1e-6 << " Mrays/s";
+    os.flags(kflags);
+
+    return os;
+  }
+
+  void write_scaling_json(std::ostream & os, const std::string & label,
+                          const Scaling_options & options,
+                          const std::vector<Scaling_point> & points)
+  {
+    const std::ios::fmtflags kflags = os.flags();
+    os << std::setprecision(9);
+    os << "{\n  \"label\": " << json_string(label) << ",\n  \"resolution\": [" << options.width
+       << ", " << options.height << "],\n  \"spp\": " << options.samples * options.samples
+       << ",\n  \"points\": [";
+    for (std::size_t i = 0; i != points.size(); ++i) {
+      const Scaling_point & kpoint = points[i];
+      os << (i ? ",\n" : "\n") << "    { \"scene\": " << json_string(kpoint.scene)
+         << ", \"count\": " << kpoint.count << ", \"shapes\": " << kpoint.num_shapes
+         << ", \"lights\": " << kpoint.num_lights
+         << ", \"build_seconds\": " << kpoint.build_seconds
+         << ", \"bvh_bytes\": " << kpoint.bvh_bytes
+         << ", \"resident_bytes\": " << kpoint.resident_bytes
+         << ", \"render_seconds\": " << kpoint.render_seconds
+         << ", \"rays_per_second\": " << kpoint.rays_per_second << " }";
+    }
+    os << "\n  ]\n}\n";
+    os.flags(kflags);
+  }
+}
@@ -0,0 +1,47 @@
+#ifndef LUX_BENCH_SCALING_H_
+#define LUX_BENCH_SCALING_H_
+
+#include <cstddef>
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "scenes/stress_scenes.h"
+
+namespace lux {
+  struct Scaling_options {
+    unsigned min_count = 100;       // Counts go up tenfold from min_count to max_count
+    unsigned max_count = 100000;
+    unsigned width = 128;
+    unsigned height = 128;
+    unsigned samples = 1;           // Each render takes samples^2 samples per pixel
+    unsigned num_threads = 0;       // 0 uses every core
+  };
+
+  struct Scaling_point {
+    std::string scene;
+    unsigned count;
+    std::size_t num_shapes;        // Top level shapes, an instance counts as one
+    std::size_t num_lights;
+    double build_seconds;          // Generating the scene and building its BVH
+    std::size_t bvh_bytes;         // Top level BVH nodes and references
+    std::size_t resident_bytes;    // Growth of the resident set while building
+    double render_seconds;
+    double rays_per_second;        // Camera, indirect and shadow rays
+  };
+
+  // Generates the count sized scene of type, builds it and renders it once, on fresh
+  // allocations each time. The resident growth misses memory the allocator reuses from an
+  // earlier, at most ten times smaller, point.
+  Scaling_point measure_scaling(const Stress_scene_type type, const unsigned count,
+                                const Scaling_options & options);
+
+  std::ostream & operator<<(std::ostream & os, const Scaling_point & point);
+
+  void write_scaling_json(std::ostream & os, const std::string & label,
+                          const Scaling_options & options,
+                          const std::vector<Scaling_point> & points);
+}
+
+#endif
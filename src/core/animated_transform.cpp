@@ -0,0 +1,270 @@
+#include "core/animated_transform.h"
+
+#include <cmath>
+
+#include <vector>
+#include <algorithm>
+
+#include "core/mat4.h"
+#include "core/vec3.h"
+#include "core/transform.h"
+#include "core/bounds3.h"
+#include "core/error.h"
+
+namespace lux {
+  namespace {
+    // Rows of the rotation matrix further from orthogonal than this are taken as a shear
+    const float korthogonality_tolerance = 1e-4f;
+
+    // Below this angle the rotations are linearly interpolated and normalized
+    const float kmin_slerp_angle = 1e-3f;
+
+    // Rows apply to points as row vectors, as in Mat4, so a matrix that scales and then
+    // rotates has rows scale[i] * rotation row i. Returns false for shears, projections
+    // and degenerate matrices.
+    bool decompose(const Transform & transform, Vec3 * pscale, float (*protation)[3],
+                   Vec3 * ptranslation)
+    {
+      if (transform.get_type() == Transform_type::kprojective) return false;
+
+      const Mat4 & m = transform.get_matrix();
+      Vec3 rows[3];
+      for (unsigned i = 0; i != 3; ++i) {
+        rows[i] = Vec3(m(i, 0), m(i, 1), m(i, 2));
+        (*pscale)[i] = rows[i].magnitude();
+        if ((*pscale)[i] == 0.0f) return false;
+        rows[i] /= (*pscale)[i];
+      }
+
+      if (std::abs(dot(rows[0], rows[1])) > korthogonality_tolerance ||
+          std::abs(dot(rows[0], rows[2])) > korthogonality_tolerance ||
+          std::abs(dot(rows[1], rows[2])) > korthogonality_tolerance) {
+        return false;
+      }
+
+      // A mirroring is kept in the scale, so the rotation is proper
+      if (dot(cross(rows[0], rows[1]), rows[2]) < 0.0f) {
+        (*pscale)[0] = -(*pscale)[0];
+        rows[0] = -rows[0];
+      }
+
+      for (unsigned i = 0; i != 3; ++i) {
+        for (unsigned j = 0; j != 3; ++j) protation[i][j] = rows[i][j];
+      }
+      *ptranslation = Vec3(m(3, 0), m(3, 1), m(3, 2));
+
+      return true;
+    }
+
+    // The quaternion of r, which rotates row vectors, so it holds the transpose of the
+    // column vector rotation the usual formulas are written for.
+    void rotation_to_quaternion(const float (*r)[3], float * q)
+    {
+      const float ktrace = r[0][0] + r[1][1] + r[2][2];
+      if (ktrace > 0.0f) {
+        const float s = 2.0f * std::sqrt(ktrace + 1.0f);
+        q[0] = (r[1][2] - r[2][1]) / s;
+        q[1] = (r[2][0] - r[0][2]) / s;
+        q[2] = (r[0][1] - r[1][0]) / s;
+        q[3] = 0.25f * s;
+      }
+      else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        const float s = 2.0f * std::sqrt(1.0f + r[0][0] - r[1][1] - r[2][2]);
+        q[0] = 0.25f * s;
+        q[1] = (r[1][0] + r[0][1]) / s;
+        q[2] = (r[2][0] + r[0][2]) / s;
+        q[3] = (r[1][2] - r[2][1]) / s;
+      }
+      else if (r[1][1] > r[2][2]) {
+        const float s = 2.0f * std::sqrt(1.0f + r[1][1] - r[0][0] - r[2][2]);
+        q[0] = (r[1][0] + r[0][1]) / s;
+        q[1] = 0.25f * s;
+        q[2] = (r[2][1] + r[1][2]) / s;
+        q[3] = (r[2][0] - r[0][2]) / s;
+      }
+      else {
+        const float s = 2.0f * std::sqrt(1.0f + r[2][2] - r[0][0] - r[1][1]);
+        q[0] = (r[2][0] + r[0][2]) / s;
+        q[1] = (r[2][1] + r[1][2]) / s;
+        q[2] = 0.25f * s;
+        q[3] = (r[0][1] - r[1][0]) / s;
+      }
+    }
+
+    // Inverse of rotation_to_quaternion, q is a unit quaternion
+    void quaternion_to_rotation(const float * q, float (*r)[3])
+    {
+      const float x = q[0], y = q[1], z = q[2], w = q[3];
+      r[0][0] = 1.0f - 2.0f * (y * y + z * z);
+      r[0][1] = 2.0f * (x * y + z * w);
+      r[0][2] = 2.0f * (x * z - y * w);
+      r[1][0] = 2.0f * (x * y - z * w);
+      r[1][1] = 1.0f - 2.0f * (x * x + z * z);
+      r[1][2] = 2.0f * (y * z + x * w);
+      r[2][0] = 2.0f * (x * z + y * w);
+      r[2][1] = 2.0f * (y * z - x * w);
+      r[2][2] = 1.0f - 2.0f * (x * x + y * y);
+    }
+  }
+
+  Animated_transform::Animated_transform(const Transform & transform)
+      : m_keyframes(1, Keyframe{ 0.0f, transform }),
+        m_decomposed(false)
+  {
+    decompose_keyframes();
+  }
+
+  Animated_transform::Animated_transform(const Transform & start_transform,
+                                         const float start_time,
+                                         const Transform & end_transform,
+                                         const float end_time)
+      : m_keyframes(1, Keyframe{ start_time, start_transform }),
+        m_decomposed(false)
+  {
+    add_keyframe(end_time, end_transform);
+  }
+
+  void Animated_transform::add_keyframe(const float time, const Transform & transform)
+  {
+    ASSERT(transform.get_type() != Transform_type::kprojective,
+           "Animated transforms only support affine keyframes");
+
+    const Keyframe kkeyframe = { time, transform };
+    std::vector<Keyframe>::iterator iter =
+        std::upper_bound(m_keyframes.begin(), m_keyframes.end(), kkeyframe,
+                         [](const Keyframe & a, const Keyframe & b) { return a.time < b.time; });
+
+    m_keyframes.insert(iter, kkeyframe);
+    decompose_keyframes();
+  }
+
+  void Animated_transform::decompose_keyframes()
+  {
+    m_decomposed = true;
+    for (std::size_t i = 0; i != m_keyframes.size(); ++i) {
+      Keyframe & keyframe = m_keyframes[i];
+      float rotation[3][3];
+      if (!decompose(keyframe.transform, &keyframe.scale, rotation, &keyframe.translation)) {
+        m_decomposed = false;
+        return;
+      }
+      rotation_to_quaternion(rotation, keyframe.rotation);
+      keyframe.angle = 0.0f;
+
+      if (i == 0) continue;
+
+      // q and -q are the same rotation, the one closer to the previous takes the short way
+      Keyframe & previous = m_keyframes[i - 1];
+      float cos_angle = 0.0f;
+      for (unsigned c = 0; c != 4; ++c) cos_angle += previous.rotation[c] * keyframe.rotation[c];
+      if (cos_angle < 0.0f) {
+        for (unsigned c = 0; c != 4; ++c) keyframe.rotation[c] = -keyframe.rotation[c];
+        cos_angle = -cos_angle;
+      }
+      previous.angle = std::acos(std::min(cos_angle, 1.0f));
+    }
+  }
+
+  Transform Animated_transform::interpolate_components(const Keyframe & k0, const Keyframe & k1,
+                                                       const float t) const
+  {
+    float w0 = 1.0f - t;
+    float w1 = t;
+    if (k0.angle >= kmin_slerp_angle) {
+      const float kinv_sin_angle = 1.0f / std::sin(k0.angle);
+      w0 = std::sin((1.0f - t) * k0.angle) * kinv_sin_angle;
+      w1 = std::sin(t * k0.angle) * kinv_sin_angle;
+    }
+
+    float q[4];
+    float length_squared = 0.0f;
+    for (unsigned c = 0; c != 4; ++c) {
+      q[c] = w0 * k0.rotation[c] + w1 * k1.rotation[c];
+      length_squared += q[c] * q[c];
+    }
+    const float kinv_length = 1.0f / std::sqrt(length_squared);
+    for (float & component : q) component *= kinv_length;
+
+    float r[3][3];
+    quaternion_to_rotation(q, r);
+
+    const Vec3 kscale = (1.0f - t) * k0.scale + t * k1.scale;
+    const Vec3 ktranslation = (1.0f - t) * k0.translation + t * k1.translation;
+
+    // Forward rows are scale[i] * r[i], the inverse is transpose(r) * scale^-1 followed by
+    // the negated translation
+    float inv[3][3];
+    for (unsigned i = 0; i != 3; ++i) {
+      for (unsigned j = 0; j != 3; ++j) inv[i][j] = r[j][i] / kscale[j];
+    }
+    float inv_translation[3];
+    for (unsigned j = 0; j != 3; ++j) {
+      inv_translation[j] = -(ktranslation[0] * inv[0][j] + ktranslation[1] * inv[1][j] +
+                             ktranslation[2] * inv[2][j]);
+    }
+
+    const Mat4 km(kscale[0] * r[0][0], kscale[0] * r[0][1], kscale[0] * r[0][2], 0.0f,
+                  kscale[1] * r[1][0], kscale[1] * r[1][1], kscale[1] * r[1][2], 0.0f,
+                  kscale[2] * r[2][0], kscale[2] * r[2][1], kscale[2] * r[2][2], 0.0f,
+                  ktranslation[0], ktranslation[1], ktranslation[2], 1.0f);
+    const Mat4 km_inv(inv[0][0], inv[0][1], inv[0][2], 0.0f,
+                      inv[1][0], inv[1][1], inv[1][2], 0.0f,
+                      inv[2][0], inv[2][1], inv[2][2], 0.0f,
+                      inv_translation[0], inv_translation[1], inv_translation[2], 1.0f);
+
+    return Transform(km, km_inv);
+  }
+
+  Transform Animated_transform::interpolate(const float time) const
+  {
+    if (!is_animated() || time <= m_keyframes.front().time) {
+      return m_keyframes.front().transform;
+    }
+
+    if (time >= m_keyframes.back().time) return m_keyframes.back().transform;
+
+    // First keyframe after time
+    std::size_t i = 1;
+    while (m_keyframes[i].time <= time) ++i;
+
+    const Keyframe & k0 = m_keyframes[i - 1];
+    const Keyframe & k1 = m_keyframes[i];
+    const float kt = (time - k0.time) / (k1.time - k0.time);
+
+    if (m_decomposed) return interpolate_components(k0, k1, kt);
+
+    return Transform(lerp(kt, k0.transform.get_matrix(), k1.transform.get_matrix()));
+  }
+
+  Bounds3 Animated_transform::motion_bound(const Bounds3 & b) const
+  {
+    Bounds3 bounds;
+    for (std::size_t i = 0; i != m_keyframes.size(); ++i) {
+      bounds = bounds_union(bounds, m_keyframes[i].transform.apply_on_bounds(b));
+    }
+
+    if (!m_decomposed || b.is_empty()) return bounds;
+
+    // The rotation turns the scaled points around the translation, without changing their
+    // distance to it, and the scale of each axis stays between its keyframe values
+    for (std::size_t i = 0; i + 1 < m_keyframes.size(); ++i) {
+      const Keyframe & k0 = m_keyframes[i];
+      const Keyframe & k1 = m_keyframes[i + 1];
+      if (std::equal(k0.rotation, k0.rotation + 4, k1.rotation)) continue;
+
+      float radius_squared = 0.0f;
+      for (unsigned c = 0; c != 3; ++c) {
+        const float kextent = std::max(std::abs(b.p_min[c]), std::abs(b.p_max[c]));
+        const float kscale = std::max(std::abs(k0.scale[c]), std::abs(k1.scale[c]));
+        radius_squared += (kextent * kscale) * (kextent * kscale);
+      }
+      const float kradius = std::sqrt(radius_squared);
+      const Vec3 kextent(kradius, kradius, kradius);
+
+      bounds = bounds_union(bounds, Bounds3(min(k0.translation, k1.translation) - kextent,
+                                            max(k0.translation, k1.translation) + kextent));
+    }
+
+    return bounds;
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef LUX_CORE_ANIMATED_TRANSFORM_H_
+#define LUX_CORE_ANIMATED_TRANSFORM_H_
+
+#include <cstddef>
+
+#include <vector>
+
+#include "core/vec3.h"
+#include "core/transform.h"
+#include "core/bounds3.h"
+
+// Transform defined by keyframes. If every keyframe is a scale followed by a rotation
+// and a translation, the keyframes are decomposed once and interpolated by components:
+// the scale and translation linearly and the rotation spherically. The inverse is then
+// built from the components instead of inverting a matrix at each ray. Otherwise the
+// matrices are linearly interpolated and inverted. Before the first and after the last
+// keyframe the transform is held constant.
+namespace lux {
+  class Animated_transform final {
+    public:
+      explicit Animated_transform(const Transform & transform = Transform());
+      Animated_transform(const Transform & start_transform, const float start_time,
+                         const Transform & end_transform, const float end_time);
+
+      Animated_transform(const Animated_transform &) = default;
+      ~Animated_transform() = default;
+
+      Animated_transform & operator=(const Animated_transform &) = default;
+
+      // Keyframes must be affine, and are kept sorted by time.
+      void add_keyframe(const float time, const Transform & transform);
+
+      bool is_animated() const { return m_keyframes.size() > 1; }
+      const Transform & get_start_transform() const { return m_keyframes.front().transform; }
+
+      // Returns a copy, callers that only see static transforms use get_start_transform()
+      Transform interpolate(const float time) const;
+
+      // Including the keyframes
+      std::size_t memory_bytes() const
+      {
+        return sizeof(*this) + m_keyframes.capacity() * sizeof(Keyframe);
+      }
+
+      // Bounds b over every instant. Without rotation each interpolated point lies between
+      // its images at the surrounding keyframes, so bounding the keyframes is enough. While
+      // rotating, a point stays within its scaled distance from the rotation center.
+      Bounds3 motion_bound(const Bounds3 & b) const;
+
+    private:
+      struct Keyframe {
+        float time;
+        Transform transform;
+
+        // transform is scale(scale) * rotation * translate(translation), if m_decomposed
+        Vec3 scale;
+        float rotation[4];  // Unit quaternion x, y, z, w, on the previous one's hemisphere
+        Vec3 translation;
+        float angle;        // Between rotation and the next keyframe's rotation
+      };
+
+      void decompose_keyframes();
+      Transform interpolate_components(const Keyframe & k0, const Keyframe & k1,
+                                       const float t) const;
+
+      std::vector<Keyframe> m_keyframes;
+      bool m_decomposed;
+  };
+}
+
+#endif
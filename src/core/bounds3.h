@@ -0,0 +1,142 @@
+#ifndef LUX_CORE_BOUNDS3_H_
+#define LUX_CORE_BOUNDS3_H_
+
+#include <limits>
+#include <iostream>
+
+#include "core/vec3.h"
+#include "core/ray.h"
+
+namespace lux {
+  // Axis aligned bounding box. Default constructed bounds are empty, so they
+  // can be grown with bounds_union.
+  struct Bounds3 final {
+    Bounds3() : p_min(), p_max()
+    {
+      const float kmin_num = std::numeric_limits<float>::lowest();
+      const float kmax_num = std::numeric_limits<float>::max();
+
+      p_min.x = p_min.y = p_min.z = kmax_num;
+      p_max.x = p_max.y = p_max.z = kmin_num;
+    }
+    explicit Bounds3(const Vec3 & p) : p_min(p), p_max(p) {}
+    Bounds3(const Vec3 & min, const Vec3 & max) : p_min(min), p_max(max) {}
+    Bounds3(const Bounds3 & bounds3) = default;
+    ~Bounds3() = default;
+
+    Bounds3 & operator=(const Bounds3 & bounds3) = default;
+
+    const Vec3 & operator[](const unsigned i) const;
+
+    Vec3 diagonal() const { return p_max - p_min; }
+    Vec3 centroid() const { return 0.5f * (p_min + p_max); }
+    Vec3 corner(const unsigned i) const;
+    bool is_empty() const;
+    float surface_area() const;
+    unsigned maximum_extent() const;
+    Vec3 offset(const Vec3 & p) const;
+
+    bool intersect_p(const Ray & ray, const Vec3 & inv_dir, const unsigned dir_is_neg[3]) const;
+
+    Vec3 p_min;
+    Vec3 p_max;
+  };
+
+  inline const Vec3 & Bounds3::operator[](const unsigned i) const
+  {
+    ASSERT(i < 2, "Trying to access a non existent bounds corner");
+
+    return (i == 0) ? (p_min) : (p_max);
+  }
+
+  inline Vec3 Bounds3::corner(const unsigned i) const
+  {
+    return Vec3((*this)[i & 1].x, (*this)[(i & 2) ? 1 : 0].y, (*this)[(i & 4) ? 1 : 0].z);
+  }
+
+  inline bool Bounds3::is_empty() const
+  {
+    return p_min.x > p_max.x || p_min.y > p_max.y || p_min.z > p_max.z;
+  }
+
+  inline float Bounds3::surface_area() const
+  {
+    if (is_empty()) return 0.0f;
+
+    const Vec3 d = diagonal();
+    return 2.0f * (d.x * d.y + d.x * d.z + d.y * d.z);
+  }
+
+  inline unsigned Bounds3::maximum_extent() const
+  {
+    const Vec3 d = diagonal();
+    if (d.x > d.y && d.x > d.z) return 0;
+    if (d.y > d.z) return 1;
+    return 2;
+  }
+
+  // Returns the position of p relative to the box corners, p_min maps to (0, 0, 0)
+  // and p_max to (1, 1, 1).
+  inline Vec3 Bounds3::offset(const Vec3 & p) const
+  {
+    Vec3 o = p - p_min;
+    if (p_max.x > p_min.x) o.x /= p_max.x - p_min.x;
+    if (p_max.y > p_min.y) o.y /= p_max.y - p_min.y;
+    if (p_max.z > p_min.z) o.z /= p_max.z - p_min.z;
+
+    return o;
+  }
+
+  // Slab test, inv_dir and dir_is_neg are precomputed once per ray by the caller.
+  // The far distances are slightly enlarged so rounding errors can't make the ray
+  // miss flat boxes, like the ones around axis aligned triangles.
+  inline bool Bounds3::intersect_p(const Ray & ray, const Vec3 & inv_dir,
+                                   const unsigned dir_is_neg[3]) const
+  {
+    const float kfar_scale = 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+    const Bounds3 & b = *this;
+    const Vec3 o = ray.get_origin();
+
+    float t_min = (b[dir_is_neg[0]].x - o.x) * inv_dir.x;
+    float t_max = (b[1 - dir_is_neg[0]].x - o.x) * inv_dir.x * kfar_scale;
+    const float ty_min = (b[dir_is_neg[1]].y - o.y) * inv_dir.y;
+    const float ty_max = (b[1 - dir_is_neg[1]].y - o.y) * inv_dir.y * kfar_scale;
+
+    if (t_min > ty_max || ty_min > t_max) return false;
+    if (ty_min > t_min) t_min = ty_min;
+    if (ty_max < t_max) t_max = ty_max;
+
+    const float tz_min = (b[dir_is_neg[2]].z - o.z) * inv_dir.z;
+    const float tz_max = (b[1 - dir_is_neg[2]].z - o.z) * inv_dir.z * kfar_scale;
+
+    if (t_min > tz_max || tz_min > t_max) return false;
+    if (tz_min > t_min) t_min = tz_min;
+    if (tz_max < t_max) t_max = tz_max;
+
+    return (t_min < ray.get_t_max()) && (t_max > 0.0f);
+  }
+
+  inline Bounds3 bounds_union(const Bounds3 & b, const Vec3 & p)
+  {
+    return Bounds3(min(b.p_min, p), max(b.p_max, p));
+  }
+
+  inline Bounds3 bounds_union(const Bounds3 & a, const Bounds3 & b)
+  {
+    return Bounds3(min(a.p_min, b.p_min), max(a.p_max, b.p_max));
+  }
+
+  // The result is empty when a and b don't overlap.
+  inline Bounds3 bounds_intersect(const Bounds3 & a, const Bounds3 & b)
+  {
+    return Bounds3(max(a.p_min, b.p_min), min(a.p_max, b.p_max));
+  }
+
+  inline std::ostream & operator<<(std::ostream & os, const Bounds3 & b)
+  {
+    os << "[ " << b.p_min << " - " << b.p_max << " ]";
+
+    return os;
+  }
+}
+#endif
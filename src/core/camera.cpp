@@ -11,11 +11,14 @@
 
 namespace lux {
   Camera::Camera(const Vec2 & image_resolution, const Transform & cam_to_world, const float fov,
-                 const float lens_radius, const float focal_distance)
+                 const float lens_radius, const float focal_distance,
+                 const float shutter_open, const float shutter_close)
       : m_image_resolution(image_resolution),
         m_screen_window(),
         m_lens_radius(lens_radius),
         m_focal_distance(focal_distance),
+        m_shutter_open(shutter_open),
+        m_shutter_close(shutter_close),
         m_near(1.0f),
         m_camera_space_lower_left(),
         m_horizontal(),
@@ -55,6 +58,8 @@ namespace lux {
     cam_space_coord += (1.0f - normalized_raster_coord.y) * m_vertical;
 
     Ray ray(Vec3(0.0f, 0.0f, 0.0f), normalize(cam_space_coord));
+    ray.set_time((1.0f - camera_sample.time) * m_shutter_open +
+                 camera_sample.time * m_shutter_close);
 
     if (m_lens_radius > 0.0f) {
       const Vec2 klens_sample = m_lens_radius * concentric_sample_disk(camera_sample.lens_coord);
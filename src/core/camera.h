@@ -12,18 +12,22 @@ namespace lux {
   struct Camera_sample {
     Vec2 raster_coord;
     Vec2 lens_coord;
+    float time;  // In [0, 1), mapped over the shutter interval
   };
 
   class Camera {
     public:
       Camera(const Vec2 & image_resolution, const Transform & cam_to_world, const float fov = 90.0f,
-             const float lens_radius = 0.0f, const float focal_distance = 1e6);
+             const float lens_radius = 0.0f, const float focal_distance = 1e6,
+             const float shutter_open = 0.0f, const float shutter_close = 0.0f);
       Ray generate_ray(const Camera_sample & camera_sample) const;
     private:
       Vec2 m_image_resolution;
       Bounds2 m_screen_window;
       float m_lens_radius;
       float m_focal_distance;
+      float m_shutter_open;
+      float m_shutter_close;
       float m_near;
       Vec3 m_camera_space_lower_left;
       Vec3 m_horizontal;
@@ -0,0 +1,85 @@
+#include "core/cost_map.h"
+
+#include <cstddef>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "core/film.h"
+#include "core/rgb_spectrum.h"
+#include "core/error.h"
+
+namespace lux {
+  namespace {
+    // Black, blue, red, yellow and white, evenly spaced over [0, 1]
+    RGB_spectrum heat_color(const float t)
+    {
+      static const RGB_spectrum kstops[5] = {
+        RGB_spectrum(0.0f, 0.0f, 0.0f), RGB_spectrum(0.0f, 0.0f, 1.0f),
+        RGB_spectrum(1.0f, 0.0f, 0.0f), RGB_spectrum(1.0f, 1.0f, 0.0f),
+        RGB_spectrum(1.0f, 1.0f, 1.0f)
+      };
+
+      const float kx = std::min(std::max(t, 0.0f), 1.0f) * 4.0f;
+      const unsigned ki = std::min(static_cast<unsigned>(kx), 3u);
+
+      return lerp(kx - ki, kstops[ki], kstops[ki + 1]);
+    }
+  }
+
+  bool parse_cost_metric(const std::string & name, Cost_metric * pmetric)
+  {
+    if (name == "time") *pmetric = Cost_metric::ktime;
+    else if (name == "steps") *pmetric = Cost_metric::ktraversal_steps;
+    else return false;
+
+    return true;
+  }
+
+  Cost_map::Cost_map(const unsigned width, const unsigned height, const Cost_metric metric)
+      : m_width(width),
+        m_height(height),
+        m_metric(metric),
+        m_costs(std::size_t(width) * height, 0.0f) {}
+
+  std::vector<double> Cost_map::tile_costs(const unsigned tile_size) const
+  {
+    const unsigned knum_tiles_x = (m_width + tile_size - 1) / tile_size;
+    const unsigned knum_tiles_y = (m_height + tile_size - 1) / tile_size;
+    std::vector<double> costs(std::size_t(knum_tiles_x) * knum_tiles_y, 0.0);
+    for (unsigned y = 0; y != m_height; ++y) {
+      for (unsigned x = 0; x != m_width; ++x) {
+        costs[(y / tile_size) * knum_tiles_x + x / tile_size] += cost(x, y);
+      }
+    }
+
+    return costs;
+  }
+
+  void Cost_map::to_film(const bool heat_map, Film * pfilm) const
+  {
+    ASSERT(pfilm->get_width() == m_width && pfilm->get_height() == m_height,
+           "The film must be the size of the cost map");
+
+    float scale = 1.0f;
+    if (heat_map && !m_costs.empty()) {
+      std::vector<float> sorted(m_costs);
+      std::vector<float>::iterator p99 = sorted.begin() + (sorted.size() - 1) * 99 / 100;
+      std::nth_element(sorted.begin(), p99, sorted.end());
+      scale = (*p99 > 0.0f) ? 1.0f / *p99 : 1.0f;
+    }
+
+    for (unsigned i = 0; i != pfilm->num_tiles(); ++i) {
+      Film_tile tile = pfilm->get_tile(i);
+      for (unsigned y = tile.get_y_min(); y != tile.get_y_max(); ++y) {
+        for (unsigned x = tile.get_x_min(); x != tile.get_x_max(); ++x) {
+          const RGB_spectrum kvalue = heat_map ? heat_color(cost(x, y) * scale)
+                                               : RGB_spectrum(cost(x, y));
+          tile.add_sample(x, y, kvalue, 1.0f);
+        }
+      }
+      pfilm->merge_tile(tile);
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef LUX_CORE_COST_MAP_H_
+#define LUX_CORE_COST_MAP_H_
+
+#include <cstddef>
+
+#include <string>
+#include <vector>
+
+namespace lux { class Film; }
+
+namespace lux {
+  enum Cost_metric {
+    ktime,             // Nanoseconds spent on the pixel
+    ktraversal_steps   // BVH node and primitive tests, which don't depend on the machine
+  };
+
+  // Parses time or steps
+  bool parse_cost_metric(const std::string & name, Cost_metric * pmetric);
+
+  // Render cost of each pixel, an extra image that shows which parts of the scene, like
+  // a mirror, a light or dense geometry, take the render time. Render threads only add to
+  // the pixels of their own regions, so it isn't locked.
+  class Cost_map final {
+    public:
+      Cost_map(const unsigned width, const unsigned height, const Cost_metric metric);
+
+      unsigned get_width() const { return m_width; }
+      unsigned get_height() const { return m_height; }
+      Cost_metric get_metric() const { return m_metric; }
+
+      void add(const unsigned x, const unsigned y, const float cost)
+      {
+        m_costs[std::size_t(y) * m_width + x] += cost;
+      }
+
+      float cost(const unsigned x, const unsigned y) const
+      {
+        return m_costs[std::size_t(y) * m_width + x];
+      }
+
+      // Total cost of each tile_size x tile_size tile, in scanline order like Film's tiles
+      std::vector<double> tile_costs(const unsigned tile_size) const;
+
+      // Fills pfilm, of the same size, with the costs. The heat map is scaled so the 99th
+      // percentile is white, for 8 bit outputs, otherwise every channel holds the raw cost.
+      void to_film(const bool heat_map, Film * pfilm) const;
+
+    private:
+      unsigned m_width;
+      unsigned m_height;
+      Cost_metric m_metric;
+      std::vector<float> m_costs;
+  };
+}
+
+#endif
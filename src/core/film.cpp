@@ -0,0 +1,87 @@
+#include "core/film.h"
+
+#include <cstddef>
+
+#include <vector>
+#include <algorithm>
+
+#include "core/rgb_spectrum.h"
+#include "core/error.h"
+
+namespace lux {
+  Film_tile::Film_tile(const unsigned x_min, const unsigned y_min, const unsigned x_max,
+                       const unsigned y_max)
+      : m_x_min(x_min),
+        m_y_min(y_min),
+        m_x_max(x_max),
+        m_y_max(y_max),
+        m_pixels(static_cast<std::size_t>(x_max - x_min) * (y_max - y_min)) {}
+
+  void Film_tile::reset(const unsigned x_min, const unsigned y_min, const unsigned x_max,
+                        const unsigned y_max)
+  {
+    m_x_min = x_min;
+    m_y_min = y_min;
+    m_x_max = x_max;
+    m_y_max = y_max;
+    m_pixels.assign(static_cast<std::size_t>(x_max - x_min) * (y_max - y_min),
+                    RGB_spectrum(0.0f));
+  }
+
+  Film::Film(const unsigned width, const unsigned height, const unsigned tile_size,
+             const bool allocate_bands)
+      : m_width(width),
+        m_height(height),
+        m_tile_size(tile_size),
+        m_num_tiles_x((width + tile_size - 1) / tile_size),
+        m_num_tiles_y((height + tile_size - 1) / tile_size),
+        m_bands(m_num_tiles_y)
+  {
+    if (allocate_bands) {
+      for (unsigned i = 0; i != num_bands(); ++i) allocate_band(i);
+    }
+  }
+
+  std::size_t Film::band_bytes() const
+  {
+    return static_cast<std::size_t>(m_num_tiles_x) * m_tile_size * m_tile_size *
+           sizeof(RGB_spectrum);
+  }
+
+  void Film::allocate_band(const unsigned band)
+  {
+    ASSERT(band < num_bands(), "Trying to allocate a non existent film band");
+
+    m_bands[band].reset(new RGB_spectrum[static_cast<std::size_t>(m_num_tiles_x) *
+                                         m_tile_size * m_tile_size]);
+  }
+
+  void Film::release_band(const unsigned band)
+  {
+    ASSERT(band < num_bands(), "Trying to release a non existent film band");
+
+    m_bands[band].reset();
+  }
+
+  Film_tile Film::get_tile(const unsigned index) const
+  {
+    ASSERT(index < num_tiles(), "Trying to access a non existent film tile");
+
+    const unsigned kx_min = (index % m_num_tiles_x) * m_tile_size;
+    const unsigned ky_min = (index / m_num_tiles_x) * m_tile_size;
+
+    return Film_tile(kx_min, ky_min, std::min(kx_min + m_tile_size, m_width),
+                     std::min(ky_min + m_tile_size, m_height));
+  }
+
+  void Film::merge_tile(const Film_tile & tile)
+  {
+    ASSERT(m_bands[tile.get_y_min() / m_tile_size],
+           "Trying to merge a tile into a released film band");
+
+    for (unsigned y = tile.get_y_min(); y != tile.get_y_max(); ++y) {
+      RGB_spectrum * prow = &m_bands[y / m_tile_size][pixel_offset(tile.get_x_min(), y)];
+      for (unsigned x = tile.get_x_min(); x != tile.get_x_max(); ++x) *prow++ += tile.pixel(x, y);
+    }
+  }
+}
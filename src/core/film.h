@@ -0,0 +1,129 @@
+#ifndef LUX_CORE_FILM_H_
+#define LUX_CORE_FILM_H_
+
+#include <cstddef>
+
+#include <vector>
+#include <memory>
+
+#include "core/rgb_spectrum.h"
+#include "core/error.h"
+
+namespace lux {
+  // Pixels of one tile of a Film, in [x_min, x_max) x [y_min, y_max). A render thread
+  // accumulates samples in its own tile, then merges it into the film.
+  class Film_tile final {
+    public:
+      Film_tile(const unsigned x_min, const unsigned y_min, const unsigned x_max,
+                const unsigned y_max);
+
+      void add_sample(const unsigned x, const unsigned y, const RGB_spectrum & L,
+                      const float weight);
+
+      // Moves the tile to another region and zeroes it. The pixels are only reallocated if
+      // the region has more of them than the tile ever had.
+      void reset(const unsigned x_min, const unsigned y_min, const unsigned x_max,
+                 const unsigned y_max);
+
+      unsigned get_x_min() const { return m_x_min; }
+      unsigned get_y_min() const { return m_y_min; }
+      unsigned get_x_max() const { return m_x_max; }
+      unsigned get_y_max() const { return m_y_max; }
+
+      const RGB_spectrum & pixel(const unsigned x, const unsigned y) const;
+
+    private:
+      unsigned m_x_min, m_y_min;
+      unsigned m_x_max, m_y_max;
+      std::vector<RGB_spectrum> m_pixels;
+  };
+
+  // Image being rendered. It's stored tile by tile on the heap, so the pixels of a tile
+  // are contiguous and threads merging different tiles never write the same cache lines.
+  // Each row of tiles, a band, is a separate allocation, so a film streamed to its output
+  // files only needs to hold the bands being rendered.
+  class Film final {
+    public:
+      static const unsigned kdefault_tile_size = 64;
+
+      // Bands are left unallocated unless allocate_bands is true
+      Film(const unsigned width, const unsigned height,
+           const unsigned tile_size = kdefault_tile_size, const bool allocate_bands = true);
+
+      Film(const Film &) = delete;
+      Film & operator=(const Film &) = delete;
+
+      unsigned get_width() const { return m_width; }
+      unsigned get_height() const { return m_height; }
+      unsigned get_tile_size() const { return m_tile_size; }
+
+      // Tiles are numbered in scanline order
+      unsigned num_tiles() const { return m_num_tiles_x * m_num_tiles_y; }
+      Film_tile get_tile(const unsigned index) const;
+
+      // Band i holds the tiles [i * tiles_per_band(), (i + 1) * tiles_per_band()), which
+      // are the rows [i * tile size, (i + 1) * tile size) clipped to the film
+      unsigned num_bands() const { return m_num_tiles_y; }
+      unsigned tiles_per_band() const { return m_num_tiles_x; }
+      std::size_t band_bytes() const;
+
+      // Allocating a band zeroes it. Neither is thread safe with respect to each other or
+      // to accesses to the same band.
+      bool is_band_allocated(const unsigned band) const { return m_bands[band] != nullptr; }
+      void allocate_band(const unsigned band);
+      void release_band(const unsigned band);
+
+      // Adds the pixels of tile to the film, its band must be allocated. Tiles from get_tile
+      // may be merged concurrently as long as no two of them are the same.
+      void merge_tile(const Film_tile & tile);
+
+      // The pixels of a row of a tile are contiguous, the address of pixel (x, y) may be
+      // incremented until the end of its tile
+      const RGB_spectrum & pixel(const unsigned x, const unsigned y) const;
+
+    private:
+      std::size_t pixel_offset(const unsigned x, const unsigned y) const;
+
+      unsigned m_width;
+      unsigned m_height;
+      unsigned m_tile_size;
+      unsigned m_num_tiles_x;
+      unsigned m_num_tiles_y;
+      // Edge tiles are padded to the full size
+      std::vector<std::unique_ptr<RGB_spectrum[]>> m_bands;
+  };
+
+  inline void Film_tile::add_sample(const unsigned x, const unsigned y, const RGB_spectrum & L,
+                                    const float weight)
+  {
+    ASSERT(x >= m_x_min && x < m_x_max && y >= m_y_min && y < m_y_max,
+           "Trying to add a sample outside of the film tile");
+
+    m_pixels[(y - m_y_min) * (m_x_max - m_x_min) + (x - m_x_min)] += L * weight;
+  }
+
+  inline const RGB_spectrum & Film_tile::pixel(const unsigned x, const unsigned y) const
+  {
+    ASSERT(x >= m_x_min && x < m_x_max && y >= m_y_min && y < m_y_max,
+           "Trying to access a pixel outside of the film tile");
+
+    return m_pixels[(y - m_y_min) * (m_x_max - m_x_min) + (x - m_x_min)];
+  }
+
+  // Offset of pixel (x, y) inside its band
+  inline std::size_t Film::pixel_offset(const unsigned x, const unsigned y) const
+  {
+    const std::size_t ktile = x / m_tile_size;
+    return (ktile * m_tile_size + y % m_tile_size) * m_tile_size + x % m_tile_size;
+  }
+
+  inline const RGB_spectrum & Film::pixel(const unsigned x, const unsigned y) const
+  {
+    ASSERT(x < m_width && y < m_height, "Trying to access a pixel outside of the film");
+    ASSERT(m_bands[y / m_tile_size], "Trying to access a pixel of a released film band");
+
+    return m_bands[y / m_tile_size][pixel_offset(x, y)];
+  }
+}
+
+#endif
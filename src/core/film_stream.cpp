@@ -0,0 +1,179 @@
+#include "core/film_stream.h"
+
+#include <cstddef>
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+#include <algorithm>
+
+#include "core/film.h"
+#include "core/image_writer.h"
+#include "core/error.h"
+#include "core/trace.h"
+
+namespace lux {
+  namespace {
+    // Regions smaller than this cost more to schedule than they balance
+    const unsigned kmin_region_size = 8;
+
+    // Regions each thread should get if the costs were even
+    const double kregions_per_thread = 8.0;
+  }
+
+  Film_stream::Film_stream(Film * pfilm, std::vector<std::unique_ptr<Image_stream>> outputs,
+                           const std::vector<unsigned> & tile_splits,
+                           const unsigned num_threads)
+      : m_pfilm(pfilm),
+        m_outputs(std::move(outputs)),
+        m_regions(),
+        m_band_regions(pfilm->num_bands(), 0),
+        m_max_allocated_bands(num_threads ? num_threads + 1 : 0),
+        m_mutex(),
+        m_band_written(),
+        m_next_region(0),
+        m_regions_done(0),
+        m_band_regions_done(pfilm->num_bands(), 0),
+        m_next_band_to_write(0),
+        m_num_allocated_bands(0),
+        m_peak_allocated_bands(0),
+        m_write_mutex()
+  {
+    ASSERT(tile_splits.empty() || tile_splits.size() == pfilm->num_tiles(),
+           "There must be splits for every tile of the film");
+
+    for (unsigned i = 0; i != pfilm->num_tiles(); ++i) {
+      const Film_tile ktile = pfilm->get_tile(i);
+      const unsigned ksplits = tile_splits.empty() ? 1 : tile_splits[i];
+      const unsigned kregion_size = (pfilm->get_tile_size() + ksplits - 1) / ksplits;
+      for (unsigned split = 0; split != ksplits * ksplits; ++split) {
+        Film_region region;
+        region.tile_index = i;
+        region.split = split;
+        region.x_min = ktile.get_x_min() + (split % ksplits) * kregion_size;
+        region.y_min = ktile.get_y_min() + (split / ksplits) * kregion_size;
+        if (region.x_min >= ktile.get_x_max() || region.y_min >= ktile.get_y_max()) continue;
+        region.x_max = std::min(region.x_min + kregion_size, ktile.get_x_max());
+        region.y_max = std::min(region.y_min + kregion_size, ktile.get_y_max());
+        m_regions.push_back(region);
+        ++m_band_regions[i / pfilm->tiles_per_band()];
+      }
+    }
+  }
+
+  bool Film_stream::next_region(Film_region * pregion)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+      if (m_next_region == m_regions.size()) return false;
+
+      const unsigned kband = m_regions[m_next_region].tile_index / m_pfilm->tiles_per_band();
+      if (m_outputs.empty() || m_pfilm->is_band_allocated(kband)) break;
+      if (m_max_allocated_bands == 0 || m_num_allocated_bands < m_max_allocated_bands) {
+        m_pfilm->allocate_band(kband);
+        ++m_num_allocated_bands;
+        m_peak_allocated_bands = std::max(m_peak_allocated_bands, m_num_allocated_bands);
+        break;
+      }
+
+      // The regions of the allocated bands were all handed out, to threads that aren't
+      // waiting here, so the next band to write completes and wakes them up
+      TRACE_SCOPE("band wait");
+      m_band_written.wait(lock);
+    }
+    *pregion = m_regions[m_next_region++];
+
+    return true;
+  }
+
+  void Film_stream::merge_region(const Film_tile & tile)
+  {
+    m_pfilm->merge_tile(tile);
+
+    const unsigned kband = tile.get_y_min() / m_pfilm->get_tile_size();
+    bool can_write;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ++m_regions_done;
+      can_write = ++m_band_regions_done[kband] == m_band_regions[kband] && !m_outputs.empty();
+    }
+    if (!can_write) return;
+
+    // Whoever holds the write lock has either written this band or will see it complete
+    TRACE_SCOPE_ARG("band writes", "band", kband);
+    std::lock_guard<std::mutex> write_lock(m_write_mutex);
+    for (;;) {
+      unsigned band;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_next_band_to_write == m_pfilm->num_bands() ||
+            m_band_regions_done[m_next_band_to_write] != m_band_regions[m_next_band_to_write]) {
+          return;
+        }
+        band = m_next_band_to_write;
+      }
+
+      const unsigned ky_begin = band * m_pfilm->get_tile_size();
+      const unsigned ky_end = std::min(ky_begin + m_pfilm->get_tile_size(),
+                                       m_pfilm->get_height());
+      for (const std::unique_ptr<Image_stream> & poutput : m_outputs) {
+        poutput->write_rows(*m_pfilm, ky_begin, ky_end);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pfilm->release_band(band);
+        --m_num_allocated_bands;
+        ++m_next_band_to_write;
+      }
+      m_band_written.notify_all();
+    }
+  }
+
+  unsigned Film_stream::regions_done() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_regions_done;
+  }
+
+  std::size_t Film_stream::peak_band_bytes() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_peak_allocated_bands * m_pfilm->band_bytes();
+  }
+
+  bool Film_stream::close(std::vector<Image_write_stats> * pstats)
+  {
+    pstats->assign(m_outputs.size(), Image_write_stats());
+
+    bool closed = true;
+    for (std::size_t i = 0; i != m_outputs.size(); ++i) {
+      closed = m_outputs[i]->close(&(*pstats)[i]) && closed;
+    }
+
+    return closed;
+  }
+
+  std::vector<unsigned> adaptive_tile_splits(const std::vector<double> & tile_costs,
+                                             const unsigned tile_size,
+                                             const unsigned num_threads)
+  {
+    std::vector<unsigned> splits(tile_costs.size(), 1);
+    if (num_threads < 2) return splits;
+
+    double total_cost = 0.0;
+    for (const double kcost : tile_costs) total_cost += kcost;
+    const double kmax_region_cost = total_cost / (kregions_per_thread * num_threads);
+
+    for (std::size_t i = 0; i != tile_costs.size(); ++i) {
+      while (tile_costs[i] / (double(splits[i]) * splits[i]) > kmax_region_cost &&
+             tile_size / (2 * splits[i]) >= kmin_region_size) {
+        splits[i] *= 2;
+      }
+    }
+
+    return splits;
+  }
+}
@@ -0,0 +1,101 @@
+#ifndef LUX_CORE_FILM_STREAM_H_
+#define LUX_CORE_FILM_STREAM_H_
+
+#include <cstddef>
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "core/image_writer.h"
+
+namespace lux { class Film; class Film_tile; }
+
+namespace lux {
+  // Part of a film tile rendered by one thread. A tile split n times per side is rendered
+  // as n x n regions, numbered by split in scanline order, and a tile that isn't split is a
+  // single region with split 0.
+  struct Film_region {
+    unsigned tile_index;
+    unsigned split;
+    unsigned x_min, y_min;
+    unsigned x_max, y_max;
+  };
+
+  // Hands out the regions of a film to the render threads in scanline order of their
+  // tiles, so the bands of the film are started in order too. When there are outputs, a
+  // band is only allocated when its first region is handed out, and once all its regions
+  // are merged and the bands above it are written, it's written to every output and
+  // released. The film then only holds the bands being rendered, about one more than the
+  // threads span, instead of the whole image.
+  //
+  // A slow region holds back the writes of every band after its own, so given the number
+  // of render threads, threads that would allocate a band wait while num_threads + 1
+  // bands are allocated and unwritten, which bounds the film memory whatever the costs.
+  class Film_stream final {
+    public:
+      // With no outputs the film must have its bands allocated and it's left whole.
+      // tile_splits holds the splits per side of each tile, see adaptive_tile_splits, and
+      // if it's empty every tile is a single region. num_threads 0 doesn't bound the
+      // allocated bands.
+      Film_stream(Film * pfilm, std::vector<std::unique_ptr<Image_stream>> outputs,
+                  const std::vector<unsigned> & tile_splits = std::vector<unsigned>(),
+                  const unsigned num_threads = 0);
+
+      Film_stream(const Film_stream &) = delete;
+      Film_stream & operator=(const Film_stream &) = delete;
+
+      const Film & get_film() const { return *m_pfilm; }
+
+      unsigned num_regions() const { return m_regions.size(); }
+
+      // Returns false once every region was handed out. May wait for bands to be written,
+      // see above. Thread safe.
+      bool next_region(Film_region * pregion);
+
+      // Merges the pixels of a region from next_region into the film. The thread
+      // completing the next band to write writes it, and any completed bands after it,
+      // before returning. Thread safe.
+      void merge_region(const Film_tile & tile);
+
+      unsigned regions_done() const;
+
+      // Largest amount of film memory allocated at once while streaming
+      std::size_t peak_band_bytes() const;
+
+      // Closes the outputs, pstats gets the stats of each one. Returns false if any of
+      // them failed.
+      bool close(std::vector<Image_write_stats> * pstats);
+
+    private:
+      Film * m_pfilm;
+      std::vector<std::unique_ptr<Image_stream>> m_outputs;
+
+      std::vector<Film_region> m_regions;
+      std::vector<unsigned> m_band_regions;
+      unsigned m_max_allocated_bands;  // 0 for no bound
+
+      mutable std::mutex m_mutex;  // Guards the region and band counts below
+      std::condition_variable m_band_written;
+      unsigned m_next_region;
+      unsigned m_regions_done;
+      std::vector<unsigned> m_band_regions_done;
+      unsigned m_next_band_to_write;
+      unsigned m_num_allocated_bands;
+      unsigned m_peak_allocated_bands;
+
+      std::mutex m_write_mutex;  // Held while writing, so bands are written in order
+  };
+
+  // Splits per side, a power of 2, of each tile so that every region costs at most about
+  // 1 / 8 of a thread's share of the total cost and threads don't sit idle at the end of
+  // a render waiting for a few costly tiles. Regions are at least 8 pixels wide, and with
+  // one thread nothing is split. tile_costs holds the cost of each tile in scanline order,
+  // e.g. from Cost_map::tile_costs.
+  std::vector<unsigned> adaptive_tile_splits(const std::vector<double> & tile_costs,
+                                             const unsigned tile_size,
+                                             const unsigned num_threads);
+}
+
+#endif
@@ -0,0 +1,350 @@
+#include "core/image_writer.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <future>
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+
+#include "core/film.h"
+#include "core/rgb_spectrum.h"
+#include "core/post_process.h"
+#include "core/error.h"
+#include "core/trace.h"
+
+namespace lux {
+  namespace {
+    // Rows are converted into the buffer until it holds about this many bytes
+    const std::size_t kband_bytes = std::size_t(1) << 20;
+
+    bool has_suffix(const std::string & path, const std::string & suffix)
+    {
+      return path.size() >= suffix.size() &&
+             path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // All multi byte values of PFM and EXR files are little endian
+    void put_u16(std::vector<unsigned char> * pbuffer, const std::uint16_t value)
+    {
+      pbuffer->push_back(value & 0xff);
+      pbuffer->push_back(value >> 8);
+    }
+
+    void put_u32(std::vector<unsigned char> * pbuffer, const std::uint32_t value)
+    {
+      for (unsigned i = 0; i != 4; ++i) pbuffer->push_back((value >> (8 * i)) & 0xff);
+    }
+
+    void put_u64(std::vector<unsigned char> * pbuffer, const std::uint64_t value)
+    {
+      for (unsigned i = 0; i != 8; ++i) pbuffer->push_back((value >> (8 * i)) & 0xff);
+    }
+
+    void put_float(std::vector<unsigned char> * pbuffer, const float value)
+    {
+      std::uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      put_u32(pbuffer, bits);
+    }
+
+    void put_string(std::vector<unsigned char> * pbuffer, const std::string & s)
+    {
+      pbuffer->insert(pbuffer->end(), s.begin(), s.end());
+    }
+
+    // Rounds to the nearest half, ties to even. Values too large for a half become
+    // infinity, too small ones become denormals or zero.
+    std::uint16_t float_to_half(const float value)
+    {
+      std::uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+
+      const std::uint16_t ksign = (bits >> 16) & 0x8000;
+      const std::uint32_t kexponent = (bits >> 23) & 0xff;
+      std::uint32_t mantissa = bits & 0x7fffff;
+
+      if (kexponent == 0xff) return ksign | 0x7c00 | (mantissa ? 0x200 : 0);  // Inf or NaN
+
+      const int khalf_exponent = static_cast<int>(kexponent) - 127 + 15;
+      if (khalf_exponent >= 0x1f) return ksign | 0x7c00;
+      if (khalf_exponent <= 0) {
+        if (khalf_exponent < -10) return ksign;
+
+        // Denormal, the implicit one becomes explicit before shifting
+        mantissa |= 0x800000;
+        const unsigned kshift = 14 - khalf_exponent;
+        std::uint32_t half_mantissa = mantissa >> kshift;
+        const std::uint32_t kremainder = mantissa & ((1u << kshift) - 1);
+        const std::uint32_t khalfway = 1u << (kshift - 1);
+        if (kremainder > khalfway || (kremainder == khalfway && (half_mantissa & 1))) {
+          ++half_mantissa;
+        }
+        return ksign | half_mantissa;
+      }
+
+      std::uint32_t half = (khalf_exponent << 10) | (mantissa >> 13);
+      const std::uint32_t kremainder = mantissa & 0x1fff;
+      // May carry into inf
+      if (kremainder > 0x1000 || (kremainder == 0x1000 && (half & 1))) ++half;
+
+      return ksign | half;
+    }
+
+    double seconds_since(const std::chrono::steady_clock::time_point start)
+    {
+      const std::chrono::duration<double> kelapsed = std::chrono::steady_clock::now() - start;
+      return kelapsed.count();
+    }
+
+    void put_attribute(std::vector<unsigned char> * pbuffer, const std::string & name,
+                       const std::string & type, const std::uint32_t size)
+    {
+      put_string(pbuffer, name);
+      pbuffer->push_back(0);
+      put_string(pbuffer, type);
+      pbuffer->push_back(0);
+      put_u32(pbuffer, size);
+    }
+
+    // Single part scanline file without compression, so every chunk is one row and the
+    // offset of every row is known before any is written
+    std::size_t exr_row_bytes(const unsigned width, const bool use_floats)
+    {
+      return 8 + std::size_t(3) * width * (use_floats ? 4 : 2);
+    }
+
+    void put_exr_header(std::vector<unsigned char> * pbuffer, const std::uint32_t width,
+                        const std::uint32_t height, const bool use_floats)
+    {
+      std::vector<unsigned char> & buffer = *pbuffer;
+      put_u32(&buffer, 20000630);  // Magic number
+      put_u32(&buffer, 2);         // Version 2, single part scanline
+
+      // Channels are listed in alphabetical order, which is also their order in a row
+      const char * kchannels[3] = { "B", "G", "R" };
+      put_attribute(&buffer, "channels", "chlist", 3 * (2 + 16) + 1);
+      for (unsigned c = 0; c != 3; ++c) {
+        put_string(&buffer, kchannels[c]);
+        buffer.push_back(0);
+        put_u32(&buffer, use_floats ? 2 : 1);  // Pixel type
+        put_u32(&buffer, 0);  // pLinear and reserved
+        put_u32(&buffer, 1);  // x and y sampling
+        put_u32(&buffer, 1);
+      }
+      buffer.push_back(0);
+
+      put_attribute(&buffer, "compression", "compression", 1);
+      buffer.push_back(0);
+      for (const char * kwindow : { "dataWindow", "displayWindow" }) {
+        put_attribute(&buffer, kwindow, "box2i", 16);
+        put_u32(&buffer, 0);
+        put_u32(&buffer, 0);
+        put_u32(&buffer, width - 1);
+        put_u32(&buffer, height - 1);
+      }
+      put_attribute(&buffer, "lineOrder", "lineOrder", 1);
+      buffer.push_back(0);  // Increasing y
+      put_attribute(&buffer, "pixelAspectRatio", "float", 4);
+      put_float(&buffer, 1.0f);
+      put_attribute(&buffer, "screenWindowCenter", "v2f", 8);
+      put_float(&buffer, 0.0f);
+      put_float(&buffer, 0.0f);
+      put_attribute(&buffer, "screenWindowWidth", "float", 4);
+      put_float(&buffer, 1.0f);
+      buffer.push_back(0);  // End of the header
+
+      const std::uint64_t krow_bytes = exr_row_bytes(width, use_floats);
+      const std::uint64_t kfirst_row = buffer.size() + 8 * std::uint64_t(height);
+      for (std::uint32_t y = 0; y != height; ++y) put_u64(&buffer, kfirst_row + y * krow_bytes);
+    }
+
+    void put_exr_row(std::vector<unsigned char> * pbuffer, const Film & film,
+                     const std::uint32_t y, const bool use_floats)
+    {
+      put_u32(pbuffer, y);
+      put_u32(pbuffer, exr_row_bytes(film.get_width(), use_floats) - 8);
+      for (unsigned c = 3; c-- != 0;) {
+        for (std::uint32_t x = 0; x != film.get_width(); ++x) {
+          const float kvalue = film.pixel(x, y)[c];
+          if (use_floats) put_float(pbuffer, kvalue);
+          else put_u16(pbuffer, float_to_half(kvalue));
+        }
+      }
+    }
+  }
+
+  bool image_format_from_path(const std::string & path, Image_format * pformat)
+  {
+    if (has_suffix(path, ".ppm")) *pformat = Image_format::kppm;
+    else if (has_suffix(path, ".pfm")) *pformat = Image_format::kpfm;
+    else if (has_suffix(path, ".float.exr")) *pformat = Image_format::kexr_float;
+    else if (has_suffix(path, ".exr")) *pformat = Image_format::kexr;
+    else return false;
+
+    return true;
+  }
+
+  std::ostream & operator<<(std::ostream & os, const Image_write_stats & stats)
+  {
+    os << stats.file_bytes / (1024.0 * 1024.0) << " MiB in " << stats.write_seconds * 1000.0
+       << " ms";
+    if (stats.post_process_seconds > 0.0) {
+      os << ", post processed at " << stats.num_pixels / (stats.post_process_seconds * 1e6)
+         << " Mpixels/s";
+    }
+
+    return os;
+  }
+
+  Image_stream::Image_stream(const std::string & path, const Image_format format,
+                             const unsigned width, const unsigned height,
+                             const Post_process_options & display)
+      : m_path(path),
+        m_format(format),
+        m_width(width),
+        m_height(height),
+        m_display(display),
+        m_file(path, std::ios::binary | std::ios::trunc),
+        m_buffer(),
+        m_header_bytes(0),
+        m_row_bytes(0),
+        m_next_row(0),
+        m_stats()
+  {
+    const std::chrono::steady_clock::time_point kstart = std::chrono::steady_clock::now();
+    m_buffer.reserve(kband_bytes + kband_bytes / 4);
+
+    const std::string ksize = std::to_string(width) + " " + std::to_string(height) + "\n";
+    switch (format) {
+      case Image_format::kpfm:
+        // A negative scale means little endian
+        put_string(&m_buffer, "PF\n" + ksize + "-1.0\n");
+        m_row_bytes = std::size_t(3) * width * sizeof(float);
+        break;
+
+      case Image_format::kexr:
+      case Image_format::kexr_float:
+        put_exr_header(&m_buffer, width, height, format == Image_format::kexr_float);
+        m_row_bytes = exr_row_bytes(width, format == Image_format::kexr_float);
+        break;
+
+      default:
+        put_string(&m_buffer, "P6\n" + ksize +
+                              ((display.bits_per_channel > 8) ? "65535\n" : "255\n"));
+        m_row_bytes = display_row_bytes(width, display);
+        break;
+    }
+    m_header_bytes = m_buffer.size();
+    flush();
+
+    m_stats.num_pixels = std::size_t(width) * height;
+    m_stats.write_seconds = seconds_since(kstart);
+  }
+
+  void Image_stream::write_rows(const Film & film, const unsigned y_begin, const unsigned y_end)
+  {
+    ASSERT(y_begin == m_next_row && y_begin <= y_end && y_end <= m_height,
+           "Image rows must be written in order");
+    ASSERT(film.get_width() == m_width && film.get_height() == m_height,
+           "Trying to write a film of a different size than the image");
+    TRACE_SCOPE_ARG("image write rows", "y_begin", y_begin);
+
+    const std::chrono::steady_clock::time_point kstart = std::chrono::steady_clock::now();
+    switch (m_format) {
+      case Image_format::kpfm:
+        // Rows go from the bottom of the image to the top, so these rows end where the
+        // ones already written start
+        m_file.seekp(m_header_bytes + std::size_t(m_height - y_end) * m_row_bytes);
+        for (unsigned y = y_end; y-- != y_begin;) {
+          for (unsigned x = 0; x != m_width; ++x) {
+            const RGB_spectrum & kpixel = film.pixel(x, y);
+            for (unsigned c = 0; c != 3; ++c) put_float(&m_buffer, kpixel[c]);
+          }
+          flush_if_full();
+        }
+        break;
+
+      case Image_format::kexr:
+      case Image_format::kexr_float:
+        for (unsigned y = y_begin; y != y_end; ++y) {
+          put_exr_row(&m_buffer, film, y, m_format == Image_format::kexr_float);
+          flush_if_full();
+        }
+        break;
+
+      default: {
+        const unsigned kband_rows = std::max<std::size_t>(1, kband_bytes / m_row_bytes);
+        for (unsigned y = y_begin; y < y_end; y += kband_rows) {
+          const unsigned kband_end = std::min(y + kband_rows, y_end);
+          const std::size_t kband_start = m_buffer.size();
+          m_buffer.resize(kband_start + (kband_end - y) * m_row_bytes);
+
+          const std::chrono::steady_clock::time_point kpost_process_start =
+              std::chrono::steady_clock::now();
+          post_process(film, y, kband_end, m_display, m_buffer.data() + kband_start);
+          m_stats.post_process_seconds += seconds_since(kpost_process_start);
+
+          flush_if_full();
+        }
+        break;
+      }
+    }
+
+    // Nothing is kept that refers to the rows, the film may release them
+    flush();
+    m_next_row = y_end;
+    m_stats.write_seconds += seconds_since(kstart);
+  }
+
+  bool Image_stream::close(Image_write_stats * pstats)
+  {
+    TRACE_SCOPE("image close");
+    const std::chrono::steady_clock::time_point kstart = std::chrono::steady_clock::now();
+    flush();
+    m_file.close();
+
+    const bool kwritten = static_cast<bool>(m_file) && m_next_row == m_height;
+    m_stats.file_bytes = kwritten ? m_header_bytes + std::size_t(m_height) * m_row_bytes : 0;
+    m_stats.write_seconds += seconds_since(kstart);
+    if (pstats) *pstats = m_stats;
+
+    return kwritten;
+  }
+
+  void Image_stream::flush()
+  {
+    m_file.write(reinterpret_cast<const char *>(m_buffer.data()), m_buffer.size());
+    m_buffer.clear();
+  }
+
+  void Image_stream::flush_if_full()
+  {
+    if (m_buffer.size() >= kband_bytes) flush();
+  }
+
+  bool write_image(const std::string & path, const Film & film, const Image_format format,
+                   const Post_process_options & display, Image_write_stats * pstats)
+  {
+    Image_stream stream(path, format, film.get_width(), film.get_height(), display);
+    stream.write_rows(film, 0, film.get_height());
+
+    return stream.close(pstats);
+  }
+
+  std::future<bool> write_image_async(const std::string & path, const Film & film,
+                                      const Image_format format,
+                                      const Post_process_options & display,
+                                      Image_write_stats * pstats)
+  {
+    return std::async(std::launch::async, [path, &film, format, display, pstats]()
+        {
+          return write_image(path, film, format, display, pstats);
+        });
+  }
+}
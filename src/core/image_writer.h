@@ -0,0 +1,91 @@
+#ifndef LUX_CORE_IMAGE_WRITER_H_
+#define LUX_CORE_IMAGE_WRITER_H_
+
+#include <cstddef>
+
+#include <string>
+#include <vector>
+#include <future>
+#include <fstream>
+#include <ostream>
+
+#include "core/post_process.h"
+
+namespace lux { class Film; }
+
+namespace lux {
+  enum Image_format {
+    kppm,       // Binary PPM (P6), post processed to 8 or 16 bits per channel
+    kpfm,       // Portable float map, linear 32 bit floats
+    kexr,       // Uncompressed scanline OpenEXR, linear 16 bit halfs
+    kexr_float  // Same, with 32 bit floats
+  };
+
+  // Picks the format from the extension of path: ".ppm", ".pfm" or ".exr", writing
+  // "name.float.exr" uses 32 bit floats. Returns false for any other extension.
+  bool image_format_from_path(const std::string & path, Image_format * pformat);
+
+  struct Image_write_stats {
+    std::size_t file_bytes = 0;
+    std::size_t num_pixels = 0;
+    double write_seconds = 0.0;
+    double post_process_seconds = 0.0;  // Part of write_seconds, 0 for the HDR formats
+  };
+
+  std::ostream & operator<<(std::ostream & os, const Image_write_stats & stats);
+
+  // Image file written a range of rows at a time, so a film can be written as its bands
+  // are rendered and released. The pixels are converted a band of rows at a time into a
+  // buffer that is written in one call, so no per pixel stream operations are made.
+  // display is only used by formats that aren't HDR, the others store the film's linear
+  // values.
+  class Image_stream final {
+    public:
+      // Creates the file and writes the header
+      Image_stream(const std::string & path, const Image_format format, const unsigned width,
+                   const unsigned height, const Post_process_options & display);
+
+      Image_stream(const Image_stream &) = delete;
+      Image_stream & operator=(const Image_stream &) = delete;
+
+      const std::string & get_path() const { return m_path; }
+
+      // Writes the rows [y_begin, y_end) of film, which only needs to hold those rows.
+      // Every call must start at the row the previous one ended at.
+      void write_rows(const Film & film, const unsigned y_begin, const unsigned y_end);
+
+      // Returns false if the file couldn't be created, any write failed or rows are
+      // missing. The times in pstats are summed over the calls of this stream.
+      bool close(Image_write_stats * pstats = nullptr);
+
+    private:
+      void flush();
+      void flush_if_full();
+
+      std::string m_path;
+      Image_format m_format;
+      unsigned m_width;
+      unsigned m_height;
+      Post_process_options m_display;
+
+      std::ofstream m_file;
+      std::vector<unsigned char> m_buffer;
+      std::size_t m_header_bytes;
+      std::size_t m_row_bytes;
+      unsigned m_next_row;
+      Image_write_stats m_stats;
+  };
+
+  // Writes the whole film through an Image_stream. Returns false on I/O errors.
+  bool write_image(const std::string & path, const Film & film, const Image_format format,
+                   const Post_process_options & display, Image_write_stats * pstats = nullptr);
+
+  // Runs write_image on a background thread. film and pstats must not be destroyed, and
+  // film not changed, until the returned future is ready.
+  std::future<bool> write_image_async(const std::string & path, const Film & film,
+                                      const Image_format format,
+                                      const Post_process_options & display,
+                                      Image_write_stats * pstats = nullptr);
+}
+
+#endif
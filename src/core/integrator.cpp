@@ -1,11 +1,14 @@
 #include "core/integrator.h"
 
+#include <limits>
+
 #include "core/util.h"
 #include "core/vec2.h"
 #include "core/sampler.h"
 #include "core/material.h"
 #include "core/shape.h"
 #include "core/scene.h"
+#include "core/render_stats.h"
 
 namespace lux {
 
@@ -45,18 +48,20 @@ namespace lux {
     if (light_pdf > 0.0f && !Li.is_black() && reflect) {
       // Evaluate BRDF for the light sampling strategy
       RGB_spectrum f(0.0f);
-      f = interaction.pmaterial->f(interaction.wo_world, wi_world) *
+      f = interaction.pmaterial->f(interaction, interaction.wo_world, wi_world) *
                                  abs_dot(wi_world, interaction.n);
 
-      scattering_pdf = interaction.pmaterial->PDF(interaction.wo_world, wi_world);
+      scattering_pdf = interaction.pmaterial->PDF(interaction, interaction.wo_world, wi_world);
 
       // Only if some of the incident light Li reflects back in the direction wo,
       // should we follow through
       if (!f.is_black()) {
         //TODO remove point_on_light
         const Vec3 d = point_on_light - interaction.hit_point;
-        Ray shadow_ray(interaction.hit_point, normalize(d), magnitude(d) - kshadow_epsilon);
+        Ray shadow_ray(interaction.hit_point, normalize(d), magnitude(d) - kshadow_epsilon,
+                       interaction.time);
 
+        add_render_count(kshadow_rays);
         const bool is_occluded = scene.intersect_p(shadow_ray);
         if (!is_occluded) {
           const float kweight = power_heuristic(1, light_pdf, 1, scattering_pdf);
@@ -67,8 +72,8 @@ namespace lux {
 
     // Sample the BRDF
     RGB_spectrum f(0.0f);
-    f = interaction.pmaterial->sample_f(interaction.wo_world, &wi_world, scattering_sample,
-                                        &scattering_pdf);
+    f = interaction.pmaterial->sample_f(interaction, interaction.wo_world, &wi_world,
+                                        scattering_sample, &scattering_pdf);
 
     f *= abs_dot(wi_world, interaction.n);
 
@@ -85,7 +90,9 @@ namespace lux {
 
       // Check if the ray intersects the light source
       Surface_interaction light_interaction;
-      Ray r(interaction.hit_point, wi_world);
+      Ray r(interaction.hit_point, wi_world, std::numeric_limits<float>::infinity(),
+            interaction.time);
+      add_render_count(kshadow_rays);
       bool found_intersection = scene.intersect(r, &light_interaction);
       if (!found_intersection) return Ld;
       if (&light != light_interaction.pshape) return Ld;
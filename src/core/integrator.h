@@ -10,6 +10,7 @@ namespace lux {
   class Shape;
   class Sampler;
   class Scene;
+  class Memory_arena;
 }
 
 namespace lux {
@@ -18,7 +19,9 @@ namespace lux {
       Integrator() = default;
       virtual ~Integrator() {}
 
-      virtual RGB_spectrum li(const Scene & scene, const Ray & r) = 0;
+      // parena holds the integrator's scratch data for the sample, e.g. BSDFs or light
+      // samples. It's reset after each sample, so the render loop never calls malloc.
+      virtual RGB_spectrum li(const Scene & scene, const Ray & r, Memory_arena * parena) = 0;
   };
 
   RGB_spectrum uniform_sample_one_light(const Scene & scene,
@@ -0,0 +1,35 @@
+#include "core/mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+
+#include <string>
+
+namespace lux {
+  Mapped_file::Mapped_file(const std::string & path) : m_pdata(nullptr), m_size(0)
+  {
+    const int kfd = ::open(path.c_str(), O_RDONLY);
+    if (kfd < 0) return;
+
+    struct stat file_stat;
+    if (::fstat(kfd, &file_stat) == 0 && file_stat.st_size > 0) {
+      void * paddress = ::mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, kfd, 0);
+      if (paddress != MAP_FAILED) {
+        m_pdata = static_cast<const unsigned char *>(paddress);
+        m_size = file_stat.st_size;
+      }
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    ::close(kfd);
+  }
+
+  Mapped_file::~Mapped_file()
+  {
+    if (m_pdata) ::munmap(const_cast<unsigned char *>(m_pdata), m_size);
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef LUX_CORE_MAPPED_FILE_H_
+#define LUX_CORE_MAPPED_FILE_H_
+
+#include <cstddef>
+
+#include <string>
+
+namespace lux {
+  // Read only memory mapping of a whole file. Pages are loaded by the OS on first
+  // access, so opening a file costs the same whatever its size.
+  class Mapped_file final {
+    public:
+      explicit Mapped_file(const std::string & path);
+      Mapped_file(const Mapped_file &) = delete;
+
+      ~Mapped_file();
+
+      Mapped_file & operator=(const Mapped_file &) = delete;
+
+      // False if the file couldn't be opened or mapped, or is empty
+      bool is_open() const { return m_pdata != nullptr; }
+
+      const unsigned char * data() const { return m_pdata; }
+      std::size_t size() const { return m_size; }
+
+    private:
+      const unsigned char * m_pdata;
+      std::size_t m_size;
+  };
+}
+
+#endif
@@ -14,6 +14,7 @@ namespace lux {
     friend std::ostream & operator<<(std::ostream & os, const Mat4 & m);
     friend Mat4 transpose(const Mat4 & m);
     friend Mat4 inverse(const Mat4 & m);
+    friend Mat4 lerp(const float t, const Mat4 & a, const Mat4 & b);
     public:
       Mat4() {
         m[0][0] = 1.0f; m[0][1] = 0.0f; m[0][2] = 0.0f; m[0][3] = 0.0f;
@@ -38,6 +39,8 @@ namespace lux {
 
       float determinant() const;
 
+      float operator()(const unsigned row, const unsigned column) const;
+
       Mat4 & operator=(const Mat4 & rhs) = default;
       Mat4 & operator*=(const Mat4 & rhs);
       Mat4 & operator*=(const float k);
@@ -45,6 +48,13 @@ namespace lux {
       float m[4][4];
   };
 
+  inline float Mat4::operator()(const unsigned row, const unsigned column) const
+  {
+    ASSERT(row < 4 && column < 4, "Trying to access a non existent matrix element");
+
+    return m[row][column];
+  }
+
   inline Mat4 & Mat4::operator*=(const Mat4 & rhs)
   {
     float row[4];
@@ -85,6 +95,18 @@ namespace lux {
     return r;
   }
 
+  inline Mat4 lerp(const float t, const Mat4 & a, const Mat4 & b)
+  {
+    Mat4 r;
+    for (unsigned i = 0; i != 4; ++i) {
+      for (unsigned j = 0; j != 4; ++j) {
+        r.m[i][j] = (1.0f - t) * a.m[i][j] + t * b.m[i][j];
+      }
+    }
+
+    return r;
+  }
+
   inline Mat4 transpose(const Mat4 & m) {
     return Mat4(m.m[0][0], m.m[1][0], m.m[2][0], m.m[3][0],
                 m.m[0][1], m.m[1][1], m.m[2][1], m.m[3][1],
@@ -2,6 +2,7 @@
 #define LUX_CORE_MATERIAL_H_
 
 #include <cmath>
+#include <cstddef>
 
 #include "core/rgb_spectrum.h"
 #include "core/vec3.h"
@@ -20,26 +21,27 @@ namespace lux {
 
   class Material {
     public:
-      Material(const Material_type & material_type) : m_type(material_type), m_s(), m_t(), m_n() {}
+      Material(const Material_type & material_type) : m_type(material_type) {}
 
-      virtual RGB_spectrum f(const Vec3 & wo_world, const Vec3 & wi_world) const = 0;
-      virtual RGB_spectrum sample_f(const Vec3 & wo_world, Vec3 * pwi_world, const Vec2 & sample,
-                                    float * pdf) const;
+      // The shading space is the (s, t, n) frame of the interaction. Materials are shared
+      // by every render thread, so it isn't stored in them.
+      virtual RGB_spectrum f(const Surface_interaction & interaction, const Vec3 & wo_world,
+                             const Vec3 & wi_world) const = 0;
+      virtual RGB_spectrum sample_f(const Surface_interaction & interaction,
+                                    const Vec3 & wo_world, Vec3 * pwi_world,
+                                    const Vec2 & sample, float * pdf) const;
 
-      virtual float PDF(const Vec3 & wo_world, const Vec3 & wi_world) const;
-
-      void init_shading_space(const Surface_interaction & surface_interaction)
-      {
-        m_s = surface_interaction.s;
-        m_t = surface_interaction.t;
-        m_n = surface_interaction.n;
-      }
+      virtual float PDF(const Surface_interaction & interaction, const Vec3 & wo_world,
+                        const Vec3 & wi_world) const;
 
       Material_type get_type() const { return m_type; }
 
+      // Size of the material's class, materials don't reference other data
+      virtual std::size_t memory_bytes() const = 0;
+
     protected:
-      Vec3 world_to_shading(const Vec3 & v) const;
-      Vec3 shading_to_world(const Vec3 & v) const;
+      Vec3 world_to_shading(const Surface_interaction & interaction, const Vec3 & v) const;
+      Vec3 shading_to_world(const Surface_interaction & interaction, const Vec3 & v) const;
       bool same_hemisphere(const Vec3 & wo, const Vec3 & wi) const;
       float cos_theta(const Vec3 & w) const;
       float squared_cos_theta(const Vec3 & w) const;
@@ -48,7 +50,6 @@ namespace lux {
 
     private:
       Material_type m_type;
-      Vec3 m_s, m_t, m_n; // Define the local shading space.
   };
 
   inline bool Material::same_hemisphere(const Vec3 & wo, const Vec3 & wi) const
@@ -56,18 +57,26 @@ namespace lux {
     return wo.z * wi.z > 0;
   }
 
-  inline Vec3 Material::world_to_shading(const Vec3 & v) const
+  inline Vec3 Material::world_to_shading(const Surface_interaction & interaction,
+                                         const Vec3 & v) const
   {
-    return Vec3(v.x * m_s.x + v.y * m_s.y + v.z * m_s.z,
-                v.x * m_t.x + v.y * m_t.y + v.z * m_t.z,
-                v.x * m_n.x + v.y * m_n.y + v.z * m_n.z);
+    const Vec3 & s = interaction.s;
+    const Vec3 & t = interaction.t;
+    const Vec3 & n = interaction.n;
+    return Vec3(v.x * s.x + v.y * s.y + v.z * s.z,
+                v.x * t.x + v.y * t.y + v.z * t.z,
+                v.x * n.x + v.y * n.y + v.z * n.z);
   }
 
-  inline Vec3 Material::shading_to_world(const Vec3 & v) const
+  inline Vec3 Material::shading_to_world(const Surface_interaction & interaction,
+                                         const Vec3 & v) const
   {
-    return Vec3(v.x * m_s.x + v.y * m_t.x + v.z * m_n.x,
-                v.x * m_s.y + v.y * m_t.y + v.z * m_n.y,
-                v.x * m_s.z + v.y * m_t.z + v.z * m_n.z);
+    const Vec3 & s = interaction.s;
+    const Vec3 & t = interaction.t;
+    const Vec3 & n = interaction.n;
+    return Vec3(v.x * s.x + v.y * t.x + v.z * n.x,
+                v.x * s.y + v.y * t.y + v.z * n.y,
+                v.x * s.z + v.y * t.z + v.z * n.z);
   }
 
   inline float Material::cos_theta(const Vec3 & w) const
@@ -0,0 +1,67 @@
+#include "core/memory_arena.h"
+
+#include <cstddef>
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "core/error.h"
+
+namespace lux {
+  Memory_arena::Memory_arena(const std::size_t block_size)
+      : m_blocks(),
+        m_block_size(block_size),
+        m_current_block(0),
+        m_offset(0) {}
+
+  void * Memory_arena::allocate(const std::size_t bytes, const std::size_t alignment)
+  {
+    ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0 &&
+           alignment <= alignof(std::max_align_t), "Unsupported arena alignment");
+
+    // Blocks without room for this allocation are skipped until the next reset
+    for (; m_current_block != m_blocks.size(); ++m_current_block, m_offset = 0) {
+      Block & block = m_blocks[m_current_block];
+      const std::size_t kstart = (m_offset + alignment - 1) & ~(alignment - 1);
+      if (kstart + bytes <= block.size) {
+        m_offset = kstart + bytes;
+        return block.pdata.get() + kstart;
+      }
+    }
+
+    // Allocations larger than a block get a block of their own. The memory of new[] is
+    // aligned for any fundamental type.
+    const std::size_t ksize = std::max(bytes, m_block_size);
+    m_blocks.push_back(Block{ std::unique_ptr<unsigned char[]>(new unsigned char[ksize]),
+                              ksize });
+    m_current_block = m_blocks.size() - 1;
+    m_offset = bytes;
+
+    return m_blocks.back().pdata.get();
+  }
+
+  void Memory_arena::reset()
+  {
+    m_current_block = 0;
+    m_offset = 0;
+  }
+
+  std::size_t Memory_arena::used_bytes() const
+  {
+    std::size_t bytes = m_offset;
+    for (std::size_t i = 0; i < m_current_block && i != m_blocks.size(); ++i) {
+      bytes += m_blocks[i].size;
+    }
+
+    return bytes;
+  }
+
+  std::size_t Memory_arena::capacity_bytes() const
+  {
+    std::size_t bytes = 0;
+    for (const Block & kblock : m_blocks) bytes += kblock.size;
+
+    return bytes;
+  }
+}
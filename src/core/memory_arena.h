@@ -0,0 +1,79 @@
+#ifndef LUX_CORE_MEMORY_ARENA_H_
+#define LUX_CORE_MEMORY_ARENA_H_
+
+#include <cstddef>
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+namespace lux {
+  // Bump allocator for data that only lives while a sample or a tile is rendered, like
+  // BSDFs, light samples or ray queues. Allocations are carved out of blocks and all freed
+  // at once by reset(), which keeps the blocks, so once the arena has grown to what a sample
+  // needs it doesn't call the global allocator anymore. Each render thread has its own.
+  class Memory_arena final {
+    public:
+      static const std::size_t kdefault_block_size = 256 * 1024;
+
+      explicit Memory_arena(const std::size_t block_size = kdefault_block_size);
+
+      Memory_arena(const Memory_arena &) = delete;
+      Memory_arena & operator=(const Memory_arena &) = delete;
+
+      // alignment is a power of two, at most alignof(std::max_align_t)
+      void * allocate(const std::size_t bytes,
+                      const std::size_t alignment = alignof(std::max_align_t));
+
+      // Destructors are never run, so only trivially destructible types are allowed
+      template<typename T, typename... Args>
+      T * create(Args &&... args);
+
+      // n value initialized Ts
+      template<typename T>
+      T * create_array(const std::size_t n);
+
+      // Frees everything allocated, keeping the blocks for the next allocations
+      void reset();
+
+      // Since the last reset, including the ends of blocks skipped for lack of room
+      std::size_t used_bytes() const;
+      std::size_t capacity_bytes() const;
+
+    private:
+      struct Block {
+        std::unique_ptr<unsigned char[]> pdata;
+        std::size_t size;
+      };
+
+      std::vector<Block> m_blocks;
+      std::size_t m_block_size;
+      std::size_t m_current_block;  // Allocations come from this block or the ones after it
+      std::size_t m_offset;         // First free byte of the current block
+  };
+
+  template<typename T, typename... Args>
+  inline T * Memory_arena::create(Args &&... args)
+  {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "Memory_arena never runs destructors");
+
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  template<typename T>
+  inline T * Memory_arena::create_array(const std::size_t n)
+  {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "Memory_arena never runs destructors");
+
+    T * parray = static_cast<T *>(allocate(n * sizeof(T), alignof(T)));
+    for (std::size_t i = 0; i != n; ++i) new (parray + i) T();
+
+    return parray;
+  }
+}
+
+#endif
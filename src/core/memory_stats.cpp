@@ -0,0 +1,138 @@
+#include "core/memory_stats.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+
+#include <new>
+#include <memory>
+#include <vector>
+#include <iomanip>
+#include <ostream>
+
+#include "core/scene.h"
+#include "core/shape.h"
+#include "core/material.h"
+#include "core/transform.h"
+#include "core/rgb_spectrum.h"
+#include "accelerators/bvh.h"
+
+namespace lux {
+  namespace {
+    const char * const kcategory_names[knum_memory_categories] = {
+      "shapes", "transforms", "materials", "accelerator", "samplers", "film"
+    };
+
+    // Trivially initialized, so operator new can count before anything else is set up
+    thread_local std::uint64_t tallocations = 0;
+
+    std::size_t shape_list_bytes(const std::vector<std::shared_ptr<Shape>> & shapes)
+    {
+      return shapes.capacity() * sizeof(std::shared_ptr<Shape>);
+    }
+  }
+
+  Memory_stats::Memory_stats() : m_visited()
+  {
+    for (std::size_t & bytes : m_bytes) bytes = 0;
+  }
+
+  std::size_t Memory_stats::total_bytes() const
+  {
+    std::size_t total = 0;
+    for (const std::size_t kbytes : m_bytes) total += kbytes;
+
+    return total;
+  }
+
+  const char * memory_category_name(const Memory_category category)
+  {
+    return kcategory_names[category];
+  }
+
+  void add_scene_memory(const Scene & scene, Memory_stats * pstats)
+  {
+    pstats->add(Memory_category::kshape_memory, sizeof(Scene) +
+                                                 shape_list_bytes(scene.get_shapes()) +
+                                                 shape_list_bytes(scene.get_lights()));
+    for (const std::shared_ptr<Shape> & kpshape : scene.get_shapes()) {
+      if (pstats->first_visit(kpshape.get())) kpshape->add_memory(pstats);
+    }
+    if (scene.get_accelerator()) add_bvh_memory(*scene.get_accelerator(), pstats);
+  }
+
+  void add_bvh_memory(const BVH & bvh, Memory_stats * pstats)
+  {
+    pstats->add(Memory_category::kaccelerator_memory,
+                sizeof(BVH) + bvh.get_build_stats().memory_bytes);
+    // Shapes are also counted by the scene, or by the other instances of a BLAS
+    for (const std::shared_ptr<Shape> & kpshape : bvh.get_shapes()) {
+      if (pstats->first_visit(kpshape.get())) kpshape->add_memory(pstats);
+    }
+  }
+
+  void add_shape_memory(const Shape & shape, const std::size_t object_bytes,
+                        Memory_stats * pstats)
+  {
+    pstats->add(Memory_category::kshape_memory, object_bytes);
+
+    // Shape table entries are shared, each is added once
+    const Transform & kobject_to_world = shape.get_object_to_world();
+    if (pstats->first_visit(&kobject_to_world)) {
+      pstats->add(Memory_category::ktransform_memory, sizeof(Transform));
+    }
+
+    const std::shared_ptr<Material> & kpmaterial = shape.get_material();
+    if (pstats->first_visit(&kpmaterial)) {
+      pstats->add(Memory_category::kmaterial_memory, sizeof(std::shared_ptr<Material>));
+      if (kpmaterial && pstats->first_visit(kpmaterial.get())) {
+        pstats->add(Memory_category::kmaterial_memory, kpmaterial->memory_bytes());
+      }
+    }
+
+    const RGB_spectrum & kemitted_radiance = shape.get_le();
+    if (pstats->first_visit(&kemitted_radiance)) {
+      pstats->add(Memory_category::kmaterial_memory, sizeof(RGB_spectrum));
+    }
+  }
+
+  std::ostream & operator<<(std::ostream & os, const Memory_stats & stats)
+  {
+    const double kkib = 1024.0;
+    const std::ios::fmtflags kflags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    for (unsigned i = 0; i != knum_memory_categories; ++i) {
+      os << "  " << std::left << std::setw(32) << kcategory_names[i] << std::right
+         << std::setw(14) << stats.bytes(static_cast<Memory_category>(i)) / kkib << " KiB\n";
+    }
+    os << "  " << std::left << std::setw(32) << "total" << std::right << std::setw(14)
+       << stats.total_bytes() / kkib << " KiB\n";
+    os.flags(kflags);
+
+    return os;
+  }
+
+  std::uint64_t thread_allocations()
+  {
+    return tallocations;
+  }
+}
+
+// Counts every allocation on its thread, the array and nothrow forms call this one
+void * operator new(std::size_t size)
+{
+  ++lux::tallocations;
+  for (;;) {
+    void * p = std::malloc(size ? size : 1);
+    if (p) return p;
+
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void operator delete(void * p) noexcept
+{
+  std::free(p);
+}
@@ -0,0 +1,67 @@
+#ifndef LUX_CORE_MEMORY_STATS_H_
+#define LUX_CORE_MEMORY_STATS_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include <unordered_set>
+#include <ostream>
+
+namespace lux { class Scene; class Shape; class BVH; }
+
+namespace lux {
+  enum Memory_category {
+    kshape_memory,        // Shape objects, shape lists and the arrays meshes own
+    ktransform_memory,    // Transforms of shapes, meshes and instances
+    kmaterial_memory,
+    kaccelerator_memory,  // BVH nodes and leaf references, of instanced BVHs too
+    ksampler_memory,      // Sample tables of the render threads' samplers
+    kfilm_memory,         // Film bands and the tiles being rendered
+    knum_memory_categories
+  };
+
+  // Bytes used by each subsystem. Data shared by several owners, like materials, meshes and
+  // the BVHs of instances, is only counted by the first owner that adds it. The arrays of
+  // memory mapped mesh files aren't counted, their pages are in the page cache.
+  class Memory_stats final {
+    public:
+      Memory_stats();
+
+      void add(const Memory_category category, const std::size_t bytes)
+      {
+        m_bytes[category] += bytes;
+      }
+
+      // True the first time p is passed, so shared data is only added once
+      bool first_visit(const void * p) { return m_visited.insert(p).second; }
+
+      std::size_t bytes(const Memory_category category) const { return m_bytes[category]; }
+      std::size_t total_bytes() const;
+
+    private:
+      std::size_t m_bytes[knum_memory_categories];
+      std::unordered_set<const void *> m_visited;
+  };
+
+  const char * memory_category_name(const Memory_category category);
+
+  // Adds the shape lists, shapes, transforms, materials and BVHs of a finalized scene
+  void add_scene_memory(const Scene & scene, Memory_stats * pstats);
+
+  // Adds the nodes of bvh and the shapes it references
+  void add_bvh_memory(const BVH & bvh, Memory_stats * pstats);
+
+  // For Shape::add_memory overrides. object_bytes is the size of the shape's class, the
+  // shape table entries it references, and its material, are added the first time they're seen.
+  void add_shape_memory(const Shape & shape, const std::size_t object_bytes,
+                        Memory_stats * pstats);
+
+  // One line per category and the total, in KiB
+  std::ostream & operator<<(std::ostream & os, const Memory_stats & stats);
+
+  // Heap allocations made by the calling thread so far. lux replaces the global operator
+  // new to count them, to check that the render loop doesn't allocate.
+  std::uint64_t thread_allocations();
+}
+
+#endif
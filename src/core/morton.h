@@ -0,0 +1,31 @@
+#ifndef LUX_CORE_MORTON_H_
+#define LUX_CORE_MORTON_H_
+
+#include <cstdint>
+
+#include "core/vec3.h"
+
+namespace lux {
+  // Spreads the lower 10 bits of x, leaving two zero bits between each of them.
+  inline std::uint32_t left_shift_3(std::uint32_t x)
+  {
+    if (x == (1 << 10)) --x;
+    x = (x | (x << 16)) & 0x30000ff;
+    x = (x | (x << 8)) & 0x300f00f;
+    x = (x | (x << 4)) & 0x30c30c3;
+    x = (x | (x << 2)) & 0x9249249;
+
+    return x;
+  }
+
+  // 30 bit Morton code interleaving the axes as ...zyxzyx. Expects the coordinates of v
+  // in [0, 1].
+  inline std::uint32_t morton_code_3D(const Vec3 & v)
+  {
+    const float kscale = 1 << 10;
+    return (left_shift_3(v.z * kscale) << 2) | (left_shift_3(v.y * kscale) << 1) |
+           left_shift_3(v.x * kscale);
+  }
+}
+
+#endif
@@ -0,0 +1,44 @@
+#include "core/parallel.h"
+
+#include <cstddef>
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+namespace lux {
+  unsigned num_system_cores()
+  {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  void parallel_for(const std::size_t count,
+                    const std::function<void(std::size_t, std::size_t)> & func,
+                    unsigned num_threads)
+  {
+    if (num_threads == 0) num_threads = num_system_cores();
+    num_threads = static_cast<unsigned>(std::min<std::size_t>(num_threads, count));
+
+    if (num_threads <= 1) {
+      if (count != 0) func(0, count);
+      return;
+    }
+
+    const std::size_t kchunk_size = (count + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+
+    // The calling thread takes the first range
+    for (unsigned i = 1; i != num_threads; ++i) {
+      const std::size_t kbegin = i * kchunk_size;
+      const std::size_t kend = std::min(count, kbegin + kchunk_size);
+      if (kbegin >= kend) break;
+      threads.push_back(std::thread(func, kbegin, kend));
+    }
+
+    func(0, std::min(count, kchunk_size));
+
+    for (std::thread & thread : threads) thread.join();
+  }
+}
@@ -0,0 +1,19 @@
+#ifndef LUX_CORE_PARALLEL_H_
+#define LUX_CORE_PARALLEL_H_
+
+#include <cstddef>
+
+#include <functional>
+
+namespace lux {
+  // Number of hardware threads, at least one.
+  unsigned num_system_cores();
+
+  // Splits [0, count) into one contiguous range per thread and calls func(begin, end) for
+  // each range. Passing 0 as num_threads uses every core. Returns after all ranges are done.
+  void parallel_for(const std::size_t count,
+                    const std::function<void(std::size_t, std::size_t)> & func,
+                    unsigned num_threads = 0);
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "core/pixel_sampler.h"
 
 #include <cstdint>
+#include <cstddef>
 
 #include <vector>
 
@@ -10,11 +11,12 @@
 
 namespace lux {
   Pixel_sampler::Pixel_sampler(const std::uint64_t samples_per_pixel,
-                               const unsigned dimensions_per_sample)
+                               const unsigned dimensions_per_sample,
+                               const unsigned long long seed)
       : Sampler(samples_per_pixel),
         m_samples_1D(),
         m_samples_2D(),
-        m_rng(),
+        m_rng(seed),
         m_current_1D_dimension(0),
         m_current_2D_dimension(0)
   {
@@ -61,4 +63,24 @@ namespace lux {
       return Vec2(m_rng(), m_rng());
     }
   }
+
+  void Pixel_sampler::reseed(const unsigned long long seed)
+  {
+    // The tables are filled and the dimensions restarted by start_pixel
+    m_rng = RNG(seed);
+  }
+
+  std::size_t Pixel_sampler::table_bytes() const
+  {
+    std::size_t bytes = m_samples_1D.capacity() * sizeof(std::vector<float>) +
+                        m_samples_2D.capacity() * sizeof(std::vector<Vec2>);
+    for (const std::vector<float> & kdimension : m_samples_1D) {
+      bytes += kdimension.capacity() * sizeof(float);
+    }
+    for (const std::vector<Vec2> & kdimension : m_samples_2D) {
+      bytes += kdimension.capacity() * sizeof(Vec2);
+    }
+
+    return bytes;
+  }
 }
@@ -2,6 +2,7 @@
 #define LUX_CORE_PIXEL_SAMPLER_H_
 
 #include <cstdint>
+#include <cstddef>
 
 #include <vector>
 
@@ -12,13 +13,21 @@
 namespace lux {
   class Pixel_sampler : public Sampler {
     public:
-      Pixel_sampler(const std::uint64_t samples_per_pixel, const unsigned dimensions_per_sample);
+      Pixel_sampler(const std::uint64_t samples_per_pixel, const unsigned dimensions_per_sample,
+                    const unsigned long long seed = kdefault_rng_seed);
       virtual void start_pixel() override;
       virtual bool start_next_sample() override;
 
       virtual float get_1D() override;
       virtual Vec2  get_2D() override;
 
+      // The dimensions x samples per pixel tables of 1D and 2D samples
+      virtual std::size_t table_bytes() const override;
+
+      // Restarts the sequence as if the sampler was constructed with seed, keeping its
+      // tables, so a render thread can reuse one sampler for all of its tiles
+      void reseed(const unsigned long long seed);
+
     protected:
       std::vector<std::vector<float> > m_samples_1D;
       std::vector<std::vector<Vec2> > m_samples_2D;
@@ -0,0 +1,180 @@
+#include "core/post_process.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include <vector>
+#include <algorithm>
+
+#include "core/film.h"
+#include "core/rgb_spectrum.h"
+#include "core/parallel.h"
+
+namespace lux {
+  namespace {
+    const unsigned klut_size = 4096;
+
+    float srgb_exact(const float x)
+    {
+      return (x <= 0.0031308f) ? 12.92f * x : 1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f;
+    }
+
+    // Samples of the sRGB curve over [0, 1], with one extra entry so interpolating the last
+    // interval doesn't need a special case
+    struct Srgb_table {
+      Srgb_table()
+      {
+        for (unsigned i = 0; i <= klut_size; ++i) values[i] = srgb_exact(float(i) / klut_size);
+      }
+
+      float values[klut_size + 1];
+    };
+
+    const Srgb_table & srgb_table()
+    {
+      static const Srgb_table ktable;
+      return ktable;
+    }
+
+    // Each pass works on the 3 * width channel values of a row. The results are clamped to
+    // [0, 1], and written so NaNs become 0.
+    void tonemap_row(float * pvalues, const std::size_t count, const float scale,
+                     const Tonemap_operator tonemap)
+    {
+      switch (tonemap) {
+        case Tonemap_operator::kreinhard:
+          for (std::size_t i = 0; i != count; ++i) {
+            const float kx = pvalues[i] * scale;
+            pvalues[i] = (kx > 0.0f) ? kx / (1.0f + kx) : 0.0f;
+          }
+          break;
+
+        case Tonemap_operator::kaces:
+          for (std::size_t i = 0; i != count; ++i) {
+            const float kx = pvalues[i] * scale;
+            const float kmapped = (kx * (2.51f * kx + 0.03f)) / (kx * (2.43f * kx + 0.59f) + 0.14f);
+            pvalues[i] = (kx > 0.0f) ? std::min(kmapped, 1.0f) : 0.0f;
+          }
+          break;
+
+        default:
+          for (std::size_t i = 0; i != count; ++i) {
+            const float kx = pvalues[i] * scale;
+            pvalues[i] = (kx > 0.0f) ? std::min(kx, 1.0f) : 0.0f;
+          }
+          break;
+      }
+    }
+
+    void encode_row(float * pvalues, const std::size_t count, const Srgb_encoding encoding)
+    {
+      if (encoding == Srgb_encoding::klut) {
+        const float * ktable = srgb_table().values;
+        for (std::size_t i = 0; i != count; ++i) {
+          const float kposition = pvalues[i] * klut_size;
+          const unsigned kindex = std::min(static_cast<unsigned>(kposition), klut_size - 1);
+          const float kt = kposition - kindex;
+          pvalues[i] = ktable[kindex] + kt * (ktable[kindex + 1] - ktable[kindex]);
+        }
+      }
+      else if (encoding == Srgb_encoding::kpolynomial) {
+        for (std::size_t i = 0; i != count; ++i) {
+          const float kx = pvalues[i];
+          const float ks1 = std::sqrt(kx);
+          const float ks2 = std::sqrt(ks1);
+          const float ks3 = std::sqrt(ks2);
+          const float kcurve = 0.662002687f * ks1 + 0.684122060f * ks2 - 0.323583601f * ks3 -
+                               0.0225411470f * kx;
+          pvalues[i] = (kx <= 0.0031308f) ? 12.92f * kx : std::min(kcurve, 1.0f);
+        }
+      }
+      else {
+        for (std::size_t i = 0; i != count; ++i) pvalues[i] = srgb_exact(pvalues[i]);
+      }
+    }
+
+    // Uniform in [0, 1) from a hash of the channel index
+    inline float hash_to_unit(std::uint32_t x)
+    {
+      x ^= x >> 16;
+      x *= 0x7feb352dU;
+      x ^= x >> 15;
+      x *= 0x846ca68bU;
+      x ^= x >> 16;
+      return (x >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // first_index is the index of the row's first channel in the whole image, which seeds
+    // the dither
+    template<typename T>
+    void quantize_row(const float * pvalues, const std::size_t count,
+                      const std::uint32_t first_index, const float max_value, const bool dither,
+                      T * pquantized)
+    {
+      for (std::size_t i = 0; i != count; ++i) {
+        const std::uint32_t kindex = first_index + static_cast<std::uint32_t>(i);
+        const float knoise = dither ? hash_to_unit(2 * kindex) - hash_to_unit(2 * kindex + 1)
+                                    : 0.0f;
+        const float kvalue = pvalues[i] * max_value + 0.5f + knoise;
+        pquantized[i] = static_cast<T>(std::max(0.0f, std::min(kvalue, max_value)));
+      }
+    }
+  }
+
+  std::size_t display_row_bytes(const unsigned width, const Post_process_options & options)
+  {
+    return std::size_t(3) * width * ((options.bits_per_channel > 8) ? 2 : 1);
+  }
+
+  void post_process(const Film & film, const unsigned y_begin, const unsigned y_end,
+                    const Post_process_options & options, unsigned char * pdisplay)
+  {
+    const unsigned kwidth = film.get_width();
+    const unsigned ktile_size = film.get_tile_size();
+    const std::size_t kcount = std::size_t(3) * kwidth;
+    const std::size_t krow_bytes = display_row_bytes(kwidth, options);
+    const bool kwide = options.bits_per_channel > 8;
+    const float kmax_value = kwide ? 65535.0f : 255.0f;
+    const float kscale = std::exp2(options.exposure);
+    srgb_table();  // Built before the threads start
+
+    parallel_for(y_end - y_begin, [&](const std::size_t first, const std::size_t last)
+        {
+          std::vector<float> values(kcount);
+          std::vector<std::uint16_t> wide_values(kwide ? kcount : 0);
+
+          for (std::size_t i = first; i != last; ++i) {
+            const unsigned ky = y_begin + i;
+
+            // Gathers the row one tile row at a time
+            float * pvalue = values.data();
+            for (unsigned x = 0; x < kwidth; x += ktile_size) {
+              const RGB_spectrum * ppixel = &film.pixel(x, ky);
+              for (unsigned j = 0; j != std::min(ktile_size, kwidth - x); ++j, ++ppixel) {
+                *pvalue++ = (*ppixel)[0];
+                *pvalue++ = (*ppixel)[1];
+                *pvalue++ = (*ppixel)[2];
+              }
+            }
+
+            tonemap_row(values.data(), kcount, kscale, options.tonemap);
+            encode_row(values.data(), kcount, options.encoding);
+
+            unsigned char * prow = pdisplay + i * krow_bytes;
+            const std::uint32_t kfirst_index = static_cast<std::uint32_t>(ky * kcount);
+            if (!kwide) {
+              quantize_row(values.data(), kcount, kfirst_index, kmax_value, options.dither, prow);
+            }
+            else {
+              quantize_row(values.data(), kcount, kfirst_index, kmax_value, options.dither,
+                           wide_values.data());
+              for (std::size_t c = 0; c != kcount; ++c) {
+                prow[2 * c] = wide_values[c] >> 8;
+                prow[2 * c + 1] = wide_values[c] & 0xff;
+              }
+            }
+          }
+        }, options.num_threads);
+  }
+}
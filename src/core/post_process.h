@@ -0,0 +1,45 @@
+#ifndef LUX_CORE_POST_PROCESS_H_
+#define LUX_CORE_POST_PROCESS_H_
+
+#include <cstddef>
+
+namespace lux { class Film; }
+
+namespace lux {
+  // Maps the scene referred radiance of the film to [0, 1]
+  enum Tonemap_operator {
+    kclip,      // Clamps, for scenes already exposed for display
+    kreinhard,  // x / (1 + x)
+    kaces       // Narkowicz's fit of the ACES filmic curve
+  };
+
+  // How the sRGB transfer function is evaluated. The polynomial and table are faster than
+  // pow and both are accurate to well under half an 8 bit step.
+  enum Srgb_encoding {
+    klut,         // 4096 entry table, linearly interpolated
+    kpolynomial,  // Polynomial in the 2nd, 4th and 8th roots of the value
+    kexact        // std::pow
+  };
+
+  struct Post_process_options {
+    float exposure = 0.0f;  // In stops
+    Tonemap_operator tonemap = Tonemap_operator::kclip;
+    Srgb_encoding encoding = Srgb_encoding::klut;
+    bool dither = true;     // Adds triangular noise of one quantization step
+    unsigned bits_per_channel = 8;
+    unsigned num_threads = 0;  // 0 uses every core
+  };
+
+  // Converts the rows [y_begin, y_end) of film to display values, 3 per pixel, into
+  // pdisplay. They are bytes for 8 bits per channel or 16 bit big endian values, which is
+  // what binary PPM files store. Rows are processed in parallel, each one in passes over
+  // contiguous float arrays that the compiler vectorizes. The dither only depends on the
+  // pixel position, so the result doesn't depend on the thread count or the row ranges.
+  void post_process(const Film & film, const unsigned y_begin, const unsigned y_end,
+                    const Post_process_options & options, unsigned char * pdisplay);
+
+  // Bytes post_process writes for each row of a film width pixels wide
+  std::size_t display_row_bytes(const unsigned width, const Post_process_options & options);
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef LUX_CORE_RENDER_SETTINGS_H_
+#define LUX_CORE_RENDER_SETTINGS_H_
+
+#include <string>
+#include <limits>
+
+#include "core/vec3.h"
+#include "core/post_process.h"
+#include "accelerators/bvh.h"
+
+namespace lux {
+  // Everything a render needs besides the geometry
+  struct Render_settings {
+    unsigned width = 600;
+    unsigned height = 600;
+    unsigned samples_x = 8;    // The stratified sampler takes samples_x * samples_y per pixel
+    unsigned samples_y = 8;
+    bool tent_filter = false;  // Box filter otherwise
+    unsigned max_depth = 5;
+    // Samples brighter than this are scaled down, trading bias for less noise
+    float max_sample_value = std::numeric_limits<float>::infinity();
+    unsigned num_threads = 0;  // 0 uses every core
+    std::string output;        // Chosen by the caller if empty
+    Post_process_options display;
+
+    Vec3 eye;
+    Vec3 look = Vec3(0.0f, 0.0f, 1.0f);
+    float fov = 90.0f;
+    float lens_radius = 0.0f;
+    float focal_distance = 1e6f;
+    // Camera rays are spread over these times, which blurs the animated instances
+    float shutter_open = 0.0f;
+    float shutter_close = 0.0f;
+
+    BVH_builder bvh_builder = BVH_builder::kspatial_sah;
+    bool quantize_bvh = false;
+  };
+
+  // The BVH options of a render, lux_bench builds with the same ones as lux
+  inline BVH_build_options bvh_build_options(const Render_settings & settings)
+  {
+    BVH_build_options options;
+    options.builder = settings.bvh_builder;
+    options.quantize_nodes = settings.quantize_bvh;
+    options.num_threads = settings.num_threads;
+
+    return options;
+  }
+}
+
+#endif
@@ -0,0 +1,172 @@
+#include "core/render_stats.h"
+
+#include <cstdint>
+#include <cstddef>
+
+#include <chrono>
+#include <iomanip>
+#include <string>
+#include <ostream>
+
+#include "core/memory_stats.h"
+
+namespace lux {
+  bool g_time_render_phases = false;
+
+  namespace {
+    const char * const kcounter_names[knum_render_counters] = {
+      "camera_rays", "indirect_rays", "shadow_rays", "node_tests", "primitive_tests", "paths",
+      "path_vertices", "russian_roulette_terminations", "allocations", "region_loop_allocations"
+    };
+
+    const char * const kphase_names[knum_render_phases] = {
+      "intersect", "shading", "sampling", "other"
+    };
+
+    struct Phase_clock {
+      Render_phase phase;
+      std::int64_t since;
+    };
+
+    thread_local Phase_clock tphase_clock = { kother_phase, 0 };
+
+    std::int64_t now_nanoseconds()
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Charges the time since the last change to the running phase
+    std::int64_t charge_phase(Phase_clock * pclock)
+    {
+      const std::int64_t know = now_nanoseconds();
+      thread_render_stats().phase_nanoseconds[pclock->phase] += know - pclock->since;
+      pclock->since = know;
+
+      return know;
+    }
+
+    std::uint64_t total_rays(const Render_stats & stats)
+    {
+      return stats.counters[kcamera_rays] + stats.counters[kindirect_rays] +
+             stats.counters[kshadow_rays];
+    }
+
+    double ratio(const std::uint64_t numerator, const std::uint64_t denominator)
+    {
+      return denominator ? double(numerator) / denominator : 0.0;
+    }
+  }
+
+  Render_stats & Render_stats::operator+=(const Render_stats & rhs)
+  {
+    for (unsigned i = 0; i != knum_render_counters; ++i) counters[i] += rhs.counters[i];
+    for (unsigned i = 0; i != knum_render_phases; ++i) {
+      phase_nanoseconds[i] += rhs.phase_nanoseconds[i];
+    }
+    sampler_bytes += rhs.sampler_bytes;
+    tile_bytes += rhs.tile_bytes;
+
+    return *this;
+  }
+
+  void reset_thread_render_stats()
+  {
+    thread_render_stats() = Render_stats();
+    tphase_clock.phase = kother_phase;
+    if (g_time_render_phases) tphase_clock.since = now_nanoseconds();
+  }
+
+  const Render_stats & finish_thread_render_stats()
+  {
+    if (g_time_render_phases) charge_phase(&tphase_clock);
+
+    return thread_render_stats();
+  }
+
+  Render_phase Scoped_render_phase::switch_render_phase(const Render_phase phase)
+  {
+    charge_phase(&tphase_clock);
+    const Render_phase kprevious = tphase_clock.phase;
+    tphase_clock.phase = phase;
+
+    return kprevious;
+  }
+
+  void print_render_stats(std::ostream & os, const Render_stats & stats,
+                          const double render_seconds)
+  {
+    const std::uint64_t krays = total_rays(stats);
+    const std::ios::fmtflags kflags = os.flags();
+    os << std::fixed << std::setprecision(2);
+    for (unsigned i = 0; i != knum_render_counters; ++i) {
+      os << "  " << std::left << std::setw(32) << kcounter_names[i] << std::right
+         << std::setw(16) << stats.counters[i] << '\n';
+    }
+    os << "  " << std::left << std::setw(32) << "rays" << std::right << std::setw(16)
+       << krays;
+    if (render_seconds > 0.0) os << std::setw(12) << krays * 1e-6 / render_seconds << " Mrays/s";
+    os << '\n'
+       << "  " << std::left << std::setw(32) << "node tests per ray" << std::right
+       << std::setw(16) << ratio(stats.counters[knode_tests], krays) << '\n'
+       << "  " << std::left << std::setw(32) << "primitive tests per ray" << std::right
+       << std::setw(16) << ratio(stats.counters[kprimitive_tests], krays) << '\n'
+       << "  " << std::left << std::setw(32) << "average path length" << std::right
+       << std::setw(16) << ratio(stats.counters[kpath_vertices], stats.counters[kpaths])
+       << '\n';
+
+    std::uint64_t total_nanoseconds = 0;
+    for (unsigned i = 0; i != knum_render_phases; ++i) {
+      total_nanoseconds += stats.phase_nanoseconds[i];
+    }
+    if (g_time_render_phases) {
+      // Summed over the render threads
+      for (unsigned i = 0; i != knum_render_phases; ++i) {
+        os << "  " << std::left << std::setw(32) << (std::string("time in ") + kphase_names[i])
+           << std::right << std::setw(14) << stats.phase_nanoseconds[i] * 1e-9 << " s"
+           << std::setw(10) << 100.0 * ratio(stats.phase_nanoseconds[i], total_nanoseconds)
+           << "%\n";
+      }
+    }
+    os.flags(kflags);
+  }
+
+  void write_render_stats_json(std::ostream & os, const Render_stats & stats,
+                               const double render_seconds, const Memory_stats * pmemory)
+  {
+    const std::uint64_t krays = total_rays(stats);
+    const std::ios::fmtflags kflags = os.flags();
+    os << std::setprecision(9);
+    os << "{\n  \"render_seconds\": " << render_seconds << ",\n  \"counters\": {";
+    for (unsigned i = 0; i != knum_render_counters; ++i) {
+      os << (i ? ",\n" : "\n") << "    \"" << kcounter_names[i] << "\": " << stats.counters[i];
+    }
+    os << "\n  },\n  \"rays\": " << krays
+       << ",\n  \"rays_per_second\": " << (render_seconds > 0.0 ? krays / render_seconds : 0.0)
+       << ",\n  \"average_path_length\": "
+       << ratio(stats.counters[kpath_vertices], stats.counters[kpaths])
+       << ",\n  \"phase_seconds\": ";
+    if (g_time_render_phases) {
+      os << "{";
+      for (unsigned i = 0; i != knum_render_phases; ++i) {
+        os << (i ? ",\n" : "\n") << "    \"" << kphase_names[i] << "\": "
+           << stats.phase_nanoseconds[i] * 1e-9;
+      }
+      os << "\n  }";
+    }
+    else {
+      os << "null";
+    }
+    if (pmemory) {
+      os << ",\n  \"memory_bytes\": {";
+      for (unsigned i = 0; i != knum_memory_categories; ++i) {
+        const Memory_category kcategory = static_cast<Memory_category>(i);
+        os << (i ? ",\n" : "\n") << "    \"" << memory_category_name(kcategory) << "\": "
+           << pmemory->bytes(kcategory);
+      }
+      os << "\n  }";
+    }
+    os << "\n}\n";
+    os.flags(kflags);
+  }
+}
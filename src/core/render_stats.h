@@ -0,0 +1,105 @@
+#ifndef LUX_CORE_RENDER_STATS_H_
+#define LUX_CORE_RENDER_STATS_H_
+
+#include <cstdint>
+
+#include <ostream>
+
+namespace lux { class Memory_stats; }
+
+namespace lux {
+  enum Render_counter {
+    kcamera_rays,
+    kindirect_rays,    // Rays continuing paths after their first vertex
+    kshadow_rays,      // Rays towards lights traced by direct lighting, light or BRDF sampled
+    knode_tests,       // BVH node bounds tested
+    kprimitive_tests,  // Shape intersection tests in BVH leaves
+    kpaths,
+    kpath_vertices,    // Intersections found along paths
+    krussian_roulette_terminations,
+    kallocations,              // Heap allocations of the render threads
+    kregion_loop_allocations,  // Those made rendering the pixels of regions, 0. The trace
+                               // events and film bands around them aren't counted.
+    knum_render_counters
+  };
+
+  // Exclusive time, a phase started inside another one pauses it
+  enum Render_phase {
+    kintersect_phase,  // Scene::intersect and intersect_p
+    kshading_phase,    // Light sampling and BRDF evaluation
+    ksampling_phase,   // Pixel samples and camera rays
+    kother_phase,      // The rest of the render threads' time, e.g. filling tiles
+    knum_render_phases
+  };
+
+  struct Render_stats {
+    std::uint64_t counters[knum_render_counters];
+    std::uint64_t phase_nanoseconds[knum_render_phases];
+    // Sampler tables and film tile of each thread, summed over the threads
+    std::uint64_t sampler_bytes;
+    std::uint64_t tile_bytes;
+
+    Render_stats & operator+=(const Render_stats & rhs);
+  };
+
+  // Reading the clock at each phase change costs about as much as a ray box test, so
+  // phases are only timed when enabled. Set it before rendering.
+  extern bool g_time_render_phases;
+
+  // Stats of the calling thread. Render threads reset them when they start and add them
+  // to the render's total when they finish, so only these thread local copies are
+  // written while rendering.
+  inline Render_stats & thread_render_stats()
+  {
+    static thread_local Render_stats tstats = Render_stats();
+    return tstats;
+  }
+
+  inline void add_render_count(const Render_counter counter, const std::uint64_t n = 1)
+  {
+    thread_render_stats().counters[counter] += n;
+  }
+
+  // Zeroes the stats of the calling thread and starts timing it in kother_phase
+  void reset_thread_render_stats();
+
+  // Charges the time since the last phase change, returns the thread's stats
+  const Render_stats & finish_thread_render_stats();
+
+  // Charges the time the scope takes, minus nested phases, to phase
+  class Scoped_render_phase final {
+    public:
+      explicit Scoped_render_phase(const Render_phase phase)
+          : m_timed(g_time_render_phases), m_previous(kother_phase)
+      {
+        if (m_timed) m_previous = switch_render_phase(phase);
+      }
+
+      ~Scoped_render_phase()
+      {
+        if (m_timed) switch_render_phase(m_previous);
+      }
+
+      Scoped_render_phase(const Scoped_render_phase &) = delete;
+      Scoped_render_phase & operator=(const Scoped_render_phase &) = delete;
+
+    private:
+      // Returns the phase that was running
+      static Render_phase switch_render_phase(const Render_phase phase);
+
+      bool m_timed;
+      Render_phase m_previous;
+  };
+
+  // Summary table. render_seconds is the wall clock time of the render, for rays per
+  // second.
+  void print_render_stats(std::ostream & os, const Render_stats & stats,
+                          const double render_seconds);
+
+  // Includes the bytes of each memory category if pmemory is given
+  void write_render_stats_json(std::ostream & os, const Render_stats & stats,
+                               const double render_seconds,
+                               const Memory_stats * pmemory = nullptr);
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include "core/renderer.h"
+
+#include <cstdint>
+#include <cstddef>
+
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+
+#include "core/camera.h"
+#include "core/ray.h"
+#include "core/vec2.h"
+#include "core/rgb_spectrum.h"
+#include "core/transform.h"
+#include "core/filter.h"
+#include "core/film.h"
+#include "core/film_stream.h"
+#include "core/image_writer.h"
+#include "core/cost_map.h"
+#include "core/scene.h"
+#include "core/parallel.h"
+#include "core/rng.h"
+#include "core/error.h"
+#include "core/render_settings.h"
+#include "core/render_stats.h"
+#include "core/memory_stats.h"
+#include "core/memory_arena.h"
+#include "core/trace.h"
+#include "samplers/stratified.h"
+#include "integrators/path_tracer.h"
+
+namespace lux {
+  namespace {
+    // Scales L down so no component is above max_value, keeping its hue
+    RGB_spectrum clamp_sample(const RGB_spectrum & L, const float max_value)
+    {
+      const float kmax_component = std::max(L[0], std::max(L[1], L[2]));
+      return (kmax_component > max_value) ? L * (max_value / kmax_component) : L;
+    }
+
+    // Running total of the metric on the calling thread, a pixel costs its increase
+    std::uint64_t cost_clock(const Cost_metric metric)
+    {
+      if (metric == Cost_metric::ktime) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+
+      const Render_stats & kstats = thread_render_stats();
+      return kstats.counters[knode_tests] + kstats.counters[kprimitive_tests];
+    }
+
+    // The pilot render of plan_tile_splits is this many times smaller on each side
+    const unsigned kpilot_scale = 4;
+  }
+
+  void render(const Scene & scene, const Render_settings & settings, Film_stream * pfilm_stream,
+              const unsigned pass, const Render_progress & progress, Render_stats * pstats,
+              Cost_map * pcost_map)
+  {
+    ASSERT(!pcost_map || (pcost_map->get_width() == settings.width &&
+                          pcost_map->get_height() == settings.height),
+           "The cost map must be the size of the image");
+
+    const Film & film = pfilm_stream->get_film();
+    const Camera kcamera(Vec2(settings.width, settings.height),
+                         look_at(settings.eye, settings.look), settings.fov,
+                         settings.lens_radius, settings.focal_distance, settings.shutter_open,
+                         settings.shutter_close);
+    const float kinv_samples_per_pixel = 1.0f / (settings.samples_x * settings.samples_y);
+    Vec2 (*pfilter) (const Vec2 &) = settings.tent_filter ? triangle_filter : box_filter;
+    const unsigned knum_threads = settings.num_threads ? settings.num_threads
+                                                       : num_system_cores();
+
+    TRACE_SCOPE_ARG("render pass", "pass", pass);
+    std::mutex stats_mutex;
+    if (pstats) *pstats = Render_stats();
+
+    // Threads take the next region until there are none left
+    parallel_for(knum_threads, [&](const std::size_t, const std::size_t)
+        {
+          reset_thread_render_stats();
+          const std::uint64_t kallocations_start = thread_allocations();
+
+          // Everything the regions need is allocated once per thread, the samplers are
+          // reseeded and the tile is moved for each region
+          Stratified_sampler stratified_sampler(settings.samples_x, settings.samples_y, 2,
+                                                true);
+          Stratified_sampler * pintegrator_sampler =
+              new Stratified_sampler(settings.samples_x, settings.samples_y,
+                                     settings.max_depth * 3, true);
+          Path_tracer path_tracer(pintegrator_sampler, settings.max_depth);
+          Film_tile tile(0, 0, film.get_tile_size(), film.get_tile_size());
+          Memory_arena arena;
+          Camera_sample camera_sample;
+
+          Render_stats & thread_stats = thread_render_stats();
+          thread_stats.sampler_bytes = stratified_sampler.table_bytes() +
+                                       pintegrator_sampler->table_bytes();
+          thread_stats.tile_bytes = std::uint64_t(film.get_tile_size()) * film.get_tile_size() *
+                                    sizeof(RGB_spectrum);
+
+          Film_region region;
+          while (pfilm_stream->next_region(&region)) {
+            const std::uint64_t kregion_allocations_start = thread_allocations();
+            TRACE_SCOPE_ARG("region", "tile", region.tile_index);
+            // Regions of a split tile get their own sample sets, a tile that isn't split is
+            // sampled the same as without splits
+            const unsigned long long ksample_set = region.tile_index +
+                                                   static_cast<unsigned long long>(pass) *
+                                                   film.num_tiles();
+            const unsigned long long kseed = kdefault_rng_seed +
+                                             2ULL * 0x9E3779B97F4A7C15ULL * ksample_set +
+                                             2ULL * 0xD1B54A32D192ED03ULL * region.split;
+            stratified_sampler.reseed(kseed);
+            pintegrator_sampler->reseed(kseed);
+            // Where the path tracer's constructor leaves a new sampler
+            pintegrator_sampler->start_pixel();
+            tile.reset(region.x_min, region.y_min, region.x_max, region.y_max);
+
+            std::uint64_t camera_rays = 0;
+            for (unsigned h = tile.get_y_min(); h != tile.get_y_max(); ++h) {
+              for (unsigned w = tile.get_x_min(); w != tile.get_x_max(); ++w) {
+                const std::uint64_t kcost_start = pcost_map ? cost_clock(pcost_map->get_metric())
+                                                            : 0;
+                stratified_sampler.start_pixel();
+
+                do {
+                  Ray ray;
+                  {
+                    Scoped_render_phase sampling_phase(ksampling_phase);
+                    const Vec2 k2D_sample = stratified_sampler.get_2D();
+                    const Vec2 k2D_filtered_sample = pfilter(k2D_sample);
+
+                    camera_sample.raster_coord = Vec2(w + k2D_filtered_sample.x,
+                                                      h + (1.0f - k2D_filtered_sample.y));
+                    camera_sample.lens_coord = stratified_sampler.get_2D();
+                    camera_sample.time = stratified_sampler.get_1D();
+
+                    ray = kcamera.generate_ray(camera_sample);
+                  }
+                  ++camera_rays;
+
+                  tile.add_sample(w, h, clamp_sample(path_tracer.li(scene, ray, &arena),
+                                                     settings.max_sample_value),
+                                  kinv_samples_per_pixel);
+                  arena.reset();
+                } while (stratified_sampler.start_next_sample());
+
+                if (pcost_map) {
+                  pcost_map->add(w, h, static_cast<float>(cost_clock(pcost_map->get_metric()) -
+                                                          kcost_start));
+                }
+              }
+            }
+            add_render_count(kcamera_rays, camera_rays);
+            // Counted before the region's trace event is recorded, which allocates with
+            // --trace, and before merging, which may allocate the bands of a streamed film
+            add_render_count(kregion_loop_allocations,
+                             thread_allocations() - kregion_allocations_start);
+            pfilm_stream->merge_region(tile);
+
+            const unsigned kregions_done = pfilm_stream->regions_done();
+            TRACE_COUNTER("regions done", kregions_done);
+            if (progress) progress(kregions_done);
+          }
+
+          add_render_count(kallocations, thread_allocations() - kallocations_start);
+          const Render_stats & kthread_stats = finish_thread_render_stats();
+          if (pstats) {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            *pstats += kthread_stats;
+          }
+        }, knum_threads);
+  }
+
+  std::vector<unsigned> plan_tile_splits(const Scene & scene, const Render_settings & settings,
+                                         const unsigned tile_size)
+  {
+    TRACE_SCOPE("tile split planning");
+    Render_settings pilot_settings = settings;
+    pilot_settings.width = (settings.width + kpilot_scale - 1) / kpilot_scale;
+    pilot_settings.height = (settings.height + kpilot_scale - 1) / kpilot_scale;
+    pilot_settings.samples_x = 1;
+    pilot_settings.samples_y = 1;
+
+    // Pilot tiles cover the same pixels as the tiles of the full resolution film
+    Film pilot_film(pilot_settings.width, pilot_settings.height, tile_size / kpilot_scale);
+    Film_stream pilot_stream(&pilot_film, std::vector<std::unique_ptr<Image_stream>>());
+    Cost_map cost_map(pilot_settings.width, pilot_settings.height, Cost_metric::ktraversal_steps);
+    render(scene, pilot_settings, &pilot_stream, 0, Render_progress(), nullptr, &cost_map);
+
+    const unsigned knum_threads = settings.num_threads ? settings.num_threads
+                                                       : num_system_cores();
+    return adaptive_tile_splits(cost_map.tile_costs(tile_size / kpilot_scale), tile_size,
+                                knum_threads);
+  }
+}
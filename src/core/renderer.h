@@ -0,0 +1,30 @@
+#ifndef LUX_CORE_RENDERER_H_
+#define LUX_CORE_RENDERER_H_
+
+#include <vector>
+#include <functional>
+
+namespace lux { class Scene; class Film_stream; struct Render_settings; struct Render_stats;
+                 class Cost_map; }
+
+namespace lux {
+  // Called after each region with the number of regions done, from the render threads
+  using Render_progress = std::function<void(unsigned)>;
+
+  // Path traces every region pfilm_stream hands out on settings.num_threads threads. The
+  // samplers are seeded from the tile, split and pass, so the image doesn't depend on which
+  // thread renders a region, and films rendered with different passes hold independent
+  // samples that can be averaged. Pass 0 is what lux renders. The render threads' stats
+  // are summed into pstats and the cost of each pixel is added to pcost_map, if given.
+  void render(const Scene & scene, const Render_settings & settings, Film_stream * pfilm_stream,
+              const unsigned pass = 0, const Render_progress & progress = Render_progress(),
+              Render_stats * pstats = nullptr, Cost_map * pcost_map = nullptr);
+
+  // Tile splits for Film_stream, see adaptive_tile_splits. The cost of each tile is
+  // predicted by the traversal steps of a one sample per pixel render at a quarter of the
+  // resolution, which takes about 1 / 16 of the time of a sample per pixel.
+  std::vector<unsigned> plan_tile_splits(const Scene & scene, const Render_settings & settings,
+                                         const unsigned tile_size);
+}
+
+#endif
@@ -0,0 +1,52 @@
+#include "core/resource_usage.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cstddef>
+
+#include <fstream>
+#include <iostream>
+
+namespace lux {
+  Resource_usage get_resource_usage()
+  {
+    Resource_usage usage;
+
+    struct rusage self_usage;
+    if (::getrusage(RUSAGE_SELF, &self_usage) == 0) {
+      usage.minor_page_faults = self_usage.ru_minflt;
+      usage.major_page_faults = self_usage.ru_majflt;
+      usage.peak_resident_bytes = static_cast<std::size_t>(self_usage.ru_maxrss) * 1024;
+    }
+
+    // The second field of statm is the number of resident pages
+    std::ifstream statm("/proc/self/statm");
+    std::size_t total_pages = 0;
+    std::size_t resident_pages = 0;
+    if (statm >> total_pages >> resident_pages) {
+      usage.resident_bytes = resident_pages * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    }
+
+    return usage;
+  }
+
+  Resource_usage operator-(const Resource_usage & later, const Resource_usage & earlier)
+  {
+    Resource_usage usage(later);
+    usage.minor_page_faults -= earlier.minor_page_faults;
+    usage.major_page_faults -= earlier.major_page_faults;
+
+    return usage;
+  }
+
+  std::ostream & operator<<(std::ostream & os, const Resource_usage & usage)
+  {
+    const double kmib = 1024.0 * 1024.0;
+    os << usage.major_page_faults << " major and " << usage.minor_page_faults
+       << " minor page faults, " << usage.resident_bytes / kmib << " MiB resident ("
+       << usage.peak_resident_bytes / kmib << " MiB peak)";
+
+    return os;
+  }
+}
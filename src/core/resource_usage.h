@@ -0,0 +1,31 @@
+#ifndef LUX_CORE_RESOURCE_USAGE_H_
+#define LUX_CORE_RESOURCE_USAGE_H_
+
+#include <cstddef>
+
+#include <iostream>
+
+namespace lux {
+  // Process wide counters, subtract two snapshots to measure a phase like a render.
+  struct Resource_usage {
+    Resource_usage()
+        : minor_page_faults(0),
+          major_page_faults(0),
+          resident_bytes(0),
+          peak_resident_bytes(0) {}
+
+    long minor_page_faults;            // Served without I/O, e.g. pages in the page cache
+    long major_page_faults;            // Pages read from disk
+    std::size_t resident_bytes;        // Current resident set size
+    std::size_t peak_resident_bytes;
+  };
+
+  Resource_usage get_resource_usage();
+
+  // Faults that happened between the two snapshots, with the sizes of the later one.
+  Resource_usage operator-(const Resource_usage & later, const Resource_usage & earlier);
+
+  std::ostream & operator<<(std::ostream & os, const Resource_usage & usage);
+}
+
+#endif
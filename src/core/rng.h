@@ -5,9 +5,11 @@
 // a random number in the interval [0, 1).
 
 namespace lux {
+  const unsigned long long kdefault_rng_seed = 7564231ULL;
+
   class RNG final {
     public:
-      RNG(unsigned long long seed = 7564231ULL)
+      RNG(unsigned long long seed = kdefault_rng_seed)
       {
         m_seed = seed;
         m_mult = 62089911ULL;
@@ -2,6 +2,7 @@
 #define LUX_CORE_SAMPLER_H_
 
 #include <cstdint>
+#include <cstddef>
 
 #include "core/vec2.h"
 
@@ -17,6 +18,9 @@ namespace lux {
 
       virtual float get_1D() = 0;
       virtual Vec2  get_2D() = 0;
+
+      // Bytes of the tables samples are drawn from, 0 if each sample is generated when asked
+      virtual std::size_t table_bytes() const { return 0; }
     protected:
       std::uint64_t get_current_pixel_sample_index() const;
       const std::uint64_t m_samples_per_pixel;
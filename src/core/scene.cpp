@@ -2,11 +2,19 @@
 
 #include <vector>
 #include <memory>
+#include <utility>
 
 #include "core/ray.h"
 #include "core/shape.h"
+#include "core/error.h"
+#include "core/render_stats.h"
+#include "accelerators/bvh.h"
 
 namespace lux {
+  Scene::Scene() : m_shapes(), m_lights(), m_paccelerator() {}
+
+  Scene::~Scene() = default;
+
   void Scene::add_shape(std::shared_ptr<Shape> pshape)
   {
     m_shapes.push_back(pshape);
@@ -15,27 +23,51 @@ namespace lux {
     return;
   }
 
+  void Scene::finalize(const BVH_build_options & options)
+  {
+    m_paccelerator.reset(new BVH(m_shapes, options));
+  }
+
+  void Scene::finalize(std::unique_ptr<BVH> paccelerator)
+  {
+    m_paccelerator = std::move(paccelerator);
+  }
+
+  bool Scene::refit()
+  {
+    ASSERT(m_paccelerator, "Scene::finalize must be called before refitting the scene");
+
+    return m_paccelerator->refit();
+  }
+
+  bool Scene::quantize_accelerator()
+  {
+    ASSERT(m_paccelerator, "Scene::finalize must be called before quantizing the BVH");
+
+    return m_paccelerator->quantize();
+  }
+
   bool Scene::intersect(const Ray & ray, Surface_interaction * psurface_interaction) const
   {
+    ASSERT(m_paccelerator, "Scene::finalize must be called before intersecting the scene");
+
+    Scoped_render_phase intersect_phase(kintersect_phase);
+
     float hit_parameter = 0.0f;
-    std::vector<std::shared_ptr<Shape>>::const_iterator iter = m_shapes.cbegin();
-    for(; iter != m_shapes.cend(); ++iter) {
-      if ((*iter)->intersect(ray, &hit_parameter, psurface_interaction)) {
-        ray.set_t_max(hit_parameter);
-      }
-    }
-    return (hit_parameter > 0.0f) ? true : false;
+    if (!m_paccelerator->intersect(ray, &hit_parameter, psurface_interaction)) return false;
+
+    psurface_interaction -> time = ray.get_time();
+
+    return true;
   }
 
   bool Scene::intersect_p(const Ray & ray) const
   {
-    std::vector<std::shared_ptr<Shape>>::const_iterator iter = m_shapes.cbegin();
-    for(; iter != m_shapes.cend(); ++iter) {
-      if ((*iter)->intersect_p(ray)) {
-        return true;
-      }
-    }
-    return false;
+    ASSERT(m_paccelerator, "Scene::finalize must be called before intersecting the scene");
+
+    Scoped_render_phase intersect_phase(kintersect_phase);
+
+    return m_paccelerator->intersect_p(ray);
   }
 
 }
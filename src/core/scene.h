@@ -4,22 +4,39 @@
 #include <vector>
 #include <memory>
 
+#include "accelerators/bvh.h"
+
 namespace lux { class Ray; struct Surface_interaction; class Shape; }
 
 namespace lux {
   class Scene final {
     public:
-      Scene() = default;
+      Scene();
       Scene(const Scene &) = delete;
 
-      ~Scene() = default;
+      ~Scene();
 
       Scene & operator=(const Scene &) = delete;
 
       void add_shape(std::shared_ptr<Shape> pshape);
 
+      // Builds the top level BVH over the added shapes, must be called before the
+      // scene is intersected.
+      void finalize(const BVH_build_options & options = BVH_build_options());
+
+      // Uses a BVH built beforehand over the added shapes, e.g. loaded from a scene cache.
+      void finalize(std::unique_ptr<BVH> paccelerator);
+
+      // Updates the BVH bounds after shapes were moved, without rebuilding it. Returns false
+      // if the BVH is quantized, the scene has to be finalized again then.
+      bool refit();
+
+      // Quantizes the nodes of a BVH built with full precision ones, see BVH::quantize.
+      bool quantize_accelerator();
+
       const std::vector<std::shared_ptr<Shape>> & get_shapes() const { return m_shapes; }
       const std::vector<std::shared_ptr<Shape>> & get_lights() const { return m_lights; }
+      const BVH * get_accelerator() const { return m_paccelerator.get(); }
 
       bool intersect(const Ray & ray, Surface_interaction * psurface_interaction) const;
       bool intersect_p(const Ray & ray) const;
@@ -27,6 +44,7 @@ namespace lux {
     private:
       std::vector<std::shared_ptr<Shape>> m_shapes;
       std::vector<std::shared_ptr<Shape>> m_lights;
+      std::unique_ptr<BVH> m_paccelerator;
   };
 }
 
@@ -0,0 +1,496 @@
+#include "core/scene_cache.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+#include <utility>
+#include <limits>
+
+#include "core/scene.h"
+#include "core/shape.h"
+#include "core/material.h"
+#include "core/mat4.h"
+#include "core/vec3.h"
+#include "core/bounds3.h"
+#include "core/transform.h"
+#include "core/rgb_spectrum.h"
+#include "core/mapped_file.h"
+#include "core/trace.h"
+#include "accelerators/bvh.h"
+#include "materials/lambertian.h"
+#include "materials/mirror.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+#include "shapes/triangle_mesh.h"
+
+namespace lux {
+  namespace {
+    const char kmagic[8] = { 'L', 'U', 'X', 'S', 'C', 'E', 'N', 'E' };
+
+    // Bumped whenever the layout of the records or the hashed input changes
+    const std::uint32_t kversion = 5;
+
+    enum Cached_material { klambertian, kmirror };
+    enum Cached_shape { ksphere, ktriangle, kworld_space_sphere, kmesh };
+
+    // The file holds the header followed by the material records, the shape records, the
+    // mesh records, the node records, the leaf references, which index the shape records,
+    // and the positions and indices of the meshes. Fields are ordered by size, so none of
+    // the records has padding, and every array is 4 byte aligned, so meshes use theirs
+    // straight from the mapped file.
+    struct Header {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t num_materials;
+      std::uint64_t hash;
+      std::uint64_t num_shapes;
+      std::uint64_t num_meshes;
+      std::uint64_t num_nodes;
+      std::uint64_t num_leaf_refs;
+      std::uint64_t num_mesh_vertices;
+      std::uint64_t num_mesh_triangles;
+    };
+
+    struct Material_record {
+      std::uint32_t type;
+      float reflectance[3];
+    };
+
+    struct Shape_record {
+      std::uint32_t type;
+      std::uint32_t material;
+      float emitted_radiance[3];
+      float object_to_world[16];
+      float world_to_object[16];
+      float params[9];            // Radius and World Space center of spheres, vertices of triangles
+    };
+
+    // Arrays of a mesh, one per mesh shape record in the same order
+    struct Mesh_record {
+      std::uint64_t first_vertex;
+      std::uint64_t num_vertices;
+      std::uint64_t first_triangle;
+      std::uint64_t num_triangles;
+    };
+
+    // BVH_node isn't trivially copyable, its bounds are copied field by field
+    struct Node_record {
+      float bounds[6];
+      std::uint32_t offset;       // Shapes offset of leaves, second child offset otherwise
+      std::uint16_t num_shapes;
+      std::uint8_t axis;
+      std::uint8_t pad;
+    };
+
+    Node_record make_node_record(const BVH_node & node)
+    {
+      Node_record record;
+      for (unsigned c = 0; c != 3; ++c) {
+        record.bounds[c] = node.bounds.p_min[c];
+        record.bounds[3 + c] = node.bounds.p_max[c];
+      }
+      record.offset = node.shapes_offset;
+      record.num_shapes = node.num_shapes;
+      record.axis = node.axis;
+      record.pad = 0;
+
+      return record;
+    }
+
+    BVH_node make_node(const Node_record & record)
+    {
+      BVH_node node;
+      node.bounds = Bounds3(Vec3(record.bounds[0], record.bounds[1], record.bounds[2]),
+                            Vec3(record.bounds[3], record.bounds[4], record.bounds[5]));
+      node.shapes_offset = record.offset;
+      node.num_shapes = record.num_shapes;
+      node.axis = record.axis;
+      node.pad = 0;
+
+      return node;
+    }
+
+    void copy_matrix(const Mat4 & m, float * pdst)
+    {
+      for (unsigned r = 0; r != 4; ++r) {
+        for (unsigned c = 0; c != 4; ++c) pdst[r * 4 + c] = m(r, c);
+      }
+    }
+
+    Mat4 make_matrix(const float * psrc)
+    {
+      return Mat4(psrc[0], psrc[1], psrc[2], psrc[3], psrc[4], psrc[5], psrc[6], psrc[7],
+                  psrc[8], psrc[9], psrc[10], psrc[11], psrc[12], psrc[13], psrc[14], psrc[15]);
+    }
+
+    // Returns false if a shape or material can't be cached. Shape records follow the
+    // order of scene.get_shapes(), pmeshes gets the meshes among them.
+    bool make_records(const Scene & scene, std::vector<Material_record> * pmaterials,
+                      std::vector<Shape_record> * pshapes,
+                      std::vector<const Triangle_mesh *> * pmeshes)
+    {
+      const std::vector<std::shared_ptr<Shape>> & shapes = scene.get_shapes();
+      std::unordered_map<const Material *, std::uint32_t> material_indices;
+
+      pshapes->reserve(shapes.size());
+      for (std::size_t i = 0; i != shapes.size(); ++i) {
+        const Shape & shape = *shapes[i];
+        Shape_record record;
+        std::memset(&record, 0, sizeof(record));
+
+        const Material * pmaterial = shape.get_material().get();
+        if (!pmaterial) return false;
+
+        auto material_index = material_indices.find(pmaterial);
+        if (material_index == material_indices.end()) {
+          Material_record material_record;
+          RGB_spectrum reflectance;
+          if (const Lambertian * plambertian = dynamic_cast<const Lambertian *>(pmaterial)) {
+            material_record.type = Cached_material::klambertian;
+            reflectance = plambertian->get_reflectance();
+          }
+          else if (const Mirror * pmirror = dynamic_cast<const Mirror *>(pmaterial)) {
+            material_record.type = Cached_material::kmirror;
+            reflectance = pmirror->get_reflectance();
+          }
+          else {
+            return false;
+          }
+
+          for (unsigned c = 0; c != 3; ++c) material_record.reflectance[c] = reflectance[c];
+          material_index = material_indices.insert(
+              std::make_pair(pmaterial, static_cast<std::uint32_t>(pmaterials->size()))).first;
+          pmaterials->push_back(material_record);
+        }
+        record.material = material_index->second;
+
+        for (unsigned c = 0; c != 3; ++c) record.emitted_radiance[c] = shape.get_le()[c];
+        copy_matrix(shape.get_object_to_world().get_matrix(), record.object_to_world);
+        copy_matrix(shape.get_object_to_world().get_inverse_matrix(), record.world_to_object);
+
+        if (const Sphere * psphere = dynamic_cast<const Sphere *>(&shape)) {
+          record.type = psphere->is_world_space() ? Cached_shape::kworld_space_sphere :
+                                                    Cached_shape::ksphere;
+          record.params[0] = psphere->get_radius();
+          for (unsigned c = 0; c != 3; ++c) record.params[1 + c] = psphere->get_world_center()[c];
+        }
+        else if (const Triangle * ptriangle = dynamic_cast<const Triangle *>(&shape)) {
+          record.type = Cached_shape::ktriangle;
+          for (unsigned v = 0; v != 3; ++v) {
+            for (unsigned c = 0; c != 3; ++c) record.params[v * 3 + c] = (*ptriangle)[v][c];
+          }
+        }
+        else if (const Triangle_mesh * pmesh = dynamic_cast<const Triangle_mesh *>(&shape)) {
+          record.type = Cached_shape::kmesh;
+          pmeshes->push_back(pmesh);
+        }
+        else {
+          return false;
+        }
+
+        pshapes->push_back(record);
+      }
+
+      return true;
+    }
+
+    // 64 bit FNV-1a
+    void hash_bytes(const void * pdata, const std::size_t size, std::uint64_t * phash)
+    {
+      const unsigned char * pbytes = static_cast<const unsigned char *>(pdata);
+      for (std::size_t i = 0; i != size; ++i) {
+        *phash ^= pbytes[i];
+        *phash *= 0x100000001b3ull;
+      }
+    }
+
+    template <typename T>
+    const unsigned char * read_array(const unsigned char * psrc, const std::size_t count,
+                                     std::vector<T> * pdst)
+    {
+      pdst->resize(count);
+      if (count) std::memcpy(&(*pdst)[0], psrc, count * sizeof(T));
+
+      return psrc + count * sizeof(T);
+    }
+
+    template <typename T>
+    void write_array(std::ofstream & file, const std::vector<T> & array)
+    {
+      if (array.empty()) return;
+      file.write(reinterpret_cast<const char *>(&array[0]), array.size() * sizeof(T));
+    }
+  }
+
+  std::uint64_t scene_input_hash(const std::string & input,
+                                 const std::vector<std::string> & files,
+                                 const BVH_build_options & options)
+  {
+    TRACE_SCOPE("scene cache hash");
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    hash_bytes(&kversion, sizeof(kversion), &hash);
+    hash_bytes(input.data(), input.size() + 1, &hash);
+    for (const std::string & kpath : files) {
+      const Mapped_file kfile(kpath);
+      if (!kfile.is_open()) return 0;
+
+      const std::uint64_t ksize = kfile.size();
+      hash_bytes(&ksize, sizeof(ksize), &hash);
+      hash_bytes(kfile.data(), kfile.size(), &hash);
+    }
+
+    // Options that change the tree. Quantization is applied when the cache is loaded.
+    const std::uint32_t kbuilder = options.builder;
+    hash_bytes(&kbuilder, sizeof(kbuilder), &hash);
+    hash_bytes(&options.max_shapes_in_node, sizeof(options.max_shapes_in_node), &hash);
+    hash_bytes(&options.max_reference_growth, sizeof(options.max_reference_growth), &hash);
+    hash_bytes(&options.min_split_overlap, sizeof(options.min_split_overlap), &hash);
+
+    // 0 is kept for scenes that can't be cached
+    return hash ? hash : 1;
+  }
+
+  std::string scene_cache_path(const std::string & directory, const std::uint64_t hash)
+  {
+    std::ostringstream path;
+    path << directory << "/lux_scene_" << std::hex << std::setw(16) << std::setfill('0')
+         << hash << ".cache";
+
+    return path.str();
+  }
+
+  bool save_scene_cache(const std::string & path, const std::uint64_t hash, const Scene & scene)
+  {
+    TRACE_SCOPE("scene cache save");
+    // Quantized trees no longer hold the full precision nodes
+    const BVH * paccelerator = scene.get_accelerator();
+    if (!paccelerator || paccelerator->get_nodes().empty()) return false;
+
+    std::vector<Material_record> materials;
+    std::vector<Shape_record> shapes;
+    std::vector<const Triangle_mesh *> scene_meshes;
+    if (!make_records(scene, &materials, &shapes, &scene_meshes)) return false;
+
+    std::vector<Mesh_record> meshes;
+    meshes.reserve(scene_meshes.size());
+    std::uint64_t num_mesh_vertices = 0;
+    std::uint64_t num_mesh_triangles = 0;
+    for (const Triangle_mesh * kpmesh : scene_meshes) {
+      const Mesh_record krecord = { num_mesh_vertices, kpmesh->num_vertices(), num_mesh_triangles,
+                                    kpmesh->num_triangles() };
+      meshes.push_back(krecord);
+      num_mesh_vertices += kpmesh->num_vertices();
+      num_mesh_triangles += kpmesh->num_triangles();
+    }
+
+    // The tree is built over the scene's shapes, so the leaf references index the records
+    if (paccelerator->get_shapes() != scene.get_shapes()) return false;
+    const std::vector<BVH_primitive> & leaf_refs = paccelerator->get_primitives();
+
+    const std::vector<BVH_node> & scene_nodes = paccelerator->get_nodes();
+    std::vector<Node_record> nodes;
+    nodes.reserve(scene_nodes.size());
+    for (const BVH_node & knode : scene_nodes) nodes.push_back(make_node_record(knode));
+
+    Header header;
+    std::memcpy(header.magic, kmagic, sizeof(kmagic));
+    header.version = kversion;
+    header.num_materials = materials.size();
+    header.hash = hash;
+    header.num_shapes = shapes.size();
+    header.num_meshes = meshes.size();
+    header.num_nodes = nodes.size();
+    header.num_leaf_refs = leaf_refs.size();
+    header.num_mesh_vertices = num_mesh_vertices;
+    header.num_mesh_triangles = num_mesh_triangles;
+
+    // Written aside and renamed, so a reader never maps a partially written cache
+    const std::string kpartial_path = path + ".partial";
+    std::ofstream file(kpartial_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    write_array(file, materials);
+    write_array(file, shapes);
+    write_array(file, meshes);
+    write_array(file, nodes);
+    write_array(file, leaf_refs);
+    for (const Triangle_mesh * kpmesh : scene_meshes) {
+      file.write(reinterpret_cast<const char *>(kpmesh->get_positions()),
+                 kpmesh->num_vertices() * 3 * sizeof(float));
+    }
+    for (const Triangle_mesh * kpmesh : scene_meshes) {
+      file.write(reinterpret_cast<const char *>(kpmesh->get_indices()),
+                 kpmesh->num_triangles() * 3 * sizeof(std::uint32_t));
+    }
+    file.close();
+
+    if (!file) {
+      std::remove(kpartial_path.c_str());
+      return false;
+    }
+
+    return std::rename(kpartial_path.c_str(), path.c_str()) == 0;
+  }
+
+  bool load_scene_cache(const std::string & path, const std::uint64_t hash,
+                        const BVH_build_options & options, Scene * pscene)
+  {
+    TRACE_SCOPE("scene cache load");
+    if (!pscene->get_shapes().empty()) return false;
+
+    // Meshes keep the file mapped and use their arrays in place
+    const std::shared_ptr<const Mapped_file> pfile = std::make_shared<const Mapped_file>(path);
+    if (!pfile->is_open() || pfile->size() < sizeof(Header)) return false;
+
+    Header header;
+    std::memcpy(&header, pfile->data(), sizeof(header));
+    if (std::memcmp(header.magic, kmagic, sizeof(kmagic)) != 0 ||
+        header.version != kversion || header.hash != hash) {
+      return false;
+    }
+
+    // Checked one array at a time, so corrupt counts can't overflow the expected size
+    std::size_t remaining = pfile->size() - sizeof(header);
+    const std::uint64_t kcounts[7] = { header.num_materials, header.num_shapes,
+                                       header.num_meshes, header.num_nodes,
+                                       header.num_leaf_refs, header.num_mesh_vertices,
+                                       header.num_mesh_triangles };
+    const std::size_t ksizes[7] = { sizeof(Material_record), sizeof(Shape_record),
+                                    sizeof(Mesh_record), sizeof(Node_record),
+                                    sizeof(BVH_primitive), 3 * sizeof(float),
+                                    3 * sizeof(std::uint32_t) };
+    for (unsigned i = 0; i != 7; ++i) {
+      if (kcounts[i] > remaining / ksizes[i]) return false;
+      remaining -= kcounts[i] * ksizes[i];
+    }
+    if (remaining != 0 || header.num_nodes == 0) return false;
+
+    std::vector<Material_record> materials;
+    std::vector<Shape_record> shapes;
+    std::vector<Mesh_record> meshes;
+    std::vector<Node_record> node_records;
+    std::vector<BVH_primitive> leaf_refs;
+    const unsigned char * pdata = pfile->data() + sizeof(header);
+    pdata = read_array(pdata, header.num_materials, &materials);
+    pdata = read_array(pdata, header.num_shapes, &shapes);
+    pdata = read_array(pdata, header.num_meshes, &meshes);
+    pdata = read_array(pdata, header.num_nodes, &node_records);
+    pdata = read_array(pdata, header.num_leaf_refs, &leaf_refs);
+    const float * pmesh_positions = reinterpret_cast<const float *>(pdata);
+    const std::uint32_t * pmesh_indices = reinterpret_cast<const std::uint32_t *>(
+        pdata + header.num_mesh_vertices * 3 * sizeof(float));
+
+    std::vector<BVH_node> nodes;
+    nodes.reserve(node_records.size());
+    for (const Node_record & krecord : node_records) nodes.push_back(make_node(krecord));
+
+    // Nodes are in depth first order, so both children of an interior node follow it and
+    // a damaged tree can't loop back to an ancestor
+    for (std::size_t i = 0; i != nodes.size(); ++i) {
+      const BVH_node & node = nodes[i];
+      const bool kvalid = (node.num_shapes > 0) ?
+          node.shapes_offset + static_cast<std::uint64_t>(node.num_shapes) <= leaf_refs.size() :
+          node.second_child_offset > i + 1 && node.second_child_offset < nodes.size();
+      if (!kvalid) return false;
+    }
+
+    for (const Mesh_record & krecord : meshes) {
+      if (krecord.first_vertex > header.num_mesh_vertices ||
+          krecord.num_vertices > header.num_mesh_vertices - krecord.first_vertex ||
+          krecord.first_triangle > header.num_mesh_triangles ||
+          krecord.num_triangles > header.num_mesh_triangles - krecord.first_triangle ||
+          krecord.num_triangles > std::numeric_limits<std::uint32_t>::max() ||
+          !mesh_indices_valid(pmesh_indices + 3 * krecord.first_triangle, krecord.num_triangles,
+                              krecord.num_vertices, options.num_threads)) {
+        return false;
+      }
+    }
+
+    // Primitives of each shape, to check the leaf references against
+    std::vector<std::uint64_t> num_primitives;
+    num_primitives.reserve(shapes.size());
+    std::size_t num_mesh_shapes = 0;
+    for (const Shape_record & krecord : shapes) {
+      if (krecord.type > Cached_shape::kmesh || krecord.material >= materials.size()) {
+        return false;
+      }
+      if (krecord.type != Cached_shape::kmesh) {
+        num_primitives.push_back(1);
+      }
+      else {
+        if (num_mesh_shapes == meshes.size()) return false;
+        num_primitives.push_back(meshes[num_mesh_shapes++].num_triangles);
+      }
+    }
+    if (num_mesh_shapes != meshes.size()) return false;
+    for (const BVH_primitive & kleaf_ref : leaf_refs) {
+      if (kleaf_ref.shape >= shapes.size() ||
+          kleaf_ref.primitive >= num_primitives[kleaf_ref.shape]) {
+        return false;
+      }
+    }
+
+    std::vector<std::shared_ptr<Material>> scene_materials;
+    scene_materials.reserve(materials.size());
+    for (std::size_t i = 0; i != materials.size(); ++i) {
+      const float * pr = materials[i].reflectance;
+      const RGB_spectrum kreflectance(pr[0], pr[1], pr[2]);
+      if (materials[i].type == Cached_material::klambertian) {
+        scene_materials.push_back(std::make_shared<Lambertian>(kreflectance));
+      }
+      else {
+        scene_materials.push_back(std::make_shared<Mirror>(kreflectance));
+      }
+    }
+
+    std::size_t mesh = 0;
+    for (std::size_t i = 0; i != shapes.size(); ++i) {
+      const Shape_record & record = shapes[i];
+      const Transform kobject_to_world(make_matrix(record.object_to_world),
+                                       make_matrix(record.world_to_object));
+      const RGB_spectrum kemitted_radiance(record.emitted_radiance[0],
+                                           record.emitted_radiance[1],
+                                           record.emitted_radiance[2]);
+      const float * pp = record.params;
+      if (record.type == Cached_shape::ksphere) {
+        pscene->add_shape(std::make_shared<Sphere>(kobject_to_world,
+                                                   scene_materials[record.material],
+                                                   kemitted_radiance, pp[0]));
+      }
+      else if (record.type == Cached_shape::kworld_space_sphere) {
+        // The stored transform is the identity, the translation is folded back
+        pscene->add_shape(std::make_shared<Sphere>(translate(Vec3(pp[1], pp[2], pp[3])),
+                                                   scene_materials[record.material],
+                                                   kemitted_radiance, pp[0]));
+      }
+      else if (record.type == Cached_shape::ktriangle) {
+        pscene->add_shape(std::make_shared<Triangle>(kobject_to_world,
+                                                     scene_materials[record.material],
+                                                     kemitted_radiance,
+                                                     Vec3(pp[0], pp[1], pp[2]),
+                                                     Vec3(pp[3], pp[4], pp[5]),
+                                                     Vec3(pp[6], pp[7], pp[8])));
+      }
+      else {
+        const Mesh_record & kmesh = meshes[mesh++];
+        pscene->add_shape(std::make_shared<Triangle_mesh>(
+            kobject_to_world, scene_materials[record.material], kemitted_radiance, pfile,
+            pmesh_positions + 3 * kmesh.first_vertex, kmesh.num_vertices,
+            pmesh_indices + 3 * kmesh.first_triangle, kmesh.num_triangles));
+      }
+    }
+
+    pscene->finalize(std::unique_ptr<BVH>(new BVH(pscene->get_shapes(), std::move(leaf_refs),
+                                                  std::move(nodes), options)));
+
+    return true;
+  }
+}
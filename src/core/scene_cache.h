@@ -0,0 +1,43 @@
+#ifndef LUX_CORE_SCENE_CACHE_H_
+#define LUX_CORE_SCENE_CACHE_H_
+
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+namespace lux { class Scene; struct BVH_build_options; }
+
+namespace lux {
+  // A scene cache is a binary snapshot of a finalized scene: its materials, shapes and
+  // lights, the arrays of its meshes and its flattened BVH. Loading memory maps the file,
+  // meshes use their arrays inside the mapping and the tree is adopted as is, so a scene
+  // that was rendered before starts without loading its meshes or running the BVH builder.
+  //
+  // Caches are keyed by a hash of the scene's input, computed before anything is built,
+  // and of the BVH options. That excludes the camera and the sampling settings. Spheres,
+  // triangles and meshes with Lambertian or mirror materials can be cached, instances
+  // can't. The tree is stored with full precision nodes and quantized when it's loaded
+  // if the options ask for it.
+
+  // Hashes input, what the shapes are built from, e.g. the name and count of a generated
+  // scene or the shape statements of a scene file, the bytes of files, e.g. the meshes of
+  // a scene file, and the BVH options. Returns 0 if one of the files can't be read.
+  std::uint64_t scene_input_hash(const std::string & input,
+                                 const std::vector<std::string> & files,
+                                 const BVH_build_options & options);
+
+  // Name of the cache file for the given hash inside directory.
+  std::string scene_cache_path(const std::string & directory, const std::uint64_t hash);
+
+  // Writes the finalized scene, returns false if it can't be cached or written, which
+  // includes scenes whose BVH was quantized, see BVH::quantize.
+  bool save_scene_cache(const std::string & path, const std::uint64_t hash, const Scene & scene);
+
+  // Adds the cached shapes to pscene, which must be empty, and finalizes it if the cache
+  // at path exists and was saved with the same hash.
+  bool load_scene_cache(const std::string & path, const std::uint64_t hash,
+                        const BVH_build_options & options, Scene * pscene);
+}
+
+#endif
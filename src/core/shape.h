@@ -1,13 +1,17 @@
 #ifndef LUX_CORE_SHAPE_H_
 #define LUX_CORE_SHAPE_H_
 
+#include <cstdint>
+
 #include <memory>
 
 #include "core/vec3.h"
 #include "core/transform.h"
+#include "core/bounds3.h"
 #include "core/rgb_spectrum.h"
+#include "core/shape_tables.h"
 
-namespace lux { struct Vec2; class Ray; class Material; }
+namespace lux { struct Vec2; class Ray; class Material; class Memory_stats; }
 
 //TODO: on le pass only the normal of the point, don't need to pass an interaction!
 namespace lux {
@@ -19,34 +23,51 @@ namespace lux {
     Vec3 n, t, s;
     std::shared_ptr<Material> pmaterial;
     const Shape *pshape;
+    float time;
   };
 
+  // The transform, material and emitted radiance are indices into the shape tables, see
+  // core/shape_tables.h, so a shape only adds its geometry to these few bytes.
   class Shape {
     public:
-      Shape(const Transform & object_to_world, std::shared_ptr<Material> pmaterial,
+      Shape(const Transform & object_to_world, const std::shared_ptr<Material> & pmaterial,
             const RGB_spectrum & emitted_radiance)
-        : m_object_to_world(object_to_world), 
-          m_pmaterial(pmaterial),
-          m_emitted_radiance(emitted_radiance) {}
+        : m_transform_index(add_shape_transform(object_to_world)),
+          m_material_index(add_shape_material(pmaterial)),
+          m_emission_index(add_shape_emission(emitted_radiance)) {}
+
+      // Shapes that share their values, like the triangles of a mesh, add them once
+      Shape(const std::uint32_t transform_index, const std::uint32_t material_index,
+            const std::uint32_t emission_index)
+        : m_transform_index(transform_index),
+          m_material_index(material_index),
+          m_emission_index(emission_index) {}
 
-      Shape(const Shape & shape)
-         : m_object_to_world(shape.m_object_to_world),
-           m_pmaterial(shape.m_pmaterial),
-           m_emitted_radiance(shape.m_emitted_radiance) {}
+      Shape(const Shape & shape) = default;
 
       virtual ~Shape() = default;
       
-      Shape & operator=(const Shape & shape)
-      {
-        m_object_to_world = shape.m_object_to_world;
-        m_pmaterial = shape.m_pmaterial;
-        m_emitted_radiance = shape.m_emitted_radiance;
+      Shape & operator=(const Shape & shape) = default;
 
-        return *this;
+      const Transform & get_object_to_world() const { return shape_transform(m_transform_index); }
+      const std::shared_ptr<Material> & get_material() const
+      {
+        return shape_material(m_material_index);
       }
 
-      const Transform & get_object_to_world() const { return m_object_to_world; }
-      const std::shared_ptr<Material> get_material() const { return m_pmaterial; }
+      std::uint32_t get_transform_index() const { return m_transform_index; }
+      std::uint32_t get_material_index() const { return m_material_index; }
+      std::uint32_t get_emission_index() const { return m_emission_index; }
+
+      // Bounds the shape over every instant the shape can be intersected at.
+      virtual Bounds3 world_bound() const = 0;
+
+      // Bounds the part of the shape inside box. Used by spatial splits, shapes that can
+      // compute tighter bounds than the box's overlap with world_bound() override it.
+      virtual Bounds3 clipped_world_bound(const Bounds3 & box) const
+      {
+        return bounds_intersect(world_bound(), box);
+      }
 
       virtual RGB_spectrum sample_li(const Surface_interaction & interaction,
                                      const Vec2 & u_sample, Vec3 * pwi_world,
@@ -62,19 +83,49 @@ namespace lux {
         return intersect(ray, nullptr, nullptr);
       }
 
+      // Shapes made of many primitives, like the triangles of a mesh, are built into the
+      // BVH one primitive at a time, so no object is needed per primitive. Shapes of a
+      // single primitive keep these defaults, which forward to the whole shape.
+      virtual std::uint32_t num_primitives() const { return 1; }
+
+      virtual Bounds3 primitive_world_bound(const std::uint32_t primitive) const
+      {
+        return world_bound();
+      }
+
+      virtual Bounds3 clipped_primitive_bound(const std::uint32_t primitive,
+                                              const Bounds3 & box) const
+      {
+        return clipped_world_bound(box);
+      }
+
+      virtual bool intersect_primitive(const Ray & ray, const std::uint32_t primitive,
+                                       float * phit,
+                                       Surface_interaction * psurface_interaction) const
+      {
+        return intersect(ray, phit, psurface_interaction);
+      }
+
+      virtual bool intersect_p_primitive(const Ray & ray, const std::uint32_t primitive) const
+      {
+        return intersect_p(ray);
+      }
+
       RGB_spectrum le(const Surface_interaction & interaction, const Vec3 & w) const
       {
-        return dot(interaction.n, w) > 0.0f  ? m_emitted_radiance : RGB_spectrum(0.0f);
+        return dot(interaction.n, w) > 0.0f  ? get_le() : RGB_spectrum(0.0f);
       }
 
-      bool is_area_light() const { return !m_emitted_radiance.is_black(); }
+      // Adds the shape's memory and what it references to pstats, see add_shape_memory
+      virtual void add_memory(Memory_stats * pstats) const = 0;
+
+      bool is_area_light() const { return !get_le().is_black(); }
+      const RGB_spectrum & get_le() const { return shape_emission(m_emission_index); }
 
-    protected:
-      const RGB_spectrum & get_le() const { return m_emitted_radiance; }
     private:
-      Transform m_object_to_world;
-      std::shared_ptr<Material> m_pmaterial;
-      RGB_spectrum m_emitted_radiance;
+      std::uint32_t m_transform_index;
+      std::uint32_t m_material_index;
+      std::uint32_t m_emission_index;
   };
 }
 #endif
@@ -0,0 +1,161 @@
+#include "core/shape_tables.h"
+
+#include <cstdint>
+#include <cstddef>
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+
+#include "core/transform.h"
+#include "core/rgb_spectrum.h"
+#include "core/mat4.h"
+#include "core/error.h"
+
+namespace lux {
+  std::unique_ptr<Transform[]> g_shape_transform_chunks[kshape_table_max_chunks];
+  std::unique_ptr<std::shared_ptr<Material>[]> g_shape_material_chunks[kshape_table_max_chunks];
+  std::unique_ptr<RGB_spectrum[]> g_shape_emission_chunks[kshape_table_max_chunks];
+
+  namespace {
+    void hash_combine(std::size_t * phash, const std::size_t value)
+    {
+      *phash ^= value + 0x9e3779b97f4a7c15ull + (*phash << 6) + (*phash >> 2);
+    }
+
+    std::size_t value_hash(const Transform & transform)
+    {
+      const Mat4 & m = transform.get_matrix();
+      std::size_t hash = 0;
+      for (unsigned r = 0; r != 4; ++r) {
+        for (unsigned c = 0; c != 4; ++c) hash_combine(&hash, std::hash<float>()(m(r, c)));
+      }
+
+      return hash;
+    }
+
+    bool same_value(const Transform & lhs, const Transform & rhs)
+    {
+      const Mat4 & lhs_m = lhs.get_matrix();
+      const Mat4 & rhs_m = rhs.get_matrix();
+      const Mat4 & lhs_inv = lhs.get_inverse_matrix();
+      const Mat4 & rhs_inv = rhs.get_inverse_matrix();
+      for (unsigned r = 0; r != 4; ++r) {
+        for (unsigned c = 0; c != 4; ++c) {
+          if (lhs_m(r, c) != rhs_m(r, c) || lhs_inv(r, c) != rhs_inv(r, c)) return false;
+        }
+      }
+
+      return lhs.get_type() == rhs.get_type();
+    }
+
+    std::size_t value_hash(const std::shared_ptr<Material> & pmaterial)
+    {
+      return std::hash<Material *>()(pmaterial.get());
+    }
+
+    bool same_value(const std::shared_ptr<Material> & lhs, const std::shared_ptr<Material> & rhs)
+    {
+      return lhs == rhs;
+    }
+
+    std::size_t value_hash(const RGB_spectrum & spectrum)
+    {
+      std::size_t hash = 0;
+      for (unsigned i = 0; i != 3; ++i) hash_combine(&hash, std::hash<float>()(spectrum[i]));
+
+      return hash;
+    }
+
+    bool same_value(const RGB_spectrum & lhs, const RGB_spectrum & rhs)
+    {
+      return lhs == rhs;
+    }
+
+    // Appends values to the chunks, looking them up by hash first. Entry 0 is the default
+    // constructed value, added along with the first value.
+    template<typename T>
+    class Shape_table final {
+      public:
+        explicit Shape_table(std::unique_ptr<T[]> (&chunks)[kshape_table_max_chunks])
+            : m_mutex(), m_chunks(chunks), m_size(0), m_indices() {}
+
+        std::uint32_t add(const T & value)
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          if (m_size == 0) append(T(), value_hash(T()));
+
+          const std::size_t khash = value_hash(value);
+          const auto krange = m_indices.equal_range(khash);
+          for (auto it = krange.first; it != krange.second; ++it) {
+            if (same_value(entry(it->second), value)) return it->second;
+          }
+
+          return append(value, khash);
+        }
+
+        void clear()
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          for (std::unique_ptr<T[]> & chunk : m_chunks) chunk.reset();
+          m_size = 0;
+          m_indices.clear();
+        }
+
+      private:
+        const T & entry(const std::uint32_t index) const
+        {
+          return m_chunks[index >> kshape_table_chunk_bits]
+                         [index & (kshape_table_chunk_size - 1)];
+        }
+
+        std::uint32_t append(const T & value, const std::size_t hash)
+        {
+          // Shapes can't be built without their entries, so this can't be reported back
+          if (m_size == kshape_table_max_chunks * kshape_table_chunk_size) {
+            throw std::length_error("Shape table is full");
+          }
+
+          const std::uint32_t kchunk = m_size >> kshape_table_chunk_bits;
+          if (!m_chunks[kchunk]) m_chunks[kchunk].reset(new T[kshape_table_chunk_size]);
+          m_chunks[kchunk][m_size & (kshape_table_chunk_size - 1)] = value;
+          m_indices.emplace(hash, m_size);
+
+          return m_size++;
+        }
+
+        std::mutex m_mutex;
+        std::unique_ptr<T[]> (&m_chunks)[kshape_table_max_chunks];
+        std::uint32_t m_size;
+        std::unordered_multimap<std::size_t, std::uint32_t> m_indices;
+    };
+
+    Shape_table<Transform> g_transforms(g_shape_transform_chunks);
+    Shape_table<std::shared_ptr<Material>> g_materials(g_shape_material_chunks);
+    Shape_table<RGB_spectrum> g_emissions(g_shape_emission_chunks);
+  }
+
+  std::uint32_t add_shape_transform(const Transform & object_to_world)
+  {
+    return g_transforms.add(object_to_world);
+  }
+
+  std::uint32_t add_shape_material(const std::shared_ptr<Material> & pmaterial)
+  {
+    return g_materials.add(pmaterial);
+  }
+
+  std::uint32_t add_shape_emission(const RGB_spectrum & emitted_radiance)
+  {
+    return g_emissions.add(emitted_radiance);
+  }
+
+  void clear_shape_tables()
+  {
+    g_transforms.clear();
+    g_materials.clear();
+    g_emissions.clear();
+  }
+}
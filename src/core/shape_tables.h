@@ -0,0 +1,61 @@
+#ifndef LUX_CORE_SHAPE_TABLES_H_
+#define LUX_CORE_SHAPE_TABLES_H_
+
+#include <cstdint>
+
+#include <memory>
+
+#include "core/transform.h"
+#include "core/rgb_spectrum.h"
+
+namespace lux { class Material; }
+
+namespace lux {
+  // Shapes don't store their transform, material and emitted radiance, they store 32 bit
+  // indices into these process wide tables. Equal values are added once, so the triangles
+  // of a mesh, or every shape with the identity transform, share a single entry. Entries
+  // are never moved, so they are read from any thread without locking, while adding takes
+  // a lock. Adding to a full table throws std::length_error.
+
+  // Index of the identity transform, of no material and of a black emitted radiance
+  const std::uint32_t kdefault_shape_index = 0;
+
+  std::uint32_t add_shape_transform(const Transform & object_to_world);
+  std::uint32_t add_shape_material(const std::shared_ptr<Material> & pmaterial);
+  std::uint32_t add_shape_emission(const RGB_spectrum & emitted_radiance);
+
+  // Removes every entry, releasing the tables' memory and materials. No shape may be left,
+  // e.g. it's called between the scenes of a benchmark sweep.
+  void clear_shape_tables();
+
+  // The tables are arrays of fixed size chunks, so adding never moves the entries. Read
+  // through the functions below, which are called on every intersection.
+  const unsigned kshape_table_chunk_bits = 10;
+  const std::uint32_t kshape_table_chunk_size = 1u << kshape_table_chunk_bits;
+  const std::uint32_t kshape_table_max_chunks = 1u << 14;
+
+  extern std::unique_ptr<Transform[]> g_shape_transform_chunks[kshape_table_max_chunks];
+  extern std::unique_ptr<std::shared_ptr<Material>[]>
+      g_shape_material_chunks[kshape_table_max_chunks];
+  extern std::unique_ptr<RGB_spectrum[]> g_shape_emission_chunks[kshape_table_max_chunks];
+
+  inline const Transform & shape_transform(const std::uint32_t index)
+  {
+    return g_shape_transform_chunks[index >> kshape_table_chunk_bits]
+                                   [index & (kshape_table_chunk_size - 1)];
+  }
+
+  inline const std::shared_ptr<Material> & shape_material(const std::uint32_t index)
+  {
+    return g_shape_material_chunks[index >> kshape_table_chunk_bits]
+                                  [index & (kshape_table_chunk_size - 1)];
+  }
+
+  inline const RGB_spectrum & shape_emission(const std::uint32_t index)
+  {
+    return g_shape_emission_chunks[index >> kshape_table_chunk_bits]
+                                  [index & (kshape_table_chunk_size - 1)];
+  }
+}
+
+#endif
@@ -0,0 +1,121 @@
+#include "core/trace.h"
+
+#include <cstdint>
+#include <cstddef>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+namespace lux {
+  bool g_tracing = false;
+
+  namespace {
+    struct Trace_event {
+      const char * pname;
+      const char * parg_name;  // nullptr if the event has no argument
+      std::int64_t arg;        // The value of counters
+      std::int64_t begin_ns;
+      std::int64_t end_ns;     // -1 for counters
+    };
+
+    struct Thread_trace {
+      unsigned tid;
+      std::vector<Trace_event> events;
+    };
+
+    std::int64_t g_trace_start_ns = 0;
+
+    // Only taken the first time a thread records an event
+    std::mutex g_threads_mutex;
+    std::vector<std::unique_ptr<Thread_trace>> g_threads;
+
+    // Buffers outlive their threads, parallel_for starts new threads on every call
+    thread_local Thread_trace * tpthread_trace = nullptr;
+
+    Thread_trace & thread_trace()
+    {
+      if (!tpthread_trace) {
+        std::lock_guard<std::mutex> lock(g_threads_mutex);
+        g_threads.emplace_back(new Thread_trace());
+        g_threads.back()->tid = g_threads.size();
+        tpthread_trace = g_threads.back().get();
+      }
+
+      return *tpthread_trace;
+    }
+
+    std::int64_t steady_now_ns()
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Names are literals from the markers, so they aren't escaped
+    void put_event(std::ostream & os, const unsigned tid, const Trace_event & event)
+    {
+      os << "{\"name\": \"" << event.pname << "\", \"pid\": 1, \"tid\": " << tid
+         << ", \"ts\": " << event.begin_ns * 1e-3;
+      if (event.end_ns < 0) {
+        os << ", \"ph\": \"C\", \"args\": {\"value\": " << event.arg << "}}";
+        return;
+      }
+      os << ", \"ph\": \"X\", \"dur\": " << (event.end_ns - event.begin_ns) * 1e-3;
+      if (event.parg_name) {
+        os << ", \"args\": {\"" << event.parg_name << "\": " << event.arg << "}";
+      }
+      os << "}";
+    }
+  }
+
+  void enable_tracing()
+  {
+    g_trace_start_ns = steady_now_ns();
+    g_tracing = true;
+  }
+
+  std::int64_t trace_now_ns()
+  {
+    return steady_now_ns() - g_trace_start_ns;
+  }
+
+  void record_trace_slice(const char * pname, const char * parg_name, const std::int64_t arg,
+                          const std::int64_t begin_ns, const std::int64_t end_ns)
+  {
+    thread_trace().events.push_back({ pname, parg_name, arg, begin_ns, end_ns });
+  }
+
+  void trace_counter(const char * pname, const std::int64_t value)
+  {
+    if (!g_tracing) return;
+
+    thread_trace().events.push_back({ pname, nullptr, value, trace_now_ns(), -1 });
+  }
+
+  bool write_trace(const std::string & path)
+  {
+    std::ofstream file(path, std::ios::trunc);
+    file << std::fixed << std::setprecision(3)
+         << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(g_threads_mutex);
+    for (const std::unique_ptr<Thread_trace> & kpthread : g_threads) {
+      file << (first ? "\n" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+           << "\"tid\": " << kpthread->tid << ", \"args\": {\"name\": \"thread "
+           << kpthread->tid << "\"}}";
+      first = false;
+      for (const Trace_event & kevent : kpthread->events) {
+        file << ",\n";
+        put_event(file, kpthread->tid, kevent);
+      }
+    }
+    file << "\n]}\n";
+    file.close();
+
+    return static_cast<bool>(file);
+  }
+}
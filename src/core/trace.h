@@ -0,0 +1,77 @@
+#ifndef LUX_CORE_TRACE_H_
+#define LUX_CORE_TRACE_H_
+
+#include <cstdint>
+
+#include <string>
+
+// Timeline markers written as Chrome trace JSON, which chrome://tracing and Perfetto open.
+// They mark coarse phases, a tile or a band write, not rays. Building with TRACING=OFF
+// compiles them out, otherwise they record once enable_tracing is called.
+namespace lux {
+
+#if TRACING_ENABLED
+  #define TRACE_CONCAT_IMPL(a, b) a##b
+  #define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+  // Records the scope as a slice on the calling thread's track. Names must be string
+  // literals, only the pointers are kept.
+  #define TRACE_SCOPE(name) lux::Trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+  // Same, with an integer shown in the slice's arguments
+  #define TRACE_SCOPE_ARG(name, arg_name, arg) \
+    lux::Trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(name, arg_name, arg)
+
+  // Records a value of a counter track, e.g. the tiles done
+  #define TRACE_COUNTER(name, value) lux::trace_counter(name, value)
+#else
+  #define TRACE_SCOPE(name)
+  #define TRACE_SCOPE_ARG(name, arg_name, arg)
+  #define TRACE_COUNTER(name, value)
+#endif
+
+  // Set by enable_tracing, before the traced code runs
+  extern bool g_tracing;
+
+  // Starts recording, timestamps are relative to this call
+  void enable_tracing();
+
+  // Each thread records into its own buffer, this writes all of them. Call it when no
+  // traced code is running.
+  bool write_trace(const std::string & path);
+
+  void record_trace_slice(const char * pname, const char * parg_name, const std::int64_t arg,
+                          const std::int64_t begin_ns, const std::int64_t end_ns);
+
+  void trace_counter(const char * pname, const std::int64_t value);
+
+  std::int64_t trace_now_ns();
+
+  class Trace_scope final {
+    public:
+      explicit Trace_scope(const char * pname, const char * parg_name = nullptr,
+                           const std::int64_t arg = 0)
+          : m_pname(pname),
+            m_parg_name(parg_name),
+            m_arg(arg),
+            m_begin_ns(g_tracing ? trace_now_ns() : -1) {}
+
+      ~Trace_scope()
+      {
+        if (m_begin_ns >= 0) {
+          record_trace_slice(m_pname, m_parg_name, m_arg, m_begin_ns, trace_now_ns());
+        }
+      }
+
+      Trace_scope(const Trace_scope &) = delete;
+      Trace_scope & operator=(const Trace_scope &) = delete;
+
+    private:
+      const char * m_pname;
+      const char * m_parg_name;
+      std::int64_t m_arg;
+      std::int64_t m_begin_ns;
+  };
+}
+
+#endif
@@ -5,12 +5,73 @@
 #include "core/vec3.h"
 #include "core/mat4.h"
 #include "core/math.h"
+#include "core/bounds3.h"
 
 namespace lux {
   Transform::Transform(const Mat4 & mat4, const Mat4 & mat4_inv)
-      : m_mat4(mat4), m_mat4_inv(mat4_inv) {}
+      : m_mat4(mat4), m_mat4_inv(mat4_inv), m_type(classify(mat4)) {}
 
-  Transform::Transform(const Mat4 & mat4) : m_mat4(mat4), m_mat4_inv(inverse(mat4)) {}
+  Transform::Transform(const Mat4 & mat4)
+      : m_mat4(mat4), m_mat4_inv(inverse(mat4)), m_type(classify(mat4)) {}
+
+  // The inverse of a transform always falls in the same class, so only the forward matrix
+  // has to be inspected.
+  Transform_type Transform::classify(const Mat4 & mat4)
+  {
+    const float (&m)[4][4] = mat4.m;
+
+    if (m[0][3] != 0.0f || m[1][3] != 0.0f || m[2][3] != 0.0f || m[3][3] != 1.0f) {
+      return Transform_type::kprojective;
+    }
+
+    if (m[0][0] != 1.0f || m[0][1] != 0.0f || m[0][2] != 0.0f ||
+        m[1][0] != 0.0f || m[1][1] != 1.0f || m[1][2] != 0.0f ||
+        m[2][0] != 0.0f || m[2][1] != 0.0f || m[2][2] != 1.0f) {
+      return Transform_type::kaffine;
+    }
+
+    if (m[3][0] != 0.0f || m[3][1] != 0.0f || m[3][2] != 0.0f) {
+      return Transform_type::ktranslation;
+    }
+
+    return Transform_type::kidentity;
+  }
+
+  Bounds3 Transform::apply_on_bounds(const Bounds3 & b) const
+  {
+    if (m_type == Transform_type::kidentity || b.is_empty()) return b;
+
+    if (m_type == Transform_type::ktranslation) {
+      return Bounds3(apply_on_point(b.p_min), apply_on_point(b.p_max));
+    }
+
+    Bounds3 r;
+    for (unsigned i = 0; i != 8; ++i) {
+      r = bounds_union(r, apply_on_point(b.corner(i)));
+    }
+
+    return r;
+  }
+
+  bool Transform::is_translate_uniform_scale(Vec3 * pdelta, float * pscale) const
+  {
+    if (m_type == Transform_type::kprojective) return false;
+
+    const float (&m)[4][4] = m_mat4.m;
+
+    // No rotation or shear terms
+    if (m[0][1] != 0.0f || m[0][2] != 0.0f || m[1][0] != 0.0f ||
+        m[1][2] != 0.0f || m[2][0] != 0.0f || m[2][1] != 0.0f) {
+      return false;
+    }
+
+    if (m[0][0] != m[1][1] || m[0][0] != m[2][2] || m[0][0] <= 0.0f) return false;
+
+    *pdelta = Vec3(m[3][0], m[3][1], m[3][2]);
+    *pscale = m[0][0];
+
+    return true;
+  }
 
   Transform rotate_x(const float ktheta)
   {
@@ -6,14 +6,23 @@
 #include "core/mat4.h"
 #include "core/vec3.h"
 #include "core/ray.h"
+#include "core/bounds3.h"
 
 namespace lux {
+  // Classifies a transform by the most specialized code path able to apply it.
+  enum Transform_type {
+    kidentity,
+    ktranslation,
+    kaffine,
+    kprojective
+  };
+
   class Transform final {
     friend std::ostream & operator<<(std::ostream & os, const Transform & t);
     friend Transform operator*(const Transform & lhs, const Transform & rhs);
     friend Transform inverse(const Transform & t);
     public:
-      Transform() = default;
+      Transform() : m_mat4(), m_mat4_inv(), m_type(Transform_type::kidentity) {}
       Transform(const Mat4 & mat4, const Mat4 & mat4_inv);
       explicit Transform(const Mat4 & mat4);
       Transform(const Transform &) = default;
@@ -32,6 +41,16 @@ namespace lux {
       Ray  apply_on_ray(const Ray & r) const;
       Ray  apply_inverse_on_ray(const Ray & r) const;
 
+      Bounds3 apply_on_bounds(const Bounds3 & b) const;
+
+      // Returns true if the transform is a translation combined with a positive uniform
+      // scale, storing the translation on pdelta and the scale factor on pscale.
+      bool is_translate_uniform_scale(Vec3 * pdelta, float * pscale) const;
+
+      Transform_type get_type() const { return m_type; }
+      const Mat4 & get_matrix() const { return m_mat4; }
+      const Mat4 & get_inverse_matrix() const { return m_mat4_inv; }
+
       Transform & operator=(const Transform &) = default;
 
     private:
@@ -39,13 +58,18 @@ namespace lux {
       Vec3 apply_on_point(const Vec3 & p, const Mat4 & m) const;
       Vec3 apply_on_normal(const Vec3 & n, const Mat4 & m) const;
 
+      static Transform_type classify(const Mat4 & m);
+
       Mat4 m_mat4;
       Mat4 m_mat4_inv;
+      Transform_type m_type;
   };
 
 
   inline Vec3 Transform::apply_on_vector(const Vec3 & v, const Mat4 & m) const
   {
+    if (m_type <= Transform_type::ktranslation) return v;
+
     float x, y, z;
     x = v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0];
     y = v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1];
@@ -56,6 +80,18 @@ namespace lux {
 
   inline Vec3 Transform::apply_on_point(const Vec3 & p, const Mat4 & m) const
   {
+    if (m_type == Transform_type::kidentity) return p;
+
+    if (m_type == Transform_type::ktranslation) {
+      return Vec3(p.x + m.m[3][0], p.y + m.m[3][1], p.z + m.m[3][2]);
+    }
+
+    if (m_type == Transform_type::kaffine) {
+      return Vec3(p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+                  p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+                  p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2]);
+    }
+
     float x, y, z, w;
     x = p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0];
     y = p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1];
@@ -70,6 +106,8 @@ namespace lux {
 
   inline Vec3 Transform::apply_on_normal(const Vec3 & n, const Mat4 & m) const
   {
+    if (m_type <= Transform_type::ktranslation) return n;
+
     return Vec3(n.x * m.m[0][0] + n.y * m.m[0][1] + n.z * m.m[0][2],
                 n.x * m.m[1][0] + n.y * m.m[1][1] + n.z * m.m[1][2],
                 n.x * m.m[2][0] + n.y * m.m[2][1] + n.z * m.m[2][2]);
@@ -107,6 +145,8 @@ namespace lux {
 
   inline Ray Transform::apply_on_ray(const Ray & r) const
   {
+    if (m_type == Transform_type::kidentity) return r;
+
     const Vec3 o = r.get_origin();
     const Vec3 d = r.get_direction();
 
@@ -115,6 +155,8 @@ namespace lux {
 
   inline Ray Transform::apply_inverse_on_ray(const Ray & r) const
   {
+    if (m_type == Transform_type::kidentity) return r;
+
     const Vec3 o = r.get_origin();
     const Vec3 d = r.get_direction();
 
@@ -136,6 +178,7 @@ namespace lux {
   {
     os << "M = " << std::endl << t.m_mat4 << std::endl;
     os << "MInv = " << std::endl << t.m_mat4_inv;
+    os << "Type = " << t.m_type;
 
     return os;
   }
@@ -17,6 +17,8 @@ namespace lux {
   template <typename T>
     void shuffle(T * values, const std::size_t count, RNG & rng)
     {
+      if (count < 2) return;
+
       for (std::size_t i = count - 2; i != 0; --i) {
         std::size_t random_index_before_i = i * rng();
         T temp = values[i + 1];
@@ -3,6 +3,7 @@
 #include <cmath>
 
 #include <iostream>
+#include <algorithm>
 
 #include "core/error.h"
 
@@ -196,6 +197,16 @@ namespace lux {
     return magnitude_squared(b - a);
   }
 
+  inline Vec3 min(const Vec3 & a, const Vec3 & b)
+  {
+    return Vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+  }
+
+  inline Vec3 max(const Vec3 & a, const Vec3 & b)
+  {
+    return Vec3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+  }
+
   // Expects a NORMALIZED r
   inline void orthonormal_basis(Vec3 * p, Vec3 * q, const Vec3 & r)
   {
@@ -1,10 +1,13 @@
 #include "integrators/path_tracer.h"
 
+#include <limits>
+
 #include "core/rgb_spectrum.h"
 #include "core/ray.h"
 #include "core/sampler.h"
 #include "core/material.h"
 #include "core/scene.h"
+#include "core/render_stats.h"
 
 namespace lux {
   Path_tracer::Path_tracer(Sampler * psampler, unsigned max_depth)
@@ -13,45 +16,54 @@ namespace lux {
     psampler -> start_pixel();
   }
 
-  RGB_spectrum Path_tracer::li(const Scene & scene, const Ray & r)
+  // Every value of a path fits in registers or on the stack, the arena isn't used yet
+  RGB_spectrum Path_tracer::li(const Scene & scene, const Ray & r, Memory_arena *)
   {
     RGB_spectrum L(0.0f);
     RGB_spectrum beta(1.0f);
     Ray ray(r);
 
     Material_type material_type = Material_type::kdiffuse;
+    add_render_count(kpaths);
     for (unsigned bounces = 0; bounces != m_kmax_depth ; ++bounces) {
+      if (bounces != 0) add_render_count(kindirect_rays);
       Surface_interaction surface_interaction;
       bool found_intersection = scene.intersect(ray, &surface_interaction);
       if (!found_intersection) break;
+      add_render_count(kpath_vertices);
+
+      // Until the next ray is traced
+      Scoped_render_phase shading_phase(kshading_phase);
 
       // Acount for the first intersection to be with a emissive surface
       if (bounces == 0 || material_type == Material_type::kspecular) {
         L += beta * surface_interaction.pshape->le(surface_interaction, -ray.get_direction());
       }
 
-      // Initialize Materials' shading space
-      surface_interaction.pmaterial->init_shading_space(surface_interaction);
-
       // Compute estimate of direct lighting on current vertex
       L += beta * uniform_sample_one_light(scene, surface_interaction, *m_psampler);
 
       Vec3 wo_world = -ray.get_direction(), wi_world;
       float pdf;
-      RGB_spectrum f = surface_interaction.pmaterial->sample_f(wo_world, &wi_world,
-                                                               m_psampler->get_2D(), &pdf);
+      RGB_spectrum f = surface_interaction.pmaterial->sample_f(surface_interaction, wo_world,
+                                                               &wi_world, m_psampler->get_2D(),
+                                                               &pdf);
 
       if (f.is_black() || pdf == 0.0f) break;
 
       beta *= f * abs_dot(wi_world, surface_interaction.n) / pdf;
-      ray = Ray(surface_interaction.hit_point, normalize(wi_world));
+      ray = Ray(surface_interaction.hit_point, normalize(wi_world),
+                std::numeric_limits<float>::infinity(), ray.get_time());
 
       material_type = surface_interaction.pmaterial->get_type();
 
       // Russian Roullete
       if (bounces > 3) {
         const float q = std::max(0.05f, 1 - beta.y());
-        if (m_psampler->get_1D() < q) break;
+        if (m_psampler->get_1D() < q) {
+          add_render_count(krussian_roulette_terminations);
+          break;
+        }
         beta /= 1 - q;
       }
     }
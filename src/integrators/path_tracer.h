@@ -5,7 +5,7 @@
 
 #include "core/rgb_spectrum.h"
 
-namespace lux { class Ray; class Scene; class Sampler; }
+namespace lux { class Ray; class Scene; class Sampler; class Memory_arena; }
 
 namespace lux {
   class Path_tracer final : public Integrator {
@@ -15,7 +15,8 @@ namespace lux {
       Path_tracer(const Path_tracer &) = delete;
       Path_tracer & operator=(const Path_tracer &) = delete;
 
-      virtual RGB_spectrum li(const Scene & scene, const Ray & r) override;
+      virtual RGB_spectrum li(const Scene & scene, const Ray & r,
+                              Memory_arena * parena) override;
 
       virtual ~Path_tracer() override;
 
@@ -0,0 +1,66 @@
+#include "loaders/mesh_loader.h"
+
+#include <cstddef>
+
+#include <string>
+#include <memory>
+#include <ostream>
+#include <chrono>
+#include <utility>
+
+#include "core/mapped_file.h"
+#include "core/transform.h"
+#include "core/rgb_spectrum.h"
+#include "shapes/triangle_mesh.h"
+
+namespace lux {
+  namespace {
+    bool has_extension(const std::string & path, const std::string & extension)
+    {
+      return path.size() >= extension.size() &&
+             path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    }
+  }
+
+  std::ostream & operator<<(std::ostream & os, const Mesh_load_stats & stats)
+  {
+    os << stats.file_bytes / (1024.0 * 1024.0) << " MiB in " << stats.load_seconds * 1000.0
+       << " ms, " << stats.megabytes_per_second() << " MiB/s";
+
+    return os;
+  }
+
+  std::shared_ptr<Triangle_mesh> load_mesh(const std::string & path,
+                                           const Transform & object_to_world,
+                                           std::shared_ptr<Material> pmaterial,
+                                           const RGB_spectrum & emitted_radiance,
+                                           Mesh_load_stats * pstats, unsigned num_threads)
+  {
+    const std::chrono::steady_clock::time_point kstart = std::chrono::steady_clock::now();
+
+    std::shared_ptr<Triangle_mesh> pmesh;
+    const bool kis_obj = has_extension(path, ".obj");
+    if (kis_obj || has_extension(path, ".ply")) {
+      Mesh_buffers buffers;
+      const bool kloaded = kis_obj ? load_obj(path, &buffers, num_threads)
+                                   : load_ply(path, &buffers, num_threads);
+      if (!kloaded) return nullptr;
+
+      pmesh = std::make_shared<Triangle_mesh>(object_to_world, pmaterial, emitted_radiance,
+                                              std::move(buffers.positions),
+                                              std::move(buffers.indices));
+    }
+    else {
+      pmesh = load_mesh_file(path, object_to_world, pmaterial, emitted_radiance, num_threads);
+      if (!pmesh) return nullptr;
+    }
+
+    if (pstats) {
+      const std::chrono::duration<double> kload_time = std::chrono::steady_clock::now() - kstart;
+      pstats->file_bytes = Mapped_file(path).size();
+      pstats->load_seconds = kload_time.count();
+    }
+
+    return pmesh;
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef LUX_LOADERS_MESH_LOADER_H_
+#define LUX_LOADERS_MESH_LOADER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+
+namespace lux { class Triangle_mesh; class Transform; class Material; class RGB_spectrum; }
+
+namespace lux {
+  // Indexed triangles as parsed from a mesh file, in the layout Triangle_mesh takes
+  struct Mesh_buffers {
+    std::vector<float> positions;       // 3 floats per vertex
+    std::vector<std::uint32_t> indices; // 3 vertex indices per triangle
+  };
+
+  struct Mesh_load_stats {
+    std::size_t file_bytes = 0;
+    double load_seconds = 0.0;
+
+    double megabytes_per_second() const
+    {
+      return (load_seconds > 0.0) ? file_bytes / (load_seconds * 1024.0 * 1024.0) : 0.0;
+    }
+  };
+
+  std::ostream & operator<<(std::ostream & os, const Mesh_load_stats & stats);
+
+  // Both loaders map the file and parse it in one chunk per thread, passing 0 as
+  // num_threads uses every core. Polygons are triangulated as fans, everything but the
+  // positions and faces is ignored. They return false if the file can't be read, is
+  // malformed or references a vertex that doesn't exist.
+
+  // Wavefront OBJ, "v" and "f" statements with positive or relative indices
+  bool load_obj(const std::string & path, Mesh_buffers * pbuffers, unsigned num_threads = 0);
+
+  // PLY in the ascii, binary_little_endian and binary_big_endian formats
+  bool load_ply(const std::string & path, Mesh_buffers * pbuffers, unsigned num_threads = 0);
+
+  // Picks the loader from the extension of path: ".obj", ".ply", or anything else for
+  // the mesh files of triangle_mesh.h, which are mapped instead of parsed. Returns
+  // nullptr on failure.
+  std::shared_ptr<Triangle_mesh> load_mesh(const std::string & path,
+                                           const Transform & object_to_world,
+                                           std::shared_ptr<Material> pmaterial,
+                                           const RGB_spectrum & emitted_radiance,
+                                           Mesh_load_stats * pstats = nullptr,
+                                           unsigned num_threads = 0);
+}
+
+#endif
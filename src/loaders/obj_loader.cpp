@@ -0,0 +1,151 @@
+#include "loaders/mesh_loader.h"
+
+#include <cstdint>
+#include <cstddef>
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+
+#include "core/parallel.h"
+#include "core/mapped_file.h"
+#include "loaders/parse.h"
+
+namespace lux {
+  namespace {
+    // A chunk doesn't know how many vertices the chunks before it define, so relative
+    // indices are stored as chunk relative vertex numbers minus this bias, which keeps
+    // them negative, and are resolved when the chunks are merged. Absolute indices are
+    // stored zero based.
+    const std::int64_t krelative_bias = std::int64_t(1) << 40;
+
+    struct Obj_chunk {
+      std::vector<float> positions;
+      std::vector<std::int64_t> indices;
+      bool valid = true;
+    };
+
+    inline bool is_statement(const char * p, const char * end, const char keyword)
+    {
+      return p[0] == keyword && p + 1 != end && is_blank(p[1]);
+    }
+
+    void parse_obj_chunk(const char * p, const char * end, Obj_chunk * pchunk)
+    {
+      Obj_chunk & chunk = *pchunk;
+      std::vector<std::int64_t> face;
+
+      while (p != end) {
+        p = skip_blanks(p, end);
+        if (p == end) break;
+
+        if (is_statement(p, end, 'v')) {
+          ++p;
+          for (unsigned i = 0; i != 3; ++i) {
+            float coordinate;
+            p = parse_float(skip_blanks(p, end), end, &coordinate);
+            if (!p) {
+              chunk.valid = false;
+              return;
+            }
+            chunk.positions.push_back(coordinate);
+          }
+        }
+        else if (is_statement(p, end, 'f')) {
+          const std::int64_t knum_vertices = chunk.positions.size() / 3;
+          face.clear();
+          for (p = skip_blanks(p + 1, end); p != end && *p != '\n' && *p != '#';
+               p = skip_blanks(p, end)) {
+            std::int64_t index;
+            p = parse_int(p, end, &index);
+            if (!p || index == 0) {
+              chunk.valid = false;
+              return;
+            }
+            face.push_back((index > 0) ? index - 1 : knum_vertices + index - krelative_bias);
+
+            // Texture coordinate and normal indices
+            while (p != end && !is_blank(*p) && *p != '\n') ++p;
+          }
+          if (face.size() < 3) {
+            chunk.valid = false;
+            return;
+          }
+
+          for (std::size_t i = 1; i + 1 < face.size(); ++i) {
+            chunk.indices.push_back(face[0]);
+            chunk.indices.push_back(face[i]);
+            chunk.indices.push_back(face[i + 1]);
+          }
+        }
+
+        p = skip_line(p, end);
+      }
+    }
+  }
+
+  bool load_obj(const std::string & path, Mesh_buffers * pbuffers, unsigned num_threads)
+  {
+    const Mapped_file kfile(path);
+    if (!kfile.is_open()) return false;
+
+    if (num_threads == 0) num_threads = num_system_cores();
+    const char * kbegin = reinterpret_cast<const char *>(kfile.data());
+    const std::vector<const char *> kboundaries = split_lines(kbegin, kbegin + kfile.size(),
+                                                              num_threads);
+    const std::size_t knum_chunks = kboundaries.size() - 1;
+
+    std::vector<Obj_chunk> chunks(knum_chunks);
+    parallel_for(knum_chunks, [&](const std::size_t begin, const std::size_t end)
+        {
+          for (std::size_t i = begin; i != end; ++i) {
+            parse_obj_chunk(kboundaries[i], kboundaries[i + 1], &chunks[i]);
+          }
+        }, num_threads);
+
+    // Where each chunk's vertices and indices go in the merged buffers
+    std::vector<std::size_t> vertex_offsets(knum_chunks + 1, 0);
+    std::vector<std::size_t> index_offsets(knum_chunks + 1, 0);
+    for (std::size_t i = 0; i != knum_chunks; ++i) {
+      if (!chunks[i].valid) return false;
+      vertex_offsets[i + 1] = vertex_offsets[i] + chunks[i].positions.size() / 3;
+      index_offsets[i + 1] = index_offsets[i] + chunks[i].indices.size();
+    }
+    const std::size_t knum_vertices = vertex_offsets.back();
+    if (knum_vertices > std::numeric_limits<std::uint32_t>::max()) return false;
+
+    Mesh_buffers & buffers = *pbuffers;
+    buffers.positions.resize(3 * knum_vertices);
+    buffers.indices.resize(index_offsets.back());
+
+    std::atomic<bool> valid(true);
+    parallel_for(knum_chunks, [&](const std::size_t begin, const std::size_t end)
+        {
+          for (std::size_t i = begin; i != end; ++i) {
+            std::copy(chunks[i].positions.begin(), chunks[i].positions.end(),
+                      buffers.positions.begin() + 3 * vertex_offsets[i]);
+
+            const std::int64_t kvertex_offset = vertex_offsets[i];
+            std::uint32_t * pindex = buffers.indices.data() + index_offsets[i];
+            for (const std::int64_t kindex : chunks[i].indices) {
+              const std::int64_t kresolved = (kindex >= 0) ? kindex
+                                                           : kindex + krelative_bias +
+                                                             kvertex_offset;
+              if (kresolved < 0 || kresolved >= static_cast<std::int64_t>(knum_vertices)) {
+                valid = false;
+                return;
+              }
+              *pindex++ = static_cast<std::uint32_t>(kresolved);
+            }
+
+            // Frees the chunk as soon as it's merged
+            std::vector<float>().swap(chunks[i].positions);
+            std::vector<std::int64_t>().swap(chunks[i].indices);
+          }
+        }, num_threads);
+
+    return valid;
+  }
+}
@@ -0,0 +1,138 @@
+#ifndef LUX_LOADERS_PARSE_H_
+#define LUX_LOADERS_PARSE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// Number parsing for the text mesh formats. Unlike strtof and friends they work on
+// [p, end) ranges of a mapped file, which aren't null terminated, and don't look at the
+// locale. Every parser returns the position after what it read, or nullptr if the text
+// doesn't start with a number.
+namespace lux {
+  inline bool is_digit(const char c) { return c >= '0' && c <= '9'; }
+
+  // Blanks other than the newline, which ends the statements of OBJ and PLY files
+  inline bool is_blank(const char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+  inline const char * skip_blanks(const char * p, const char * end)
+  {
+    while (p != end && is_blank(*p)) ++p;
+    return p;
+  }
+
+  // Returns the start of the next line, or end
+  inline const char * skip_line(const char * p, const char * end)
+  {
+    while (p != end && *p != '\n') ++p;
+    return (p == end) ? end : p + 1;
+  }
+
+  // Splits [begin, end) into at most num_chunks ranges of whole lines. Returns the
+  // num_ranges + 1 boundaries.
+  inline std::vector<const char *> split_lines(const char * begin, const char * end,
+                                               const std::size_t num_chunks)
+  {
+    std::vector<const char *> boundaries(1, begin);
+    const std::size_t kchunk_size = (end - begin) / num_chunks + 1;
+    while (boundaries.back() != end) {
+      const char * p = boundaries.back();
+      p = (static_cast<std::size_t>(end - p) > kchunk_size) ? skip_line(p + kchunk_size, end)
+                                                             : end;
+      boundaries.push_back(p);
+    }
+
+    return boundaries;
+  }
+
+  // Fails on values that don't fit in 64 bits rather than wrapping around
+  inline const char * parse_int(const char * p, const char * end, std::int64_t * pvalue)
+  {
+    const std::int64_t kmax_value = std::numeric_limits<std::int64_t>::max();
+
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    if (p == end || !is_digit(*p)) return nullptr;
+
+    std::int64_t value = 0;
+    for (; p != end && is_digit(*p); ++p) {
+      const int kdigit = *p - '0';
+      if (value > (kmax_value - kdigit) / 10) return nullptr;
+      value = value * 10 + kdigit;
+    }
+    *pvalue = negative ? -value : value;
+
+    return p;
+  }
+
+  // Accumulates up to 19 significant digits into an integer, then scales it by a power
+  // of ten in double precision. The result is correctly rounded to float for all but
+  // pathological inputs.
+  inline const char * parse_float(const char * p, const char * end, float * pvalue)
+  {
+    static const double kpowers_of_10[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+      1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const int kmax_exact_power = 22;
+    const int kmax_digits = 19;
+
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+    std::uint64_t mantissa = 0;
+    int exponent = 0;
+    int num_digits = 0;
+    bool has_digits = false;
+    for (; p != end && is_digit(*p); ++p, has_digits = true) {
+      if (num_digits < kmax_digits) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa) ++num_digits;
+      }
+      else {
+        ++exponent;
+      }
+    }
+
+    if (p != end && *p == '.') {
+      for (++p; p != end && is_digit(*p); ++p, has_digits = true) {
+        if (num_digits < kmax_digits) {
+          mantissa = mantissa * 10 + (*p - '0');
+          if (mantissa) ++num_digits;
+          --exponent;
+        }
+      }
+    }
+    if (!has_digits) return nullptr;
+
+    if (p != end && (*p == 'e' || *p == 'E')) {
+      std::int64_t explicit_exponent;
+      p = parse_int(p + 1, end, &explicit_exponent);
+      if (!p) return nullptr;
+      exponent += static_cast<int>(std::max<std::int64_t>(-1000,
+                                   std::min<std::int64_t>(1000, explicit_exponent)));
+    }
+
+    double value = static_cast<double>(mantissa);
+    if (value != 0.0) {
+      if (exponent < 0 && -exponent <= kmax_exact_power) {
+        value /= kpowers_of_10[-exponent];
+      }
+      else if (exponent > 0 && exponent <= kmax_exact_power) {
+        value *= kpowers_of_10[exponent];
+      }
+      else if (exponent != 0) {
+        value *= std::pow(10.0, exponent);
+      }
+    }
+    *pvalue = static_cast<float>(negative ? -value : value);
+
+    return p;
+  }
+}
+
+#endif
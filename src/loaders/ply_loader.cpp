@@ -0,0 +1,511 @@
+#include "loaders/mesh_loader.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <limits>
+#include <algorithm>
+
+#include "core/parallel.h"
+#include "core/mapped_file.h"
+#include "loaders/parse.h"
+
+namespace lux {
+  namespace {
+    enum Ply_format { kascii, kbinary_little_endian, kbinary_big_endian };
+    enum Ply_type { kint8, kuint8, kint16, kuint16, kint32, kuint32, kfloat32, kfloat64, kinvalid };
+
+    struct Ply_property {
+      std::string name;
+      Ply_type type;        // Type of the items if is_list is true
+      bool is_list;
+      Ply_type count_type;
+    };
+
+    struct Ply_element {
+      std::string name;
+      std::size_t count;
+      std::vector<Ply_property> properties;
+    };
+
+    struct Ply_header {
+      Ply_format format;
+      std::vector<Ply_element> elements;
+      std::size_t size;     // In bytes, up to and including the end_header line
+    };
+
+    Ply_type parse_type(const std::string & name)
+    {
+      if (name == "char" || name == "int8") return Ply_type::kint8;
+      if (name == "uchar" || name == "uint8") return Ply_type::kuint8;
+      if (name == "short" || name == "int16") return Ply_type::kint16;
+      if (name == "ushort" || name == "uint16") return Ply_type::kuint16;
+      if (name == "int" || name == "int32") return Ply_type::kint32;
+      if (name == "uint" || name == "uint32") return Ply_type::kuint32;
+      if (name == "float" || name == "float32") return Ply_type::kfloat32;
+      if (name == "double" || name == "float64") return Ply_type::kfloat64;
+      return Ply_type::kinvalid;
+    }
+
+    bool is_integer(const Ply_type type)
+    {
+      return type != Ply_type::kfloat32 && type != Ply_type::kfloat64;
+    }
+
+    std::size_t type_size(const Ply_type type)
+    {
+      switch (type) {
+        case Ply_type::kint8: case Ply_type::kuint8: return 1;
+        case Ply_type::kint16: case Ply_type::kuint16: return 2;
+        case Ply_type::kint32: case Ply_type::kuint32: case Ply_type::kfloat32: return 4;
+        case Ply_type::kfloat64: return 8;
+        default: return 0;
+      }
+    }
+
+    bool parse_header(const char * begin, const char * end, Ply_header * pheader)
+    {
+      Ply_header & header = *pheader;
+      bool has_format = false;
+
+      const char * p = begin;
+      for (bool first_line = true; p != end; first_line = false) {
+        const char * kline_end = skip_line(p, end);
+        std::istringstream line(std::string(p, kline_end));
+        p = kline_end;
+
+        std::string keyword;
+        line >> keyword;
+        if (first_line) {
+          if (keyword != "ply") return false;
+        }
+        else if (keyword == "format") {
+          std::string format;
+          line >> format;
+          if (format == "ascii") header.format = Ply_format::kascii;
+          else if (format == "binary_little_endian") {
+            header.format = Ply_format::kbinary_little_endian;
+          }
+          else if (format == "binary_big_endian") header.format = Ply_format::kbinary_big_endian;
+          else return false;
+          has_format = true;
+        }
+        else if (keyword == "element") {
+          Ply_element element;
+          if (!(line >> element.name >> element.count)) return false;
+          header.elements.push_back(element);
+        }
+        else if (keyword == "property") {
+          if (header.elements.empty()) return false;
+
+          Ply_property property;
+          std::string type;
+          line >> type;
+          property.is_list = (type == "list");
+          if (property.is_list) {
+            std::string count_type;
+            line >> count_type >> type;
+            property.count_type = parse_type(count_type);
+            if (property.count_type == Ply_type::kinvalid ||
+                property.count_type == Ply_type::kfloat32 ||
+                property.count_type == Ply_type::kfloat64) {
+              return false;
+            }
+          }
+          property.type = parse_type(type);
+          if (!(line >> property.name) || property.type == Ply_type::kinvalid) return false;
+          header.elements.back().properties.push_back(property);
+        }
+        else if (keyword == "end_header") {
+          header.size = p - begin;
+          return has_format;
+        }
+        else if (keyword != "comment" && keyword != "obj_info" && !keyword.empty()) {
+          return false;
+        }
+      }
+
+      return false;
+    }
+
+    bool is_little_endian()
+    {
+      const std::uint16_t kone = 1;
+      unsigned char first_byte;
+      std::memcpy(&first_byte, &kone, 1);
+      return first_byte == 1;
+    }
+
+    template<typename T>
+    T read_binary(const unsigned char * p, const bool swap_bytes)
+    {
+      unsigned char bytes[sizeof(T)];
+      std::memcpy(bytes, p, sizeof(T));
+      if (swap_bytes) std::reverse(bytes, bytes + sizeof(T));
+
+      T value;
+      std::memcpy(&value, bytes, sizeof(T));
+      return value;
+    }
+
+    double read_binary(const unsigned char * p, const Ply_type type, const bool swap_bytes)
+    {
+      switch (type) {
+        case Ply_type::kint8: return read_binary<std::int8_t>(p, swap_bytes);
+        case Ply_type::kuint8: return read_binary<std::uint8_t>(p, swap_bytes);
+        case Ply_type::kint16: return read_binary<std::int16_t>(p, swap_bytes);
+        case Ply_type::kuint16: return read_binary<std::uint16_t>(p, swap_bytes);
+        case Ply_type::kint32: return read_binary<std::int32_t>(p, swap_bytes);
+        case Ply_type::kuint32: return read_binary<std::uint32_t>(p, swap_bytes);
+        case Ply_type::kfloat32: return read_binary<float>(p, swap_bytes);
+        case Ply_type::kfloat64: return read_binary<double>(p, swap_bytes);
+        default: return 0.0;
+      }
+    }
+
+    // Indices of the x, y and z properties of the vertex element and of the index list
+    // of the face element, which has to be there
+    struct Ply_layout {
+      const Ply_element * pvertex;
+      const Ply_element * pface;
+      std::size_t coordinate[3];
+      std::size_t face_indices;
+    };
+
+    bool find_layout(const Ply_header & header, Ply_layout * playout)
+    {
+      Ply_layout & layout = *playout;
+      layout.pvertex = nullptr;
+      layout.pface = nullptr;
+
+      for (const Ply_element & element : header.elements) {
+        if (element.name == "vertex") layout.pvertex = &element;
+        if (element.name == "face") layout.pface = &element;
+      }
+      if (!layout.pvertex || !layout.pface) return false;
+
+      const char * knames[3] = { "x", "y", "z" };
+      for (unsigned i = 0; i != 3; ++i) {
+        const std::vector<Ply_property> & properties = layout.pvertex->properties;
+        layout.coordinate[i] = properties.size();
+        for (std::size_t j = 0; j != properties.size(); ++j) {
+          if (properties[j].name == knames[i] && !properties[j].is_list) layout.coordinate[i] = j;
+        }
+        if (layout.coordinate[i] == properties.size()) return false;
+      }
+
+      const std::vector<Ply_property> & properties = layout.pface->properties;
+      layout.face_indices = properties.size();
+      for (std::size_t j = 0; j != properties.size(); ++j) {
+        if (properties[j].is_list && (properties[j].name == "vertex_indices" ||
+                                      properties[j].name == "vertex_index")) {
+          layout.face_indices = j;
+        }
+      }
+
+      return layout.face_indices != properties.size() &&
+             layout.pvertex->count <= std::numeric_limits<std::uint32_t>::max();
+    }
+
+    void add_fan(const std::vector<std::int64_t> & face, std::vector<std::uint32_t> * pindices)
+    {
+      for (std::size_t i = 1; i + 1 < face.size(); ++i) {
+        pindices->push_back(static_cast<std::uint32_t>(face[0]));
+        pindices->push_back(static_cast<std::uint32_t>(face[i]));
+        pindices->push_back(static_cast<std::uint32_t>(face[i + 1]));
+      }
+    }
+
+    bool faces_are_valid(const std::vector<std::int64_t> & face, const std::size_t num_vertices)
+    {
+      if (face.size() < 3) return false;
+      for (const std::int64_t kindex : face) {
+        if (kindex < 0 || kindex >= static_cast<std::int64_t>(num_vertices)) return false;
+      }
+      return true;
+    }
+
+    // Size of one binary element, or 0 if it has lists and the size varies
+    std::size_t fixed_element_size(const Ply_element & element)
+    {
+      std::size_t size = 0;
+      for (const Ply_property & property : element.properties) {
+        if (property.is_list) return 0;
+        size += type_size(property.type);
+      }
+      return size;
+    }
+
+    // Reads the element starting at p, passing each list to on_list(property, count,
+    // first item). Returns the end of the element, or nullptr if it doesn't fit before end.
+    template<typename List_function>
+    const unsigned char * read_binary_element(const unsigned char * p, const unsigned char * end,
+                                              const Ply_element & element, const bool swap_bytes,
+                                              List_function on_list)
+    {
+      for (std::size_t i = 0; i != element.properties.size(); ++i) {
+        const Ply_property & property = element.properties[i];
+        if (!property.is_list) {
+          p += type_size(property.type);
+          continue;
+        }
+
+        const std::size_t kcount_size = type_size(property.count_type);
+        if (static_cast<std::size_t>(end - p) < kcount_size) return nullptr;
+        const double kcount = read_binary(p, property.count_type, swap_bytes);
+        if (kcount < 0.0) return nullptr;
+        p += kcount_size;
+
+        const std::size_t kitems_size = static_cast<std::size_t>(kcount) *
+                                        type_size(property.type);
+        if (static_cast<std::size_t>(end - p) < kitems_size) return nullptr;
+        on_list(i, static_cast<std::size_t>(kcount), p);
+        p += kitems_size;
+      }
+
+      return (p <= end) ? p : nullptr;
+    }
+
+    bool load_binary_ply(const Ply_header & header, const Ply_layout & layout,
+                         const unsigned char * p, const unsigned char * end,
+                         Mesh_buffers * pbuffers, const unsigned num_threads)
+    {
+      const bool kswap_bytes = (header.format == Ply_format::kbinary_big_endian) ==
+                               is_little_endian();
+      Mesh_buffers & buffers = *pbuffers;
+      const std::size_t knum_vertices = layout.pvertex->count;
+
+      for (const Ply_element & element : header.elements) {
+        const std::size_t kelement_size = fixed_element_size(element);
+
+        if (&element == layout.pvertex) {
+          if (kelement_size == 0 || static_cast<std::size_t>(end - p) / kelement_size <
+                                    element.count) {
+            return false;
+          }
+
+          std::size_t offsets[3];
+          Ply_type types[3];
+          for (unsigned k = 0; k != 3; ++k) {
+            offsets[k] = 0;
+            for (std::size_t j = 0; j != layout.coordinate[k]; ++j) {
+              offsets[k] += type_size(element.properties[j].type);
+            }
+            types[k] = element.properties[layout.coordinate[k]].type;
+          }
+
+          buffers.positions.resize(3 * element.count);
+          parallel_for(element.count, [&](const std::size_t first, const std::size_t last)
+              {
+                for (std::size_t i = first; i != last; ++i) {
+                  const unsigned char * kvertex = p + i * kelement_size;
+                  for (unsigned k = 0; k != 3; ++k) {
+                    buffers.positions[3 * i + k] =
+                        static_cast<float>(read_binary(kvertex + offsets[k], types[k],
+                                                       kswap_bytes));
+                  }
+                }
+              }, num_threads);
+          p += element.count * kelement_size;
+        }
+        else if (&element == layout.pface) {
+          std::vector<std::int64_t> face;
+          bool valid = true;
+          const Ply_property & kindices = element.properties[layout.face_indices];
+          const std::size_t kitem_size = type_size(kindices.type);
+          buffers.indices.reserve(3 * element.count);
+
+          for (std::size_t i = 0; i != element.count && p; ++i) {
+            p = read_binary_element(p, end, element, kswap_bytes,
+                [&](const std::size_t property, const std::size_t count,
+                    const unsigned char * pitems)
+                {
+                  if (property != layout.face_indices) return;
+
+                  face.resize(count);
+                  for (std::size_t j = 0; j != count; ++j) {
+                    face[j] = static_cast<std::int64_t>(read_binary(pitems + j * kitem_size,
+                                                                    kindices.type,
+                                                                    kswap_bytes));
+                  }
+                  valid = valid && faces_are_valid(face, knum_vertices);
+                  if (valid) add_fan(face, &buffers.indices);
+                });
+          }
+          if (!p || !valid) return false;
+        }
+        else if (kelement_size != 0) {
+          if (static_cast<std::size_t>(end - p) / kelement_size < element.count) return false;
+          p += element.count * kelement_size;
+        }
+        else {
+          for (std::size_t i = 0; i != element.count && p; ++i) {
+            p = read_binary_element(p, end, element, kswap_bytes,
+                                    [](std::size_t, std::size_t, const unsigned char *) {});
+          }
+          if (!p) return false;
+        }
+      }
+
+      return true;
+    }
+
+    struct Ply_ascii_chunk {
+      std::vector<std::uint32_t> indices;
+      bool valid = true;
+    };
+
+    // Every element is on its own line, so the line number tells which element a line
+    // holds and where its vertex goes
+    void parse_ply_ascii_chunk(const char * p, const char * end, std::size_t line,
+                               const Ply_header & header, const Ply_layout & layout,
+                               Mesh_buffers * pbuffers, Ply_ascii_chunk * pchunk)
+    {
+      std::vector<std::int64_t> face;
+
+      std::size_t element = 0;
+      std::size_t element_first_line = 0;
+      for (; p != end; p = skip_line(p, end), ++line) {
+        while (element != header.elements.size() &&
+               line >= element_first_line + header.elements[element].count) {
+          element_first_line += header.elements[element].count;
+          ++element;
+        }
+        if (element == header.elements.size()) return;
+
+        const Ply_element & kelement = header.elements[element];
+        if (&kelement != layout.pvertex && &kelement != layout.pface) continue;
+
+        for (std::size_t i = 0; i != kelement.properties.size(); ++i) {
+          const Ply_property & property = kelement.properties[i];
+          const bool kis_integer = is_integer(property.type);
+          float value;
+          std::int64_t integer_value;
+          std::int64_t count = 1;
+
+          if (property.is_list) {
+            p = parse_int(skip_blanks(p, end), end, &count);
+
+            // Every item takes at least a blank and a digit, which bounds the list
+            // before anything is allocated for it
+            if (!p || count < 0 || count > (end - p) / 2) {
+              pchunk->valid = false;
+              return;
+            }
+            if (&kelement == layout.pface && i == layout.face_indices) face.resize(count);
+          }
+
+          for (std::int64_t j = 0; j != count; ++j) {
+            if (kis_integer) {
+              p = parse_int(skip_blanks(p, end), end, &integer_value);
+              value = static_cast<float>(integer_value);
+            }
+            else {
+              p = parse_float(skip_blanks(p, end), end, &value);
+              integer_value = static_cast<std::int64_t>(value);
+            }
+            if (!p) {
+              pchunk->valid = false;
+              return;
+            }
+
+            if (&kelement == layout.pvertex) {
+              for (unsigned k = 0; k != 3; ++k) {
+                if (i == layout.coordinate[k]) {
+                  pbuffers->positions[3 * (line - element_first_line) + k] = value;
+                }
+              }
+            }
+            else if (i == layout.face_indices) {
+              face[j] = integer_value;
+            }
+          }
+        }
+
+        if (&kelement == layout.pface) {
+          if (!faces_are_valid(face, layout.pvertex->count)) {
+            pchunk->valid = false;
+            return;
+          }
+          add_fan(face, &pchunk->indices);
+        }
+      }
+    }
+
+    bool load_ascii_ply(const Ply_header & header, const Ply_layout & layout,
+                        const char * begin, const char * end, Mesh_buffers * pbuffers,
+                        const unsigned num_threads)
+    {
+      const std::vector<const char *> kboundaries = split_lines(begin, end, num_threads);
+      const std::size_t knum_chunks = kboundaries.size() - 1;
+
+      // Line number of the start of each chunk
+      std::vector<std::size_t> first_lines(knum_chunks + 1, 0);
+      parallel_for(knum_chunks, [&](const std::size_t chunk_begin, const std::size_t chunk_end)
+          {
+            for (std::size_t i = chunk_begin; i != chunk_end; ++i) {
+              first_lines[i + 1] = std::count(kboundaries[i], kboundaries[i + 1], '\n');
+            }
+          }, num_threads);
+      for (std::size_t i = 0; i != knum_chunks; ++i) first_lines[i + 1] += first_lines[i];
+
+      std::size_t num_lines = first_lines.back();
+      if (begin != end && end[-1] != '\n') ++num_lines;
+      std::size_t num_element_lines = 0;
+      for (const Ply_element & element : header.elements) num_element_lines += element.count;
+      if (num_lines < num_element_lines) return false;
+
+      pbuffers->positions.resize(3 * layout.pvertex->count);
+      std::vector<Ply_ascii_chunk> chunks(knum_chunks);
+      parallel_for(knum_chunks, [&](const std::size_t chunk_begin, const std::size_t chunk_end)
+          {
+            for (std::size_t i = chunk_begin; i != chunk_end; ++i) {
+              parse_ply_ascii_chunk(kboundaries[i], kboundaries[i + 1], first_lines[i], header,
+                                    layout, pbuffers, &chunks[i]);
+            }
+          }, num_threads);
+
+      std::size_t num_indices = 0;
+      for (const Ply_ascii_chunk & kchunk : chunks) {
+        if (!kchunk.valid) return false;
+        num_indices += kchunk.indices.size();
+      }
+
+      pbuffers->indices.reserve(num_indices);
+      for (Ply_ascii_chunk & chunk : chunks) {
+        pbuffers->indices.insert(pbuffers->indices.end(), chunk.indices.begin(),
+                                 chunk.indices.end());
+        std::vector<std::uint32_t>().swap(chunk.indices);
+      }
+
+      return true;
+    }
+  }
+
+  bool load_ply(const std::string & path, Mesh_buffers * pbuffers, unsigned num_threads)
+  {
+    const Mapped_file kfile(path);
+    if (!kfile.is_open()) return false;
+
+    if (num_threads == 0) num_threads = num_system_cores();
+    const char * kbegin = reinterpret_cast<const char *>(kfile.data());
+    const char * kend = kbegin + kfile.size();
+
+    Ply_header header;
+    Ply_layout layout;
+    if (!parse_header(kbegin, kend, &header) || !find_layout(header, &layout)) return false;
+
+    pbuffers->positions.clear();
+    pbuffers->indices.clear();
+    if (header.format == Ply_format::kascii) {
+      return load_ascii_ply(header, layout, kbegin + header.size, kend, pbuffers, num_threads);
+    }
+
+    return load_binary_ply(header, layout, kfile.data() + header.size, kfile.data() + kfile.size(),
+                           pbuffers, num_threads);
+  }
+}
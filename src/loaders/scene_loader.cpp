@@ -0,0 +1,287 @@
+#include "loaders/scene_loader.h"
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "core/vec3.h"
+#include "core/transform.h"
+#include "core/rgb_spectrum.h"
+#include "core/material.h"
+#include "core/scene.h"
+#include "core/shape.h"
+#include "core/trace.h"
+#include "accelerators/bvh.h"
+#include "materials/lambertian.h"
+#include "materials/mirror.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+#include "shapes/triangle_mesh.h"
+#include "loaders/mesh_loader.h"
+
+namespace lux {
+  namespace {
+    bool read_vec3(std::istream & is, Vec3 * pv)
+    {
+      return static_cast<bool>(is >> pv->x >> pv->y >> pv->z);
+    }
+
+    bool read_spectrum(std::istream & is, RGB_spectrum * ps)
+    {
+      float r, g, b;
+      if (!(is >> r >> g >> b)) return false;
+      *ps = RGB_spectrum(r, g, b);
+      return true;
+    }
+
+    // Fails if anything but blanks is left on the line, including after an optional
+    // argument that didn't parse
+    bool at_end(std::istream & is)
+    {
+      is.clear();
+      std::string rest;
+      return !(is >> rest);
+    }
+
+    bool builds_shapes(const std::string & keyword)
+    {
+      return keyword == "material" || keyword == "identity" || keyword == "translate" ||
+             keyword == "rotate_x" || keyword == "rotate_y" || keyword == "rotate_z" ||
+             keyword == "scale" || keyword == "emission" || keyword == "sphere" ||
+             keyword == "triangle" || keyword == "mesh" || keyword == "light";
+    }
+
+    // Appends the words of line separated by single spaces, and a newline
+    void append_statement(const std::string & line, std::string * pstatements)
+    {
+      std::istringstream words(line);
+      std::string word;
+      for (bool first = true; words >> word; first = false) {
+        if (!first) *pstatements += ' ';
+        *pstatements += word;
+      }
+      *pstatements += '\n';
+    }
+
+    std::string directory_of(const std::string & path)
+    {
+      const std::string::size_type kslash = path.find_last_of('/');
+      return (kslash == std::string::npos) ? std::string() : path.substr(0, kslash + 1);
+    }
+  }
+
+  bool parse_tonemap(const std::string & name, Tonemap_operator * ptonemap)
+  {
+    if (name == "clip") *ptonemap = Tonemap_operator::kclip;
+    else if (name == "reinhard") *ptonemap = Tonemap_operator::kreinhard;
+    else if (name == "aces") *ptonemap = Tonemap_operator::kaces;
+    else return false;
+
+    return true;
+  }
+
+  bool load_scene_description(const std::string & path, Scene_description * pdescription,
+                              Scene * pscene, std::string * perror)
+  {
+    TRACE_SCOPE("scene load");
+    std::ifstream file(path);
+    if (!file) {
+      *perror = "Couldn't open " + path;
+      return false;
+    }
+
+    Render_settings & settings = pdescription->settings;
+    std::map<std::string, std::shared_ptr<Material>> materials;
+    const std::shared_ptr<Material> klight_material =
+        std::make_shared<Lambertian>(RGB_spectrum(1.0f));
+    Transform object_to_world;
+    RGB_spectrum emission(0.0f);
+
+    std::string line;
+    for (unsigned line_number = 1; std::getline(file, line); ++line_number) {
+      std::istringstream statement(line);
+      std::string keyword;
+      if (!(statement >> keyword) || keyword[0] == '#') continue;
+
+      const auto fail = [&](const std::string & message)
+          {
+            *perror = path + ":" + std::to_string(line_number) + ": " + message;
+            return false;
+          };
+      const auto find_material = [&](std::shared_ptr<Material> * pmaterial)
+          {
+            std::string name;
+            if (!(statement >> name)) return fail("Expected a material name");
+            const auto kmaterial = materials.find(name);
+            if (kmaterial == materials.end()) return fail("Unknown material " + name);
+            *pmaterial = kmaterial->second;
+            return true;
+          };
+
+      bool valid = true;
+      if (keyword == "film") {
+        valid = static_cast<bool>(statement >> settings.width >> settings.height) &&
+                settings.width != 0 && settings.height != 0;
+        std::string output;
+        if (valid && statement >> output) settings.output = output;
+      }
+      else if (keyword == "sampler") {
+        valid = static_cast<bool>(statement >> settings.samples_x >> settings.samples_y) &&
+                settings.samples_x != 0 && settings.samples_y != 0;
+      }
+      else if (keyword == "filter") {
+        std::string filter;
+        statement >> filter;
+        valid = (filter == "box" || filter == "tent");
+        settings.tent_filter = (filter == "tent");
+      }
+      else if (keyword == "integrator") {
+        std::string integrator;
+        valid = static_cast<bool>(statement >> integrator >> settings.max_depth) &&
+                integrator == "path";
+      }
+      else if (keyword == "clamp") {
+        valid = static_cast<bool>(statement >> settings.max_sample_value) &&
+                settings.max_sample_value > 0.0f;
+      }
+      else if (keyword == "exposure") {
+        valid = static_cast<bool>(statement >> settings.display.exposure);
+      }
+      else if (keyword == "tonemap") {
+        std::string tonemap;
+        statement >> tonemap;
+        valid = parse_tonemap(tonemap, &settings.display.tonemap);
+      }
+      else if (keyword == "bits") {
+        valid = static_cast<bool>(statement >> settings.display.bits_per_channel) &&
+                (settings.display.bits_per_channel == 8 ||
+                 settings.display.bits_per_channel == 16);
+      }
+      else if (keyword == "threads") {
+        valid = static_cast<bool>(statement >> settings.num_threads);
+      }
+      else if (keyword == "accelerator") {
+        std::string builder, quantized;
+        statement >> builder;
+        valid = parse_bvh_builder(builder, &settings.bvh_builder);
+        if (valid && statement >> quantized) valid = (quantized == "quantized");
+        settings.quantize_bvh = valid && quantized == "quantized";
+      }
+      else if (keyword == "camera") {
+        valid = read_vec3(statement, &settings.eye) && read_vec3(statement, &settings.look) &&
+                static_cast<bool>(statement >> settings.fov);
+        float lens_radius;
+        if (valid && statement >> lens_radius) {
+          settings.lens_radius = lens_radius;
+          valid = static_cast<bool>(statement >> settings.focal_distance);
+        }
+      }
+      else if (keyword == "shutter") {
+        valid = static_cast<bool>(statement >> settings.shutter_open >> settings.shutter_close) &&
+                settings.shutter_open <= settings.shutter_close;
+      }
+      else if (keyword == "material") {
+        std::string name, type;
+        RGB_spectrum reflectance;
+        valid = static_cast<bool>(statement >> name >> type) &&
+                read_spectrum(statement, &reflectance);
+        if (valid && type == "lambertian") {
+          materials[name] = std::make_shared<Lambertian>(reflectance);
+        }
+        else if (valid && type == "mirror") {
+          materials[name] = std::make_shared<Mirror>(reflectance);
+        }
+        else if (valid) {
+          return fail("Unknown material type " + type);
+        }
+      }
+      else if (keyword == "identity") {
+        object_to_world = Transform();
+      }
+      else if (keyword == "translate") {
+        Vec3 delta;
+        valid = read_vec3(statement, &delta);
+        object_to_world = object_to_world * translate(delta);
+      }
+      else if (keyword == "rotate_x" || keyword == "rotate_y" || keyword == "rotate_z") {
+        float degrees;
+        valid = static_cast<bool>(statement >> degrees);
+        const Transform krotation = (keyword == "rotate_x") ? rotate_x(degrees) :
+                                    (keyword == "rotate_y") ? rotate_y(degrees) :
+                                                              rotate_z(degrees);
+        object_to_world = object_to_world * krotation;
+      }
+      else if (keyword == "scale") {
+        Vec3 factors;
+        valid = read_vec3(statement, &factors) && factors.x != 0.0f && factors.y != 0.0f &&
+                factors.z != 0.0f;
+        if (valid) object_to_world = object_to_world * scale(factors.x, factors.y, factors.z);
+      }
+      else if (keyword == "emission") {
+        valid = read_spectrum(statement, &emission);
+      }
+      else if (keyword == "sphere") {
+        std::shared_ptr<Material> pmaterial;
+        if (!find_material(&pmaterial)) return false;
+        float radius;
+        valid = static_cast<bool>(statement >> radius) && radius > 0.0f;
+        if (valid && pscene) {
+          pscene->add_shape(std::make_shared<Sphere>(object_to_world, pmaterial, emission,
+                                                     radius));
+        }
+      }
+      else if (keyword == "triangle") {
+        std::shared_ptr<Material> pmaterial;
+        if (!find_material(&pmaterial)) return false;
+        Vec3 v1, v2, v3;
+        valid = read_vec3(statement, &v1) && read_vec3(statement, &v2) &&
+                read_vec3(statement, &v3);
+        if (valid && pscene) {
+          pscene->add_shape(std::make_shared<Triangle>(object_to_world, pmaterial, emission,
+                                                       v1, v2, v3));
+        }
+      }
+      else if (keyword == "mesh") {
+        std::shared_ptr<Material> pmaterial;
+        if (!find_material(&pmaterial)) return false;
+        std::string mesh_path;
+        if (!(statement >> mesh_path)) return fail("Expected a mesh file");
+        if (mesh_path[0] != '/') mesh_path = directory_of(path) + mesh_path;
+        pdescription->mesh_paths.push_back(mesh_path);
+
+        if (pscene) {
+          Mesh_load_stats stats;
+          const std::shared_ptr<Triangle_mesh> kpmesh =
+              load_mesh(mesh_path, object_to_world, pmaterial, emission, &stats,
+                        settings.num_threads);
+          if (!kpmesh) return fail("Couldn't load the mesh " + mesh_path);
+
+          pscene->add_shape(kpmesh);
+          pdescription->mesh_stats.file_bytes += stats.file_bytes;
+          pdescription->mesh_stats.load_seconds += stats.load_seconds;
+        }
+      }
+      else if (keyword == "light") {
+        float radius;
+        RGB_spectrum radiance;
+        valid = static_cast<bool>(statement >> radius) && radius > 0.0f &&
+                read_spectrum(statement, &radiance);
+        if (valid && pscene) {
+          pscene->add_shape(std::make_shared<Sphere>(object_to_world, klight_material, radiance,
+                                                     radius));
+        }
+      }
+      else {
+        return fail("Unknown statement " + keyword);
+      }
+
+      if (!valid || !at_end(statement)) return fail("Malformed " + keyword + " statement");
+      if (builds_shapes(keyword)) append_statement(line, &pdescription->shape_statements);
+    }
+
+    return true;
+  }
+}
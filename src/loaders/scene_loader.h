@@ -0,0 +1,68 @@
+#ifndef LUX_LOADERS_SCENE_LOADER_H_
+#define LUX_LOADERS_SCENE_LOADER_H_
+
+#include <string>
+#include <vector>
+
+#include "core/post_process.h"
+#include "core/render_settings.h"
+#include "loaders/mesh_loader.h"
+
+namespace lux { class Scene; }
+
+namespace lux {
+  struct Scene_description {
+    Render_settings settings;
+    Mesh_load_stats mesh_stats;  // Summed over the meshes of the scene
+    std::vector<std::string> mesh_paths;
+
+    // The statements that build the shapes, from materials and transforms to the shapes,
+    // one per line with their words separated by single spaces. The scene cache is keyed
+    // on them, so editing the camera or the sampling settings keeps the cached scene.
+    std::string shape_statements;
+  };
+
+  // Parses the tonemap names of scene descriptions, returns false for unknown names
+  bool parse_tonemap(const std::string & name, Tonemap_operator * ptonemap);
+
+  // Reads a scene description, one statement per line, adding the shapes to pscene as
+  // they are read. Lines starting with '#' are comments. Statements that aren't given
+  // keep the defaults of Render_settings.
+  //
+  //   film <width> <height> [<output file>]
+  //   sampler <samples x> <samples y>
+  //   filter box | tent
+  //   integrator path <max depth>
+  //   clamp <max sample value>
+  //   exposure <stops>
+  //   tonemap clip | reinhard | aces
+  //   bits 8 | 16
+  //   threads <count>
+  //   camera <eye x y z> <look x y z> <fov> [<lens radius> <focal distance>]
+  //   shutter <open time> <close time>
+  //   material <name> lambertian | mirror <r g b>
+  //   accelerator sah | lbvh | sbvh [quantized]
+  //
+  // Shapes take the current transform and emission. The transform starts as the
+  // identity, each transform statement is applied after the ones before it.
+  //
+  //   identity
+  //   translate <x y z>
+  //   rotate_x | rotate_y | rotate_z <degrees>
+  //   scale <x y z>
+  //   emission <r g b>
+  //   sphere <material> <radius>
+  //   triangle <material> <v1 x y z> <v2 x y z> <v3 x y z>
+  //   mesh <material> <OBJ, PLY or mesh file, relative to the scene file>
+  //
+  // Lights are white Lambertian spheres that emit the given radiance.
+  //
+  //   light <radius> <r g b>
+  //
+  // If pscene is null only the settings, the mesh paths and the shape statements are read,
+  // without loading the meshes. Returns false on the first error, with its line in *perror.
+  bool load_scene_description(const std::string & path, Scene_description * pdescription,
+                              Scene * pscene, std::string * perror);
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include <cmath>
 #include <cstdint>
+#include <cstdlib>
+#include <cstdio>
 
 #include <string>
 #include <iostream>
@@ -9,6 +11,10 @@
 #include <iomanip>
 #include <algorithm>
 #include <memory>
+#include <chrono>
+#include <mutex>
+#include <future>
+#include <stdexcept>
 
 #include "core/camera.h"
 #include "core/mat4.h"
@@ -19,22 +25,27 @@
 #include "core/transform.h"
 #include "core/shape.h"
 #include "core/error.h"
-#include "core/filter.h"
+#include "core/film.h"
+#include "core/film_stream.h"
+#include "core/renderer.h"
+#include "core/image_writer.h"
 #include "core/scene.h"
 #include "core/integrator.h"
+#include "core/scene_cache.h"
+#include "core/resource_usage.h"
+#include "core/memory_stats.h"
+#include "core/render_stats.h"
+#include "core/trace.h"
+#include "core/cost_map.h"
+#include "core/parallel.h"
 
-#include "materials/lambertian.h"
-#include "materials/mirror.h"
+#include "accelerators/bvh.h"
 
-#include "shapes/sphere.h"
-#include "shapes/triangle.h"
+#include "loaders/scene_loader.h"
 
-#include "samplers/random.h"
-#include "samplers/stratified.h"
+#include "scenes/cornell_box.h"
+#include "scenes/stress_scenes.h"
 
-#include "integrators/path_tracer.h"
-
-const unsigned g_kmax_depth = 5;
 const bool g_direct_light_only = false;
 
 lux::RGB_spectrum skybox(const lux::Ray & r)
@@ -48,174 +59,564 @@ lux::RGB_spectrum skybox(const lux::Ray & r)
   return lux::lerp(t, s0, s1);
 }
 
-int main(int argc, char * argv[])
+void print_usage(const char * program)
 {
-  std::shared_ptr<lux::Lambertian> lambertian_red;
-  std::shared_ptr<lux::Lambertian> lambertian_blue;
-  std::shared_ptr<lux::Lambertian> lambertian_white;
-  std::shared_ptr<lux::Mirror> mirror;
-
-  lambertian_red = std::make_shared<lux::Lambertian>(lux::RGB_spectrum(.75f, .25f, .25f));
-  lambertian_blue = std::make_shared<lux::Lambertian>(lux::RGB_spectrum(.25f, .25f, .75f));
-  lambertian_white = std::make_shared<lux::Lambertian>(lux::RGB_spectrum(.75f));
-  mirror = std::make_shared<lux::Mirror>(lux::RGB_spectrum(0.999f));
-
-  // create Box
-  const float kbox_width = 4.0f;
-  const float khalf_box_width = kbox_width / 2.0f;
-
-  const lux::Vec3 kfloor[4] = {
-    lux::Vec3(khalf_box_width, 0.0f, -khalf_box_width),
-    lux::Vec3(-khalf_box_width, 0.0f, -khalf_box_width),
-    lux::Vec3(-khalf_box_width, 0.0f, khalf_box_width),
-    lux::Vec3(khalf_box_width, 0.0f, khalf_box_width)
-  };
+  std::cerr << "Usage: " << program << " [options] [scene file]\n"
+            << "Renders the scene file, see loaders/scene_loader.h, or a Cornell box.\n"
+            << "  --stress <type:count>  Renders a generated scene instead, spheres,\n"
+            << "                         tessellated_spheres, terrain, instances,\n"
+            << "                         moving_instances or lights\n"
+            << "  --spp <count>          Samples per pixel\n"
+            << "  --threads <count>      Render threads, 0 uses every core\n"
+            << "  --resolution <WxH>     Image resolution\n"
+            << "  --shutter <open:close> Times the shutter opens and closes, over which the\n"
+            << "                         moving instances are blurred\n"
+            << "  --output <file>        Output image, .ppm, .pfm, .exr or .float.exr, may\n"
+            << "                         be given more than once\n"
+            << "  --exposure <stops>     Exposure of the .ppm outputs\n"
+            << "  --tonemap <operator>   clip, reinhard or aces, for the .ppm outputs\n"
+            << "  --bits <8 or 16>       Bits per channel of the .ppm outputs\n"
+            << "  --stream               Write the outputs while rendering, keeping only the\n"
+            << "                         rows of tiles being rendered in memory\n"
+            << "  --stats <file>         Time the render phases and write the render stats\n"
+            << "                         as JSON\n"
+            << "  --trace <file>         Write a Chrome trace of the scene build, tiles and\n"
+            << "                         image writes, for chrome://tracing or Perfetto\n"
+            << "  --cost-map <file>      Write the render cost of each pixel, as a heat map\n"
+            << "                         for .ppm files and raw values otherwise. Holds\n"
+            << "                         the whole image in memory, even with --stream\n"
+            << "  --cost-metric <metric> time, the default, or steps, BVH tests\n"
+            << "  --adaptive-tiles       Split the costly tiles of the image, found by a\n"
+            << "                         small pilot render, so threads finish together\n"
+            << "  --bvh <builder>        sah, lbvh or sbvh, the default, SAH with spatial\n"
+            << "                         splits\n"
+            << "  --quantize-bvh         Store the BVH with 8 bit child bounds, to save memory\n"
+            << "  --compare-bvh          Also build a SAH BVH and print how many nodes camera\n"
+            << "                         rays visit in each\n"
+            << "  --scene-cache <dir>    Save the built scene and its BVH in dir, and load them\n"
+            << "                         from there when the same input is rendered again\n"
+            << "  --no-scene-cache       Neither load nor save a scene cache, the default\n";
+}
 
-  lux::Scene scene;
-  // floor
-  lux::RGB_spectrum kblack(0.0f);
-  scene.add_shape(std::make_shared<lux::Triangle>(lux::Transform(), lambertian_white, kblack,
-                                     kfloor[0], kfloor[1], kfloor[2]));
-  scene.add_shape(std::make_shared<lux::Triangle>(lux::Transform(), lambertian_white, kblack,
-                                     kfloor[2], kfloor[3], kfloor[0]));
-  // top
-  lux::Vec3 delta(0, kbox_width, 0.0f);
-  lux::Transform R = lux::rotate_x(180.0f);
-  lux::Transform T = lux::translate(delta);
-  lux::Transform obj_to_world = R * T;
-  scene.add_shape(std::make_shared<lux::Triangle>(obj_to_world, lambertian_white, kblack,
-                    kfloor[0], kfloor[1], kfloor[2]));
-  scene.add_shape(std::make_shared<lux::Triangle>(obj_to_world, lambertian_white, kblack,
-                                     kfloor[2], kfloor[3], kfloor[0]));
-
-  // left
-  delta = lux::Vec3(-khalf_box_width, khalf_box_width, 0.0f);
-  R = lux::rotate_z(-90.0f);
-  T = lux::translate(delta);
-  obj_to_world = R * T;
-  scene.add_shape(std::make_shared<lux::Triangle>(obj_to_world, lambertian_red, kblack,
-                    kfloor[0], kfloor[1], kfloor[2]));
-  scene.add_shape(std::make_shared<lux::Triangle>(obj_to_world, lambertian_red, kblack,
-                                     kfloor[2], kfloor[3], kfloor[0]));
-  // right
-  delta = lux::Vec3(khalf_box_width, khalf_box_width, 0.0f);
-  R = lux::rotate_z(90.0f);
-  T = lux::translate(delta);
-  obj_to_world = R * T;
-  scene.add_shape(std::make_shared<lux::Triangle>(obj_to_world, lambertian_blue, kblack,
-                    kfloor[0], kfloor[1], kfloor[2]));
-  scene.add_shape(std::make_shared<lux::Triangle>(obj_to_world, lambertian_blue, kblack,
-                                     kfloor[2], kfloor[3], kfloor[0]));
-
-  // back
-  delta = lux::Vec3(0.0f, khalf_box_width, khalf_box_width);
-  R = lux::rotate_x(-90.0f);
-  T = lux::translate(delta);
-  obj_to_world = R * T;
-  scene.add_shape(std::make_shared<lux::Triangle>(obj_to_world, lambertian_white, kblack,
-                    kfloor[0], kfloor[1], kfloor[2]));
-  scene.add_shape(std::make_shared<lux::Triangle>(obj_to_world, lambertian_white, kblack,
-                                     kfloor[2], kfloor[3], kfloor[0]));
-
-  const float kradius = 0.7f;
-  const float klight_radius = 0.18f;
-  const lux::Vec3 light_sphere_pos(0.0f, kbox_width - (klight_radius * 1.6f), 0.0f);
-  const lux::Vec3 sphere_pos(1.0f, kradius, 0.0f);
-  std::shared_ptr<lux::Lambertian> lambertian;
-
-  lambertian = std::make_shared<lux::Lambertian>(lux::RGB_spectrum(1.0f));
-
-  scene.add_shape(std::make_shared<lux::Sphere>(lux::translate(light_sphere_pos), lambertian,
-                                                lux::RGB_spectrum(115.0f), klight_radius));
-  scene.add_shape(std::make_shared<lux::Sphere>(lux::translate(sphere_pos),lambertian, kblack, kradius));
-  scene.add_shape(std::make_shared<lux::Sphere>(lux::translate(lux::Vec3(-0.8f, kradius, khalf_box_width * 0.5f)),
-                                   mirror, kblack, kradius));
-  
+// Settings given on the command line, which override the scene file's
+struct Command_line {
+  std::string scene_path;
+  bool has_stress_scene = false;
+  lux::Stress_scene_type stress_scene_type = lux::Stress_scene_type::krandom_spheres;
+  unsigned stress_scene_count = 0;
+  unsigned samples_per_pixel = 0;
+  bool has_num_threads = false;
+  unsigned num_threads = 0;
+  unsigned width = 0;
+  unsigned height = 0;
+  bool has_shutter = false;
+  float shutter_open = 0.0f;
+  float shutter_close = 0.0f;
+  std::vector<std::string> outputs;
+  bool has_exposure = false;
+  float exposure = 0.0f;
+  bool has_tonemap = false;
+  lux::Tonemap_operator tonemap = lux::Tonemap_operator::kclip;
+  unsigned bits_per_channel = 0;
+  bool stream = false;
+  std::string stats_path;
+  std::string trace_path;
+  std::string cost_map_path;
+  lux::Cost_metric cost_metric = lux::Cost_metric::ktime;
+  bool adaptive_tiles = false;
+  bool has_bvh_builder = false;
+  lux::BVH_builder bvh_builder = lux::BVH_builder::kspatial_sah;
+  bool quantize_bvh = false;
+  bool compare_bvh = false;
+  std::string scene_cache_dir;   // Empty without a scene cache
+};
+
+bool parse_unsigned(const char * text, unsigned * pvalue)
+{
+  char * pend;
+  const unsigned long kvalue = std::strtoul(text, &pend, 10);
+  if (pend == text || *pend != '\0' || text[0] == '-' ||
+      kvalue > std::numeric_limits<unsigned>::max()) {
+    return false;
+  }
+  *pvalue = static_cast<unsigned>(kvalue);
+  return true;
+}
 
-  // Set up image to render
-  const float kfov = 51.3f;
-  lux::Vec3 eye(0.0f, kbox_width * 0.56f, -khalf_box_width - 3.8f);
-  lux::Vec3 look(0.0f, kbox_width * 0.52f, khalf_box_width + 3.8f);
-  lux::Transform cam_to_world = look_at(eye, look);
-  //std::cout << cam_to_world << std::endl;
-  lux::Vec2 resolution(600, 600);
-  lux::Camera cam(resolution, cam_to_world, kfov);
-  lux::RGB_spectrum rendered_image[static_cast<int>(resolution.x)][static_cast<int>(resolution.y)];
+bool parse_command_line(int argc, char * argv[], Command_line * pcommand_line)
+{
+  for (int i = 1; i < argc; ++i) {
+    const std::string koption = argv[i];
+    if (koption[0] != '-') {
+      if (!pcommand_line->scene_path.empty()) return false;
+      pcommand_line->scene_path = koption;
+      continue;
+    }
+    if (koption == "--stream") {
+      pcommand_line->stream = true;
+      continue;
+    }
+    if (koption == "--adaptive-tiles") {
+      pcommand_line->adaptive_tiles = true;
+      continue;
+    }
+    if (koption == "--quantize-bvh") {
+      pcommand_line->quantize_bvh = true;
+      continue;
+    }
+    if (koption == "--compare-bvh") {
+      pcommand_line->compare_bvh = true;
+      continue;
+    }
+    if (koption == "--no-scene-cache") {
+      pcommand_line->scene_cache_dir.clear();
+      continue;
+    }
 
-  lux::Ray ray;
+    if (i + 1 == argc) return false;
+    const char * kvalue = argv[++i];
+    if (koption == "--stress") {
+      const std::string kstress = kvalue;
+      const std::string::size_type kcolon = kstress.find(':');
+      if (kcolon == std::string::npos ||
+          !lux::parse_stress_scene_type(kstress.substr(0, kcolon),
+                                        &pcommand_line->stress_scene_type) ||
+          !parse_unsigned(kstress.substr(kcolon + 1).c_str(),
+                          &pcommand_line->stress_scene_count)) {
+        return false;
+      }
+      pcommand_line->has_stress_scene = true;
+    }
+    else if (koption == "--spp") {
+      if (!parse_unsigned(kvalue, &pcommand_line->samples_per_pixel) ||
+          pcommand_line->samples_per_pixel == 0) {
+        return false;
+      }
+    }
+    else if (koption == "--threads") {
+      if (!parse_unsigned(kvalue, &pcommand_line->num_threads)) return false;
+      pcommand_line->has_num_threads = true;
+    }
+    else if (koption == "--resolution") {
+      const std::string kresolution = kvalue;
+      const std::string::size_type kx = kresolution.find('x');
+      if (kx == std::string::npos ||
+          !parse_unsigned(kresolution.substr(0, kx).c_str(), &pcommand_line->width) ||
+          !parse_unsigned(kresolution.substr(kx + 1).c_str(), &pcommand_line->height) ||
+          pcommand_line->width == 0 || pcommand_line->height == 0) {
+        return false;
+      }
+    }
+    else if (koption == "--shutter") {
+      char * pend;
+      pcommand_line->shutter_open = std::strtof(kvalue, &pend);
+      if (pend == kvalue || *pend != ':') return false;
+      const char * kclose = pend + 1;
+      pcommand_line->shutter_close = std::strtof(kclose, &pend);
+      if (pend == kclose || *pend != '\0' ||
+          pcommand_line->shutter_open > pcommand_line->shutter_close) {
+        return false;
+      }
+      pcommand_line->has_shutter = true;
+    }
+    else if (koption == "--output") {
+      lux::Image_format format;
+      if (!lux::image_format_from_path(kvalue, &format)) return false;
+      pcommand_line->outputs.push_back(kvalue);
+    }
+    else if (koption == "--stats") {
+      pcommand_line->stats_path = kvalue;
+    }
+    else if (koption == "--trace") {
+      pcommand_line->trace_path = kvalue;
+    }
+    else if (koption == "--cost-map") {
+      lux::Image_format format;
+      if (!lux::image_format_from_path(kvalue, &format)) return false;
+      pcommand_line->cost_map_path = kvalue;
+    }
+    else if (koption == "--scene-cache") {
+      pcommand_line->scene_cache_dir = kvalue;
+      if (pcommand_line->scene_cache_dir.empty()) return false;
+    }
+    else if (koption == "--bvh") {
+      if (!lux::parse_bvh_builder(kvalue, &pcommand_line->bvh_builder)) return false;
+      pcommand_line->has_bvh_builder = true;
+    }
+    else if (koption == "--cost-metric") {
+      if (!lux::parse_cost_metric(kvalue, &pcommand_line->cost_metric)) return false;
+    }
+    else if (koption == "--exposure") {
+      char * pend;
+      pcommand_line->exposure = std::strtof(kvalue, &pend);
+      if (pend == kvalue || *pend != '\0') return false;
+      pcommand_line->has_exposure = true;
+    }
+    else if (koption == "--tonemap") {
+      if (!lux::parse_tonemap(kvalue, &pcommand_line->tonemap)) return false;
+      pcommand_line->has_tonemap = true;
+    }
+    else if (koption == "--bits") {
+      if (!parse_unsigned(kvalue, &pcommand_line->bits_per_channel) ||
+          (pcommand_line->bits_per_channel != 8 && pcommand_line->bits_per_channel != 16)) {
+        return false;
+      }
+    }
+    else {
+      return false;
+    }
+  }
 
-  // 256 samples = 16 x 16
-  // 64 samples = 8 x 8
-  const int ksamples_per_pixel = 64;
-  const int ksamples_x = 8;
-  const int ksamples_y = 8;
+  return true;
+}
 
-  const float kinv_samples_per_pixel = 1.0f / static_cast<float>(ksamples_per_pixel);
+// The stratified sampler needs a grid of samples, this picks the most square one with
+// exactly samples_per_pixel samples.
+void set_samples_per_pixel(const unsigned samples_per_pixel, lux::Render_settings * psettings)
+{
+  unsigned samples_x = static_cast<unsigned>(std::sqrt(static_cast<float>(samples_per_pixel)));
+  while (samples_per_pixel % samples_x != 0) --samples_x;
 
-  lux::Stratified_sampler stratified_sampler(ksamples_x, ksamples_y, 2, true);
+  psettings->samples_x = samples_x;
+  psettings->samples_y = samples_per_pixel / samples_x;
+}
 
-  lux::Sampler *pintegrator_sampler = new lux::Stratified_sampler(ksamples_x, ksamples_y,
-                                                                  g_kmax_depth * 3, true);
+// Adds the scene given on the command line to pscene and sets the settings of
+// pdescription. If pscene is null only the settings are read.
+bool add_scene(const Command_line & command_line, lux::Scene_description * pdescription,
+               lux::Scene * pscene)
+{
+  std::string error;
+  try {
+    if (command_line.has_stress_scene) {
+      lux::add_stress_scene(command_line.stress_scene_type, command_line.stress_scene_count,
+                            pscene, &pdescription->settings);
+    }
+    else if (command_line.scene_path.empty()) {
+      lux::add_cornell_box(pscene, &pdescription->settings);
+    }
+    else if (!lux::load_scene_description(command_line.scene_path, pdescription, pscene,
+                                          &error)) {
+      std::cerr << error << std::endl;
+      return false;
+    }
+  }
+  catch (const std::length_error & exception) {
+    // Thrown when a shape table is full
+    std::cerr << "Couldn't add the scene: " << exception.what() << std::endl;
+    return false;
+  }
 
-  lux::Path_tracer path_tracer(pintegrator_sampler, g_kmax_depth);
+  return true;
+}
 
-  const int num_pixels = resolution.x * resolution.y;
-  std::string progress_bar("\r[");
-  progress_bar += std::string(100, '-') + "]";
-   
-  float prev = 0.0f;
+void apply_command_line(const Command_line & command_line, lux::Render_settings * psettings)
+{
+  if (command_line.samples_per_pixel) {
+    set_samples_per_pixel(command_line.samples_per_pixel, psettings);
+  }
+  if (command_line.has_num_threads) psettings->num_threads = command_line.num_threads;
+  psettings->display.num_threads = psettings->num_threads;
+  if (command_line.has_exposure) psettings->display.exposure = command_line.exposure;
+  if (command_line.has_tonemap) psettings->display.tonemap = command_line.tonemap;
+  if (command_line.bits_per_channel) {
+    psettings->display.bits_per_channel = command_line.bits_per_channel;
+  }
+  if (command_line.has_bvh_builder) psettings->bvh_builder = command_line.bvh_builder;
+  if (command_line.quantize_bvh) psettings->quantize_bvh = true;
+  if (command_line.width) {
+    psettings->width = command_line.width;
+    psettings->height = command_line.height;
+  }
+  if (command_line.has_shutter) {
+    psettings->shutter_open = command_line.shutter_open;
+    psettings->shutter_close = command_line.shutter_close;
+  }
+}
 
-  lux::Vec2 (*pfilter) (const lux::Vec2 &) = lux::box_filter;
-  lux::Camera_sample camera_sample;
-  for (unsigned h = 0; h != resolution.y; ++h) {
-    for (unsigned w = 0; w != resolution.x; ++w) {
-      stratified_sampler.start_pixel();
-      lux::RGB_spectrum pixel_color;
-      lux::RGB_spectrum sample_color;
+// Instances share a bottom level BVH, which scene caches don't hold
+bool can_cache_scene(const Command_line & command_line)
+{
+  return !command_line.has_stress_scene ||
+         (command_line.stress_scene_type != lux::Stress_scene_type::kinstanced_grid &&
+          command_line.stress_scene_type != lux::Stress_scene_type::kmoving_instances);
+}
 
-      do {
-        const lux::Vec2 k2D_sample = stratified_sampler.get_2D();
-        const lux::Vec2 k2D_filtered_sample = pfilter(k2D_sample);
+// Hashes the input the shapes are built from, the generated scene or the shape statements of
+// the scene file and its meshes, before building them. Returns 0 without a scene cache or if
+// the scene can't be cached, without reading the meshes.
+std::uint64_t scene_input_hash(const Command_line & command_line,
+                               const lux::Scene_description & description,
+                               const lux::BVH_build_options & bvh_options)
+{
+  if (command_line.scene_cache_dir.empty()) return 0;
+  if (!can_cache_scene(command_line)) {
+    std::cerr << "Scenes with instances can't be cached, --scene-cache is ignored"
+              << std::endl;
+    return 0;
+  }
 
-        camera_sample.raster_coord = lux::Vec2(w + k2D_filtered_sample.x,
-                                                     h + (1.0f - k2D_filtered_sample.y));  
-        camera_sample.lens_coord = stratified_sampler.get_2D();
+  std::string input;
+  std::vector<std::string> files;
+  if (command_line.has_stress_scene) {
+    input = std::string("stress ") + lux::stress_scene_name(command_line.stress_scene_type) +
+            ":" + std::to_string(command_line.stress_scene_count);
+  }
+  else if (command_line.scene_path.empty()) {
+    input = "cornell box";
+  }
+  else {
+    input = "scene file\n" + description.shape_statements;
+    files = description.mesh_paths;
+  }
 
-        ray = cam.generate_ray(camera_sample);
+  return lux::scene_input_hash(input, files, bvh_options);
+}
 
-        sample_color = lux::clamp(path_tracer.li(scene, ray));
-        pixel_color += sample_color * kinv_samples_per_pixel; 
-      } while (stratified_sampler.start_next_sample());
+void save_trace(const Command_line & command_line)
+{
+  if (!lux::g_tracing) return;
 
-      rendered_image[w][h] = pixel_color;
+  if (lux::write_trace(command_line.trace_path)) {
+    std::cout << "Trace: " << command_line.trace_path << std::endl;
+  }
+  else {
+    std::cerr << "Couldn't write " << command_line.trace_path << std::endl;
+  }
+}
 
-      int pixels_written = h * resolution.x + w + 1;
-      float remaining = static_cast<float>(pixels_written * 100) / num_pixels;
-      if (remaining  - prev >= 0.2f) {
-        progress_bar[remaining +2] = '+';
+int main(int argc, char * argv[])
+{
+  Command_line command_line;
+  if (!parse_command_line(argc, argv, &command_line)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (!command_line.trace_path.empty()) {
+#if TRACING_ENABLED
+    lux::enable_tracing();
+#else
+    std::cerr << "lux was built with TRACING=OFF, --trace is ignored" << std::endl;
+#endif
+  }
+
+  // The settings are read first, the shapes are only built if the scene cache misses
+  lux::Scene_description description;
+  lux::Render_settings & settings = description.settings;
+  if (!add_scene(command_line, &description, nullptr)) return 1;
+  apply_command_line(command_line, &settings);
+
+  const unsigned ksamples_per_pixel = settings.samples_x * settings.samples_y;
+  const unsigned knum_threads = settings.num_threads ? settings.num_threads
+                                                     : lux::num_system_cores();
+  if (settings.output.empty()) {
+    settings.output = "parallel_cornell_box_" + std::to_string(ksamples_per_pixel) + ".ppm";
+  }
+  const std::vector<std::string> outputs = command_line.outputs.empty()
+                                           ? std::vector<std::string>(1, settings.output)
+                                           : command_line.outputs;
+  std::vector<lux::Image_format> formats(outputs.size());
+  for (std::size_t i = 0; i != outputs.size(); ++i) {
+    if (!lux::image_format_from_path(outputs[i], &formats[i])) {
+      std::cerr << "Unknown image format: " << outputs[i] << std::endl;
+      return 1;
+    }
+  }
+
+  const lux::BVH_build_options bvh_options = lux::bvh_build_options(settings);
+
+  // Reuse the scene and BVH of an earlier run of the same input when there is one
+  const std::chrono::steady_clock::time_point kfinalize_start = std::chrono::steady_clock::now();
+  lux::Scene scene;
+  const std::uint64_t kscene_hash = scene_input_hash(command_line, description, bvh_options);
+  const std::string kscene_cache = lux::scene_cache_path(command_line.scene_cache_dir,
+                                                         kscene_hash);
+  const bool kcache_hit = kscene_hash != 0 &&
+                          lux::load_scene_cache(kscene_cache, kscene_hash, bvh_options, &scene);
+  if (!kcache_hit) {
+    // The settings were read already, with the command line applied to them
+    lux::Scene_description built;
+    if (!add_scene(command_line, &built, &scene)) return 1;
+    if (built.mesh_stats.file_bytes != 0) {
+      std::cout << "Meshes: " << built.mesh_stats << std::endl;
+    }
+
+    // The cache holds full precision nodes, which are quantized once saved, as on load
+    lux::BVH_build_options build_options = bvh_options;
+    if (kscene_hash != 0) build_options.quantize_nodes = false;
+    scene.finalize(build_options);
+    if (kscene_hash != 0) {
+      if (!lux::save_scene_cache(kscene_cache, kscene_hash, scene)) {
+        std::cerr << "Couldn't write the scene cache " << kscene_cache << std::endl;
+      }
+      if (bvh_options.quantize_nodes) scene.quantize_accelerator();
+    }
+  }
+  const std::chrono::duration<double> kfinalize_time =
+      std::chrono::steady_clock::now() - kfinalize_start;
+
+  std::cout << "Scene: " << (kcache_hit ? "loaded from " + kscene_cache : "built") << " in "
+            << kfinalize_time.count() * 1000.0 << " ms" << std::endl;
+  std::cout << "BVH: " << scene.get_accelerator()->get_build_stats() << std::endl;
+  if (settings.quantize_bvh && !scene.get_accelerator()->is_quantized()) {
+    std::cerr << "Too many shape references to quantize the BVH, it keeps full precision nodes"
+              << std::endl;
+  }
+
+  // Set up image to render
+  const lux::Transform kcam_to_world = look_at(settings.eye, settings.look);
+  const lux::Vec2 resolution(settings.width, settings.height);
+  const lux::Camera cam(resolution, kcam_to_world, settings.fov, settings.lens_radius,
+                        settings.focal_distance, settings.shutter_open, settings.shutter_close);
+
+  if (command_line.compare_bvh) {
+    // Compare against a SAH BVH, tracing camera rays through at most 1024 x 1024 evenly
+    // spaced pixels
+    const unsigned kstep = std::max(settings.width, settings.height) / 1024 + 1;
+    std::vector<lux::Ray> camera_rays;
+    lux::Camera_sample pixel_center;
+    pixel_center.lens_coord = lux::Vec2(0.5f, 0.5f);
+    pixel_center.time = 0.0f;
+    for (unsigned h = 0; h < settings.height; h += kstep) {
+      for (unsigned w = 0; w < settings.width; w += kstep) {
+        pixel_center.raster_coord = lux::Vec2(w + 0.5f, h + 0.5f);
+        camera_rays.push_back(cam.generate_ray(pixel_center));
+      }
+    }
+
+    const lux::BVH ksah_bvh(scene.get_shapes());
+    const float ksah_visits = lux::average_node_visits(ksah_bvh, camera_rays);
+    const float kvisits = lux::average_node_visits(*scene.get_accelerator(), camera_rays);
+    std::cout << "BVH: " << kvisits << " nodes visited per camera ray, "
+              << ksah_visits << " with the SAH builder ("
+              << 100.0f * (1.0f - kvisits / ksah_visits) << "% fewer)" << std::endl;
+  }
+
+  // A streamed film allocates its bands as they are rendered. Bands are written by the
+  // render thread that completes them while the others keep rendering, so their post
+  // processing runs on that thread only.
+  lux::Film film(settings.width, settings.height, lux::Film::kdefault_tile_size,
+                 !command_line.stream);
+  std::vector<std::unique_ptr<lux::Image_stream>> streams;
+  if (command_line.stream) {
+    lux::Post_process_options stream_display = settings.display;
+    stream_display.num_threads = 1;
+    for (std::size_t i = 0; i != outputs.size(); ++i) {
+      streams.push_back(std::unique_ptr<lux::Image_stream>(
+          new lux::Image_stream(outputs[i], formats[i], settings.width, settings.height,
+                                stream_display)));
+    }
+  }
+  std::vector<unsigned> tile_splits;
+  if (command_line.adaptive_tiles) {
+    const std::chrono::steady_clock::time_point kplan_start = std::chrono::steady_clock::now();
+    tile_splits = lux::plan_tile_splits(scene, settings, film.get_tile_size());
+    const std::chrono::duration<double> kplan_time =
+        std::chrono::steady_clock::now() - kplan_start;
+    std::cout << "Tiles: split planned in " << kplan_time.count() * 1000.0 << " ms"
+              << std::endl;
+  }
+  lux::Film_stream film_stream(&film, std::move(streams), tile_splits, knum_threads);
+
+  std::string progress_bar("\r[");
+  progress_bar += std::string(100, '-') + "]";
+  std::mutex progress_mutex;
+
+  std::cout << "Render: " << settings.width << "x" << settings.height << ", "
+            << ksamples_per_pixel << " spp, " << knum_threads << " threads, "
+            << film.num_tiles() << " tiles in " << film_stream.num_regions() << " regions"
+            << std::endl;
+  const lux::Resource_usage krender_start_usage = lux::get_resource_usage();
+  const std::chrono::steady_clock::time_point krender_start = std::chrono::steady_clock::now();
+
+  lux::g_time_render_phases = !command_line.stats_path.empty();
+  lux::Render_stats render_stats;
+  std::unique_ptr<lux::Cost_map> pcost_map;
+  if (!command_line.cost_map_path.empty()) {
+    pcost_map.reset(new lux::Cost_map(settings.width, settings.height, command_line.cost_metric));
+  }
+  lux::render(scene, settings, &film_stream, 0, [&](const unsigned regions_done)
+      {
+        const unsigned kpercent_done = 100 * regions_done / film_stream.num_regions();
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        for (unsigned i = 0; i != kpercent_done; ++i) progress_bar[i + 2] = '+';
         fputs(progress_bar.c_str(), stdout);
         fflush(stdout);
-        //progress_bar.replace(1, remaining, remaining, '#');
-        // std::cout << "\r" << progress_bar << " " <<  std::setprecision(4) << remaining 
-        //   << std::flush;
-        prev = remaining;
-      }
+      }, &render_stats, pcost_map.get());
+  const std::chrono::duration<double> krender_time =
+      std::chrono::steady_clock::now() - krender_start;
+  std::cout << "\nRender: " << lux::get_resource_usage() - krender_start_usage << std::endl;
+  lux::print_render_stats(std::cout, render_stats, krender_time.count());
+
+  // A streamed film holds at most its peak bands at once
+  lux::Memory_stats memory_stats;
+  lux::add_scene_memory(scene, &memory_stats);
+  memory_stats.add(lux::Memory_category::ksampler_memory, render_stats.sampler_bytes);
+  memory_stats.add(lux::Memory_category::kfilm_memory,
+                   render_stats.tile_bytes + (command_line.stream
+                                              ? film_stream.peak_band_bytes()
+                                              : film.num_bands() * film.band_bytes()));
+  std::cout << "Memory: " << memory_stats.total_bytes() / (1024.0 * 1024.0)
+            << " MiB accounted for\n" << memory_stats;
+  if (!command_line.stats_path.empty()) {
+    std::ofstream stats_file(command_line.stats_path);
+    lux::write_render_stats_json(stats_file, render_stats, krender_time.count(),
+                                 &memory_stats);
+    if (!stats_file) std::cerr << "Couldn't write " << command_line.stats_path << std::endl;
+  }
+  if (pcost_map) {
+    lux::Image_format format;
+    lux::image_format_from_path(command_line.cost_map_path, &format);
+    lux::Film cost_film(settings.width, settings.height);
+    pcost_map->to_film(format == lux::Image_format::kppm, &cost_film);
+    if (lux::write_image(command_line.cost_map_path, cost_film, format,
+                         lux::Post_process_options())) {
+      std::cout << "Cost map: " << command_line.cost_map_path << std::endl;
+    }
+    else {
+      std::cerr << "Couldn't write " << command_line.cost_map_path << std::endl;
     }
   }
 
-  const std::string file_name = "parallel_cornell_box_" + std::to_string(ksamples_per_pixel) + ".ppm";
-  std::ofstream file(file_name);
-  file << "P3\n" << static_cast<int>(resolution.x) << " " << static_cast<int>(resolution.y)
-       << "\n255\n";
-  for (unsigned h = 0; h != resolution.y; ++h) {
-    for (unsigned w = 0; w != resolution.x; ++w) {
-      file << static_cast<int>(sqrt(rendered_image[w][h][0]) * 255.9f) << " "
-           << static_cast<int>(sqrt(rendered_image[w][h][1]) * 255.9f) << " "
-           << static_cast<int>(sqrt(rendered_image[w][h][2]) * 255.9f) << '\n';
+  if (command_line.stream) {
+    std::vector<lux::Image_write_stats> write_stats;
+    const bool kwritten = film_stream.close(&write_stats);
+    std::cout << "Film: at most " << film_stream.peak_band_bytes() / (1024.0 * 1024.0)
+              << " MiB of " << film.num_bands() * film.band_bytes() / (1024.0 * 1024.0)
+              << " MiB held while streaming" << std::endl;
+    for (std::size_t i = 0; i != outputs.size(); ++i) {
+      std::cout << "Output: " << outputs[i] << ", " << write_stats[i] << std::endl;
     }
+    if (!kwritten) std::cerr << "Couldn't write the outputs" << std::endl;
+    save_trace(command_line);
+
+    return kwritten ? 0 : 1;
+  }
+
+  // Every output is written on its own thread
+  const std::chrono::steady_clock::time_point kwrite_start = std::chrono::steady_clock::now();
+  std::vector<std::future<bool>> writes;
+  std::vector<lux::Image_write_stats> write_stats(outputs.size());
+  for (std::size_t i = 0; i != outputs.size(); ++i) {
+    writes.push_back(lux::write_image_async(outputs[i], film, formats[i], settings.display,
+                                            &write_stats[i]));
   }
 
-  std::cout << std::endl;
+  int exit_code = 0;
+  for (std::size_t i = 0; i != writes.size(); ++i) {
+    if (writes[i].get()) {
+      std::cout << "Output: " << outputs[i] << ", " << write_stats[i] << std::endl;
+    }
+    else {
+      std::cerr << "Couldn't write " << outputs[i] << std::endl;
+      exit_code = 1;
+    }
+  }
+  const std::chrono::duration<double> kwrite_time =
+      std::chrono::steady_clock::now() - kwrite_start;
+  std::cout << "Output: " << outputs.size() << " images written in "
+            << kwrite_time.count() * 1000.0 << " ms" << std::endl;
+  save_trace(command_line);
 
-  return 0;
+  return exit_code;
 }
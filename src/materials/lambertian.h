@@ -1,6 +1,8 @@
 #ifndef LUX_MATERIALS_LAMBERTIAN_H_
 #define LUX_MATERIALS_LAMBERTIAN_H_
 
+#include <cstddef>
+
 #include "core/rgb_spectrum.h"
 #include "core/math.h"
 #include "core/vec3.h"
@@ -11,10 +13,15 @@ namespace lux {
     public:
       Lambertian(const RGB_spectrum &  R) : Material(Material_type::kdiffuse), m_R(R) {}
 
-      RGB_spectrum f(const Vec3 & wo_world, const Vec3 & wi_world) const override
+      RGB_spectrum f(const Surface_interaction & interaction, const Vec3 & wo_world,
+                     const Vec3 & wi_world) const override
       { 
         return kinv_pi * m_R;
       }
+
+      std::size_t memory_bytes() const override { return sizeof(*this); }
+
+      const RGB_spectrum & get_reflectance() const { return m_R; }
     private:
       RGB_spectrum m_R;
   };
@@ -7,24 +7,27 @@
 
 namespace lux {
 
-  RGB_spectrum Mirror::sample_f(const Vec3 & wo_world, Vec3 * pwi_world, const Vec2 & sample,
+  RGB_spectrum Mirror::sample_f(const Surface_interaction & interaction,
+                                const Vec3 & wo_world, Vec3 * pwi_world, const Vec2 & sample,
                                 float * pdf) const
   {
-    Vec3 wo = world_to_shading(wo_world);
+    Vec3 wo = world_to_shading(interaction, wo_world);
     Vec3 wi = reflect(wo);
 
-    *pwi_world = shading_to_world(wi);
+    *pwi_world = shading_to_world(interaction, wi);
     *pdf = 1.0f;
 
     return m_R / abs_cos_theta(wi);
   }
   
-  RGB_spectrum Mirror::f(const Vec3 & wo_world, const Vec3 & wi_world) const
+  RGB_spectrum Mirror::f(const Surface_interaction & interaction, const Vec3 & wo_world,
+                         const Vec3 & wi_world) const
   {
     return RGB_spectrum(0.0f);
   }
 
-  float Mirror::PDF(const Vec3 & wo_world, const Vec3 & wi_world) const
+  float Mirror::PDF(const Surface_interaction & interaction, const Vec3 & wo_world,
+                    const Vec3 & wi_world) const
   {
     return 0.0f;
   }
@@ -1,6 +1,8 @@
 #ifndef LUX_MATERIALS_MIRROR_H_
 #define LUX_MATERIALS_MIRROR_H_
 
+#include <cstddef>
+
 #include "core/material.h"
 #include "core/rgb_spectrum.h"
 
@@ -11,10 +13,17 @@ namespace lux {
     public:
       Mirror(const RGB_spectrum & R) : Material(Material_type::kspecular), m_R(R) {}
 
-      virtual RGB_spectrum f(const Vec3 & wo_world, const Vec3 & wi_world) const override;
-      virtual RGB_spectrum sample_f(const Vec3 & wo_world, Vec3 * pwi_world, const Vec2 & sample,
-                                    float * pdf) const override;
-      virtual float PDF(const Vec3 & wo_world, const Vec3 & wi_world) const override;
+      virtual RGB_spectrum f(const Surface_interaction & interaction, const Vec3 & wo_world,
+                             const Vec3 & wi_world) const override;
+      virtual RGB_spectrum sample_f(const Surface_interaction & interaction,
+                                    const Vec3 & wo_world, Vec3 * pwi_world,
+                                    const Vec2 & sample, float * pdf) const override;
+      virtual float PDF(const Surface_interaction & interaction, const Vec3 & wo_world,
+                        const Vec3 & wi_world) const override;
+
+      virtual std::size_t memory_bytes() const override { return sizeof(*this); }
+
+      const RGB_spectrum & get_reflectance() const { return m_R; }
     private:
       RGB_spectrum m_R;
   };
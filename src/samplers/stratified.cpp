@@ -8,8 +8,9 @@ namespace lux {
   Stratified_sampler::Stratified_sampler(const unsigned x_pixel_samples,
                                          const unsigned y_pixel_samples,
                                          const unsigned dimensions_per_sample,
-                                         const bool jittered_samples)
-      : Pixel_sampler(x_pixel_samples * y_pixel_samples, dimensions_per_sample),
+                                         const bool jittered_samples,
+                                         const unsigned long long seed)
+      : Pixel_sampler(x_pixel_samples * y_pixel_samples, dimensions_per_sample, seed),
         m_x_pixel_samples(x_pixel_samples),
         m_y_pixel_samples(y_pixel_samples),
         m_jittered_samples(jittered_samples) {}
@@ -4,12 +4,14 @@
 #include <cstdint>
 
 #include "core/pixel_sampler.h"
+#include "core/rng.h"
 
 namespace lux {
   class Stratified_sampler : public Pixel_sampler {
     public:
       Stratified_sampler(const unsigned x_pixel_samples, const unsigned y_pixel_samples,
-                         const unsigned dimensions_per_sample, const bool jittered_samples);
+                         const unsigned dimensions_per_sample, const bool jittered_samples,
+                         const unsigned long long seed = kdefault_rng_seed);
 
       virtual void start_pixel() override;
 
@@ -0,0 +1,106 @@
+#include "scenes/cornell_box.h"
+
+#include <memory>
+
+#include "core/scene.h"
+#include "core/vec3.h"
+#include "core/transform.h"
+#include "core/rgb_spectrum.h"
+#include "materials/lambertian.h"
+#include "materials/mirror.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+#include "core/render_settings.h"
+
+namespace lux {
+  void add_cornell_box(Scene * pscene, Render_settings * psettings)
+  {
+    const float kbox_width = 4.0f;
+    const float khalf_box_width = kbox_width / 2.0f;
+
+    psettings->eye = Vec3(0.0f, kbox_width * 0.56f, -khalf_box_width - 3.8f);
+    psettings->look = Vec3(0.0f, kbox_width * 0.52f, khalf_box_width + 3.8f);
+    psettings->fov = 51.3f;
+    if (!pscene) return;
+
+    std::shared_ptr<Lambertian> lambertian_red;
+    std::shared_ptr<Lambertian> lambertian_blue;
+    std::shared_ptr<Lambertian> lambertian_white;
+    std::shared_ptr<Mirror> mirror;
+
+    lambertian_red = std::make_shared<Lambertian>(RGB_spectrum(.75f, .25f, .25f));
+    lambertian_blue = std::make_shared<Lambertian>(RGB_spectrum(.25f, .25f, .75f));
+    lambertian_white = std::make_shared<Lambertian>(RGB_spectrum(.75f));
+    mirror = std::make_shared<Mirror>(RGB_spectrum(0.999f));
+
+    // create Box
+    const Vec3 kfloor[4] = {
+      Vec3(khalf_box_width, 0.0f, -khalf_box_width),
+      Vec3(-khalf_box_width, 0.0f, -khalf_box_width),
+      Vec3(-khalf_box_width, 0.0f, khalf_box_width),
+      Vec3(khalf_box_width, 0.0f, khalf_box_width)
+    };
+
+    Scene & scene = *pscene;
+    // floor
+    RGB_spectrum kblack(0.0f);
+    scene.add_shape(std::make_shared<Triangle>(Transform(), lambertian_white, kblack,
+                                               kfloor[0], kfloor[1], kfloor[2]));
+    scene.add_shape(std::make_shared<Triangle>(Transform(), lambertian_white, kblack,
+                                               kfloor[2], kfloor[3], kfloor[0]));
+    // top
+    Vec3 delta(0, kbox_width, 0.0f);
+    Transform R = rotate_x(180.0f);
+    Transform T = translate(delta);
+    Transform obj_to_world = R * T;
+    scene.add_shape(std::make_shared<Triangle>(obj_to_world, lambertian_white, kblack,
+                                               kfloor[0], kfloor[1], kfloor[2]));
+    scene.add_shape(std::make_shared<Triangle>(obj_to_world, lambertian_white, kblack,
+                                               kfloor[2], kfloor[3], kfloor[0]));
+
+    // left
+    delta = Vec3(-khalf_box_width, khalf_box_width, 0.0f);
+    R = rotate_z(-90.0f);
+    T = translate(delta);
+    obj_to_world = R * T;
+    scene.add_shape(std::make_shared<Triangle>(obj_to_world, lambertian_red, kblack,
+                                               kfloor[0], kfloor[1], kfloor[2]));
+    scene.add_shape(std::make_shared<Triangle>(obj_to_world, lambertian_red, kblack,
+                                               kfloor[2], kfloor[3], kfloor[0]));
+    // right
+    delta = Vec3(khalf_box_width, khalf_box_width, 0.0f);
+    R = rotate_z(90.0f);
+    T = translate(delta);
+    obj_to_world = R * T;
+    scene.add_shape(std::make_shared<Triangle>(obj_to_world, lambertian_blue, kblack,
+                                               kfloor[0], kfloor[1], kfloor[2]));
+    scene.add_shape(std::make_shared<Triangle>(obj_to_world, lambertian_blue, kblack,
+                                               kfloor[2], kfloor[3], kfloor[0]));
+
+    // back
+    delta = Vec3(0.0f, khalf_box_width, khalf_box_width);
+    R = rotate_x(-90.0f);
+    T = translate(delta);
+    obj_to_world = R * T;
+    scene.add_shape(std::make_shared<Triangle>(obj_to_world, lambertian_white, kblack,
+                                               kfloor[0], kfloor[1], kfloor[2]));
+    scene.add_shape(std::make_shared<Triangle>(obj_to_world, lambertian_white, kblack,
+                                               kfloor[2], kfloor[3], kfloor[0]));
+
+    const float kradius = 0.7f;
+    const float klight_radius = 0.18f;
+    const Vec3 light_sphere_pos(0.0f, kbox_width - (klight_radius * 1.6f), 0.0f);
+    const Vec3 sphere_pos(1.0f, kradius, 0.0f);
+    const Vec3 mirror_sphere_pos(-0.8f, kradius, khalf_box_width * 0.5f);
+    std::shared_ptr<Lambertian> lambertian;
+
+    lambertian = std::make_shared<Lambertian>(RGB_spectrum(1.0f));
+
+    scene.add_shape(std::make_shared<Sphere>(translate(light_sphere_pos), lambertian,
+                                             RGB_spectrum(115.0f), klight_radius));
+    scene.add_shape(std::make_shared<Sphere>(translate(sphere_pos), lambertian, kblack,
+                                             kradius));
+    scene.add_shape(std::make_shared<Sphere>(translate(mirror_sphere_pos), mirror, kblack,
+                                             kradius));
+  }
+}
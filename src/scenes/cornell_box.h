@@ -0,0 +1,13 @@
+#ifndef LUX_SCENES_CORNELL_BOX_H_
+#define LUX_SCENES_CORNELL_BOX_H_
+
+namespace lux { class Scene; struct Render_settings; }
+
+namespace lux {
+  // Adds the Cornell box lux renders when no scene file is given, a diffuse and a mirror
+  // sphere lit by a small spherical light, and sets the camera of psettings to look at it.
+  // Only the camera is set if pscene is null.
+  void add_cornell_box(Scene * pscene, Render_settings * psettings);
+}
+
+#endif
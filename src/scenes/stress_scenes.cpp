@@ -0,0 +1,322 @@
+#include "scenes/stress_scenes.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "core/scene.h"
+#include "core/vec3.h"
+#include "core/transform.h"
+#include "core/animated_transform.h"
+#include "core/rgb_spectrum.h"
+#include "core/material.h"
+#include "core/rng.h"
+#include "core/render_settings.h"
+#include "accelerators/bvh.h"
+#include "materials/lambertian.h"
+#include "materials/mirror.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+#include "shapes/triangle_mesh.h"
+#include "shapes/instance.h"
+
+namespace lux {
+  namespace {
+    const char * const kscene_names[knum_stress_scene_types] = {
+      "spheres", "tessellated_spheres", "terrain", "instances", "moving_instances", "lights"
+    };
+
+    // The scenes span [-khalf_extent, khalf_extent] on x and z, over the ground at y = 0
+    const float khalf_extent = 10.0f;
+
+    // Triangles of a tessellated sphere, unless the whole scene asks for fewer
+    const unsigned kmax_sphere_triangles = 1024;
+
+    const float kpi = 3.14159265f;
+
+    // Diffuse materials in a few colors and a mirror, which one in ten shapes gets
+    struct Palette {
+      Palette()
+          : diffuse{ std::make_shared<Lambertian>(RGB_spectrum(0.75f, 0.25f, 0.25f)),
+                     std::make_shared<Lambertian>(RGB_spectrum(0.25f, 0.25f, 0.75f)),
+                     std::make_shared<Lambertian>(RGB_spectrum(0.25f, 0.75f, 0.25f)),
+                     std::make_shared<Lambertian>(RGB_spectrum(0.75f, 0.75f, 0.25f)),
+                     std::make_shared<Lambertian>(RGB_spectrum(0.75f)) },
+            mirror(std::make_shared<Mirror>(RGB_spectrum(0.9f))),
+            light(std::make_shared<Lambertian>(RGB_spectrum(1.0f))) {}
+
+      std::shared_ptr<Material> pick(RNG & rng) const
+      {
+        const float ku = rng();
+        if (ku < 0.1f) return mirror;
+        return diffuse[std::min(static_cast<unsigned>((ku - 0.1f) / 0.9f * 5.0f), 4u)];
+      }
+
+      std::shared_ptr<Material> diffuse[5];
+      std::shared_ptr<Material> mirror;
+      std::shared_ptr<Material> light;
+    };
+
+    void add_ground(const Palette & palette, Scene * pscene)
+    {
+      const RGB_spectrum kblack(0.0f);
+      const Vec3 kcorners[4] = {
+        Vec3(khalf_extent * 2.0f, 0.0f, -khalf_extent * 2.0f),
+        Vec3(-khalf_extent * 2.0f, 0.0f, -khalf_extent * 2.0f),
+        Vec3(-khalf_extent * 2.0f, 0.0f, khalf_extent * 2.0f),
+        Vec3(khalf_extent * 2.0f, 0.0f, khalf_extent * 2.0f)
+      };
+      pscene->add_shape(std::make_shared<Triangle>(Transform(), palette.diffuse[4], kblack,
+                                                   kcorners[0], kcorners[1], kcorners[2]));
+      pscene->add_shape(std::make_shared<Triangle>(Transform(), palette.diffuse[4], kblack,
+                                                   kcorners[2], kcorners[3], kcorners[0]));
+    }
+
+    void add_key_light(const Palette & palette, Scene * pscene)
+    {
+      pscene->add_shape(std::make_shared<Sphere>(translate(Vec3(-4.0f, 15.0f, -6.0f)),
+                                                 palette.light, RGB_spectrum(60.0f), 1.5f));
+    }
+
+    // Unit sphere of 4 n^2 triangles, n rings of 2 n segments between the poles
+    void tessellate_sphere(const unsigned n, std::vector<float> * ppositions,
+                           std::vector<std::uint32_t> * pindices)
+    {
+      const unsigned ksegments = 2 * n;
+      std::vector<float> & positions = *ppositions;
+      std::vector<std::uint32_t> & indices = *pindices;
+      positions.clear();
+      indices.clear();
+
+      positions.insert(positions.end(), { 0.0f, 1.0f, 0.0f });
+      for (unsigned ring = 1; ring != n + 1; ++ring) {
+        const float ktheta = kpi * ring / (n + 1);
+        for (unsigned segment = 0; segment != ksegments; ++segment) {
+          const float kphi = 2.0f * kpi * segment / ksegments;
+          positions.insert(positions.end(), { std::sin(ktheta) * std::cos(kphi),
+                                              std::cos(ktheta),
+                                              std::sin(ktheta) * std::sin(kphi) });
+        }
+      }
+      positions.insert(positions.end(), { 0.0f, -1.0f, 0.0f });
+
+      const std::uint32_t kbottom = 1 + n * ksegments;
+      for (unsigned segment = 0; segment != ksegments; ++segment) {
+        const std::uint32_t knext = (segment + 1) % ksegments;
+        indices.insert(indices.end(), { 0, 1 + knext, 1 + segment });
+        for (unsigned ring = 0; ring + 1 < n; ++ring) {
+          const std::uint32_t ka = 1 + ring * ksegments + segment;
+          const std::uint32_t kb = 1 + ring * ksegments + knext;
+          indices.insert(indices.end(), { ka, kb, kb + ksegments, ka, kb + ksegments,
+                                          ka + ksegments });
+        }
+        const std::uint32_t klast_ring = 1 + (n - 1) * ksegments;
+        indices.insert(indices.end(), { klast_ring + segment, klast_ring + knext, kbottom });
+      }
+    }
+
+    // Rings of a tessellated sphere of about triangles triangles
+    unsigned sphere_rings(const unsigned triangles)
+    {
+      return std::max(1u, static_cast<unsigned>(std::sqrt(triangles / 4.0f)));
+    }
+
+    void add_random_spheres(const unsigned count, const Palette & palette, RNG & rng,
+                            Scene * pscene)
+    {
+      // The spheres fill about 5% of the volume whatever their count
+      const float kradius = 2.9f / std::cbrt(static_cast<float>(count));
+      for (unsigned i = 0; i != count; ++i) {
+        const Vec3 kcenter((2.0f * rng() - 1.0f) * (khalf_extent - kradius),
+                           kradius + rng() * 8.0f,
+                           (2.0f * rng() - 1.0f) * (khalf_extent - kradius));
+        pscene->add_shape(std::make_shared<Sphere>(translate(kcenter), palette.pick(rng),
+                                                   RGB_spectrum(0.0f), kradius));
+      }
+    }
+
+    void add_tessellated_spheres(const unsigned count, const Palette & palette, RNG & rng,
+                                 Scene * pscene)
+    {
+      const unsigned krings = sphere_rings(std::min(count, kmax_sphere_triangles));
+      std::vector<float> positions;
+      std::vector<std::uint32_t> indices;
+      tessellate_sphere(krings, &positions, &indices);
+
+      const unsigned knum_spheres = std::max(1u, count / (4 * krings * krings));
+      const float kradius = 2.9f / std::cbrt(static_cast<float>(knum_spheres));
+      for (unsigned i = 0; i != knum_spheres; ++i) {
+        const Vec3 kcenter((2.0f * rng() - 1.0f) * (khalf_extent - kradius),
+                           kradius + rng() * 8.0f,
+                           (2.0f * rng() - 1.0f) * (khalf_extent - kradius));
+        const std::shared_ptr<Triangle_mesh> kpmesh = std::make_shared<Triangle_mesh>(
+            scale(kradius, kradius, kradius) * translate(kcenter), palette.pick(rng),
+            RGB_spectrum(0.0f), positions, indices);
+        pscene->add_shape(kpmesh);
+      }
+    }
+
+    void add_terrain(const unsigned count, const Palette & palette, RNG & rng, Scene * pscene)
+    {
+      const unsigned kn = std::max(1u, static_cast<unsigned>(std::sqrt(count / 2.0f)));
+
+      // A few octaves of waves in random directions
+      const unsigned knum_waves = 12;
+      float frequencies[knum_waves][2], phases[knum_waves], amplitudes[knum_waves];
+      for (unsigned i = 0; i != knum_waves; ++i) {
+        const float kangle = 2.0f * kpi * rng();
+        const float kfrequency = 0.2f * std::pow(1.6f, static_cast<float>(i));
+        frequencies[i][0] = kfrequency * std::cos(kangle);
+        frequencies[i][1] = kfrequency * std::sin(kangle);
+        phases[i] = 2.0f * kpi * rng();
+        amplitudes[i] = 1.5f / kfrequency * 0.2f;
+      }
+
+      std::vector<float> positions;
+      positions.reserve(3 * std::size_t(kn + 1) * (kn + 1));
+      for (unsigned j = 0; j != kn + 1; ++j) {
+        for (unsigned i = 0; i != kn + 1; ++i) {
+          const float kx = -khalf_extent + 2.0f * khalf_extent * i / kn;
+          const float kz = -khalf_extent + 2.0f * khalf_extent * j / kn;
+          float height = 1.5f;
+          for (unsigned w = 0; w != knum_waves; ++w) {
+            height += amplitudes[w] * std::sin(frequencies[w][0] * kx + frequencies[w][1] * kz +
+                                               phases[w]);
+          }
+          positions.insert(positions.end(), { kx, std::max(height, 0.0f), kz });
+        }
+      }
+
+      std::vector<std::uint32_t> indices;
+      indices.reserve(6 * std::size_t(kn) * kn);
+      for (unsigned j = 0; j != kn; ++j) {
+        for (unsigned i = 0; i != kn; ++i) {
+          const std::uint32_t kv = j * (kn + 1) + i;
+          indices.insert(indices.end(), { kv, kv + kn + 1, kv + 1, kv + 1, kv + kn + 1,
+                                          kv + kn + 2 });
+        }
+      }
+
+      const std::shared_ptr<Triangle_mesh> kpmesh = std::make_shared<Triangle_mesh>(
+          Transform(), palette.diffuse[2], RGB_spectrum(0.0f), std::move(positions),
+          std::move(indices));
+      pscene->add_shape(kpmesh);
+    }
+
+    // If moving, each instance hops up by its radius between times 0 and 1
+    void add_instanced_grid(const unsigned count, const bool moving, const Palette & palette,
+                            RNG & rng, Scene * pscene)
+    {
+      std::vector<float> positions;
+      std::vector<std::uint32_t> indices;
+      tessellate_sphere(sphere_rings(kmax_sphere_triangles), &positions, &indices);
+      const std::shared_ptr<Triangle_mesh> kpmesh = std::make_shared<Triangle_mesh>(
+          Transform(), palette.diffuse[0], RGB_spectrum(0.0f), std::move(positions),
+          std::move(indices));
+      const std::shared_ptr<const BVH> kpblas = std::make_shared<BVH>(
+          std::vector<std::shared_ptr<Shape>>(1, kpmesh));
+
+      const unsigned kside = static_cast<unsigned>(std::ceil(std::sqrt(float(count))));
+      const float kcell = 2.0f * (khalf_extent - 1.0f) / kside;
+      for (unsigned i = 0; i != count; ++i) {
+        const float kradius = kcell * (0.25f + 0.15f * rng());
+        const Vec3 kcenter(-khalf_extent + 1.0f + kcell * (i % kside + 0.5f), kradius,
+                           -khalf_extent + 1.0f + kcell * (i / kside + 0.5f));
+        const Transform kinstance_to_world = scale(kradius, kradius, kradius) *
+                                             translate(kcenter);
+        if (!moving) {
+          pscene->add_shape(std::make_shared<Instance>(kinstance_to_world, kpblas));
+          continue;
+        }
+
+        const Transform khopped = kinstance_to_world * translate(Vec3(0.0f, kradius, 0.0f));
+        pscene->add_shape(std::make_shared<Instance>(
+            Animated_transform(kinstance_to_world, 0.0f, khopped, 1.0f), kpblas));
+      }
+    }
+
+    void add_area_lights(const unsigned count, const Palette & palette, RNG & rng,
+                         Scene * pscene)
+    {
+      for (unsigned i = 0; i != 16; ++i) {
+        const float kradius = 0.5f + 0.5f * rng();
+        const Vec3 kcenter(-7.5f + 5.0f * (i % 4), kradius, -7.5f + 5.0f * (i / 4));
+        pscene->add_shape(std::make_shared<Sphere>(translate(kcenter), palette.pick(rng),
+                                                   RGB_spectrum(0.0f), kradius));
+      }
+
+      // The same total power whatever the count, about the key light's on the ground
+      const float kradius = 0.1f;
+      const RGB_spectrum kradiance(4000.0f / count);
+      for (unsigned i = 0; i != count; ++i) {
+        const Vec3 kcenter((2.0f * rng() - 1.0f) * khalf_extent, 3.0f + 2.0f * rng(),
+                           (2.0f * rng() - 1.0f) * khalf_extent);
+        pscene->add_shape(std::make_shared<Sphere>(translate(kcenter), palette.light,
+                                                   kradiance, kradius));
+      }
+    }
+  }
+
+  const char * stress_scene_name(const Stress_scene_type type)
+  {
+    return kscene_names[type];
+  }
+
+  bool parse_stress_scene_type(const std::string & name, Stress_scene_type * ptype)
+  {
+    for (unsigned i = 0; i != knum_stress_scene_types; ++i) {
+      if (name == kscene_names[i]) {
+        *ptype = static_cast<Stress_scene_type>(i);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void add_stress_scene(const Stress_scene_type type, const unsigned count, Scene * pscene,
+                        Render_settings * psettings)
+  {
+    psettings->eye = Vec3(0.0f, 14.0f, -24.0f);
+    psettings->look = Vec3(0.0f, 1.0f, 0.0f);
+    psettings->fov = 45.0f;
+    if (type == Stress_scene_type::kmoving_instances) {
+      psettings->shutter_open = 0.0f;
+      psettings->shutter_close = 1.0f;
+    }
+    if (!pscene) return;
+
+    const unsigned kcount = std::max(count, 1u);
+    const Palette kpalette;
+    RNG rng(kdefault_rng_seed + 2ULL * kcount);
+
+    if (type != Stress_scene_type::kterrain) add_ground(kpalette, pscene);
+    if (type != Stress_scene_type::karea_lights) add_key_light(kpalette, pscene);
+    switch (type) {
+      case Stress_scene_type::krandom_spheres:
+        add_random_spheres(kcount, kpalette, rng, pscene);
+        break;
+      case Stress_scene_type::ktessellated_spheres:
+        add_tessellated_spheres(kcount, kpalette, rng, pscene);
+        break;
+      case Stress_scene_type::kterrain:
+        add_terrain(kcount, kpalette, rng, pscene);
+        break;
+      case Stress_scene_type::kinstanced_grid:
+      case Stress_scene_type::kmoving_instances:
+        add_instanced_grid(kcount, type == Stress_scene_type::kmoving_instances, kpalette, rng,
+                           pscene);
+        break;
+      case Stress_scene_type::karea_lights:
+        add_area_lights(kcount, kpalette, rng, pscene);
+        break;
+      default:
+        break;
+    }
+  }
+}
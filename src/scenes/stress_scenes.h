@@ -0,0 +1,36 @@
+#ifndef LUX_SCENES_STRESS_SCENES_H_
+#define LUX_SCENES_STRESS_SCENES_H_
+
+#include <string>
+
+namespace lux { class Scene; struct Render_settings; }
+
+namespace lux {
+  // Procedural scenes whose size is set by a count, to measure how the BVH build, the
+  // memory and rays/s scale with the primitives and lights. They're generated with a
+  // fixed seed, so a type and count always give the same scene.
+  enum Stress_scene_type {
+    krandom_spheres,       // count spheres scattered over a ground plane
+    ktessellated_spheres,  // Spheres tessellated into meshes, count triangles in total
+    kterrain,              // A height field grid of count triangles
+    kinstanced_grid,       // count instances of a tessellated sphere sharing one BVH
+    kmoving_instances,     // The instanced grid, each instance hopping while the shutter
+                           // is open
+    karea_lights,          // count small spherical lights over a few spheres
+    knum_stress_scene_types
+  };
+
+  // spheres, tessellated_spheres, terrain, instances, moving_instances or lights
+  const char * stress_scene_name(const Stress_scene_type type);
+  bool parse_stress_scene_type(const std::string & name, Stress_scene_type * ptype);
+
+  // Adds the scene to pscene and sets the camera of psettings to look at it. Everything
+  // fits in the same 20 x 20 square, lit by one large light unless it's the area lights
+  // scene, whose lights share the same total power whatever their count. The moving
+  // instances scene also opens the shutter from time 0 to 1. Only the camera and the
+  // shutter are set if pscene is null.
+  void add_stress_scene(const Stress_scene_type type, const unsigned count, Scene * pscene,
+                        Render_settings * psettings);
+}
+
+#endif
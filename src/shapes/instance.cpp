@@ -0,0 +1,100 @@
+#include "shapes/instance.h"
+
+#include <memory>
+
+#include "core/ray.h"
+#include "core/vec2.h"
+#include "core/vec3.h"
+#include "core/bounds3.h"
+#include "core/transform.h"
+#include "core/animated_transform.h"
+#include "core/rgb_spectrum.h"
+#include "core/shape_tables.h"
+#include "core/memory_stats.h"
+#include "accelerators/bvh.h"
+
+namespace lux {
+  Instance::Instance(const Transform & instance_to_world, std::shared_ptr<const BVH> pblas)
+      : Shape(kdefault_shape_index, kdefault_shape_index, kdefault_shape_index),
+        m_instance_to_world(instance_to_world),
+        m_pblas(pblas) {}
+
+  Instance::Instance(const Animated_transform & instance_to_world,
+                     std::shared_ptr<const BVH> pblas)
+      : Shape(kdefault_shape_index, kdefault_shape_index, kdefault_shape_index),
+        m_instance_to_world(instance_to_world),
+        m_pblas(pblas) {}
+
+  bool Instance::intersect(const Ray & ray, float * phit,
+                           Surface_interaction * psurface_interaction) const
+  {
+    if (!psurface_interaction || !phit) return intersect_p(ray);
+
+    if (!m_instance_to_world.is_animated()) {
+      return intersect(ray, m_instance_to_world.get_start_transform(), phit,
+                       psurface_interaction);
+    }
+
+    return intersect(ray, m_instance_to_world.interpolate(ray.get_time()), phit,
+                     psurface_interaction);
+  }
+
+  bool Instance::intersect(const Ray & ray, const Transform & instance_to_world, float * phit,
+                           Surface_interaction * psurface_interaction) const
+  {
+    // Transform Ray to Instance Space, the hit parameter is the same on both spaces
+    const Ray r = instance_to_world.apply_inverse_on_ray(ray);
+
+    if (!m_pblas->intersect(r, phit, psurface_interaction)) return false;
+
+    // Transform the hit point and normal to world space
+    psurface_interaction -> wo_world = Vec3(-ray.get_direction());
+    psurface_interaction -> hit_point =
+        instance_to_world.apply_on_point(psurface_interaction -> hit_point);
+    psurface_interaction -> n =
+        normalize(instance_to_world.apply_on_normal(psurface_interaction -> n));
+
+    // Compute tangent vectors
+    orthonormal_basis(&(psurface_interaction -> s), &(psurface_interaction -> t),
+                      psurface_interaction ->n);
+
+    return true;
+  }
+
+  bool Instance::intersect_p(const Ray & ray) const
+  {
+    // Static instances don't copy their transform
+    if (!m_instance_to_world.is_animated()) {
+      return m_pblas->intersect_p(
+          m_instance_to_world.get_start_transform().apply_inverse_on_ray(ray));
+    }
+
+    const Transform instance_to_world = m_instance_to_world.interpolate(ray.get_time());
+    return m_pblas->intersect_p(instance_to_world.apply_inverse_on_ray(ray));
+  }
+
+  Bounds3 Instance::world_bound() const
+  {
+    return m_instance_to_world.motion_bound(m_pblas->world_bound());
+  }
+
+  RGB_spectrum Instance::sample_li(const Surface_interaction & interaction,
+                                   const Vec2 & u_sample, Vec3 * pwi_world,
+                                   Vec3 * point_on_shape, float * pdf) const
+  {
+    *pdf = 0.0f;
+    return RGB_spectrum(0.0f);
+  }
+
+  float Instance::PDF(const Surface_interaction & interaction, const Vec3 & wi_world) const
+  {
+    return 0.0f;
+  }
+
+  void Instance::add_memory(Memory_stats * pstats) const
+  {
+    add_shape_memory(*this, sizeof(*this) - sizeof(Animated_transform), pstats);
+    pstats->add(Memory_category::ktransform_memory, m_instance_to_world.memory_bytes());
+    if (pstats->first_visit(m_pblas.get())) add_bvh_memory(*m_pblas, pstats);
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef LUX_SHAPES_INSTANCE_H_
+#define LUX_SHAPES_INSTANCE_H_
+
+#include <memory>
+
+#include "core/shape.h"
+#include "core/rgb_spectrum.h"
+#include "core/animated_transform.h"
+
+namespace lux { struct Vec2; struct Vec3; class Ray; struct Surface_interaction;
+                class Transform; class BVH; class Memory_stats; }
+
+// Places a copy of a shape group, stored in a bottom level BVH, in the scene.
+// The BVH is shared by every instance, only the transform is stored per copy, in the
+// instance rather than in the shape tables, whose entries it leaves at the defaults.
+// The transform may be animated, in which case it is interpolated at each
+// ray's time. Shapes reached through an instance are never sampled as area lights.
+namespace lux {
+  class Instance final : public Shape {
+    public:
+      Instance(const Transform & instance_to_world, std::shared_ptr<const BVH> pblas);
+      Instance(const Animated_transform & instance_to_world, std::shared_ptr<const BVH> pblas);
+
+      Instance(const Instance & instance)
+          : Shape(instance),
+            m_instance_to_world(instance.m_instance_to_world),
+            m_pblas(instance.m_pblas) {}
+
+      Instance & operator=(const Instance & instance)
+      {
+        Shape::operator=(instance);
+        m_instance_to_world = instance.m_instance_to_world;
+        m_pblas = instance.m_pblas;
+
+        return *this;
+      }
+
+      virtual bool intersect(const Ray & ray, float * phit,
+                             Surface_interaction * psurface_interaction) const override;
+
+      virtual bool intersect_p(const Ray & ray) const override;
+
+      virtual Bounds3 world_bound() const override;
+
+      virtual RGB_spectrum sample_li(const Surface_interaction & interaction,
+                                     const Vec2 & u_sample, Vec3 * pwi_world,
+                                     Vec3 * point_on_shape, float * pdf) const override;
+
+      virtual float PDF(const Surface_interaction & interaction,
+                        const Vec3 & wi_world) const override;
+
+      // The BVH and its shapes are added by the first instance of it
+      virtual void add_memory(Memory_stats * pstats) const override;
+
+      std::shared_ptr<const BVH> get_blas() const { return m_pblas; }
+      const Animated_transform & get_instance_to_world() const { return m_instance_to_world; }
+
+      // Moves the instance, e.g. between the frames of an animation. The scene's
+      // BVH has to be refit afterwards.
+      void set_instance_to_world(const Animated_transform & instance_to_world)
+      {
+        m_instance_to_world = instance_to_world;
+      }
+
+    private:
+      bool intersect(const Ray & ray, const Transform & instance_to_world, float * phit,
+                     Surface_interaction * psurface_interaction) const;
+
+      Animated_transform m_instance_to_world;
+      std::shared_ptr<const BVH> m_pblas;
+  };
+}
+
+#endif
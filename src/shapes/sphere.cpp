@@ -11,11 +11,101 @@
 #include "core/transform.h"
 #include "core/rgb_spectrum.h"
 #include "core/ray.h"
+#include "core/bounds3.h"
+#include "core/memory_stats.h"
 
 namespace lux {
+  namespace {
+    // object_to_world if it can't be folded into the sphere's center and radius
+    Transform stored_transform(const Transform & object_to_world)
+    {
+      Vec3 center;
+      float scale;
+      if (object_to_world.is_translate_uniform_scale(&center, &scale)) return Transform();
+
+      return object_to_world;
+    }
+  }
+
+  Sphere::Sphere(const Transform & object_to_world,
+                 const std::shared_ptr<Material> & pmaterial,
+                 const RGB_spectrum & emitted_radiance, const float kradius)
+      : Shape(stored_transform(object_to_world), pmaterial, emitted_radiance),
+        m_radius(kradius),
+        m_center_wld(),
+        m_world_space(false)
+  {
+    float kscale;
+    if (object_to_world.is_translate_uniform_scale(&m_center_wld, &kscale)) {
+      m_radius = kscale * kradius;
+      m_world_space = true;
+    }
+    else {
+      m_center_wld = object_to_world.apply_on_point(Vec3(0.0f, 0.0f, 0.0f));
+    }
+  }
+
+  bool Sphere::intersect_world_space(const Ray & ray, float * phit,
+                                     Surface_interaction * psurface_interaction) const
+  {
+    const Vec3 r_o = ray.get_origin() - m_center_wld;
+    const Vec3 r_d = ray.get_direction();
+
+    float a = dot(r_d, r_d);
+    float b = 2 * dot(r_d, r_o);
+    float c = dot(r_o, r_o) - m_radius * m_radius;
+    float discriminant = b * b - 4*a*c;
+
+    if (discriminant < 0) {
+      return false;
+    }
+
+    discriminant = sqrt(discriminant);
+
+    const float q = (b < 0.0f) ?(-.5 * (b - discriminant)) :(-.5 * (b + discriminant));
+    float t0 = q / a;
+    float t1 = c / q;
+
+    if (t0 > t1) {
+      std::swap(t0, t1);
+    }
+
+    if((t0 > ray.get_t_max()) || (t1 <= 0.0f)) {
+      return false;
+    }
+
+    float shapeHit = t0;
+    if (shapeHit <= 0.0f) {
+      shapeHit = t1;
+      if (shapeHit > ray.get_t_max()) {
+        return false;
+      }
+    }
+
+    if (!psurface_interaction || !phit) return true;
+
+    *phit = shapeHit;
+    const Vec3 khit_point = ray(shapeHit);
+
+    psurface_interaction -> wo_world = Vec3(-ray.get_direction());
+    psurface_interaction -> hit_point = khit_point;
+    psurface_interaction -> n = (khit_point - m_center_wld) / m_radius;
+    psurface_interaction -> pshape = this;
+
+    // Compute tangent vectors
+    orthonormal_basis(&(psurface_interaction -> s), &(psurface_interaction -> t),
+                      psurface_interaction ->n);
+
+    psurface_interaction -> pmaterial = get_material();
+
+    return true;
+  }
+
   bool Sphere::intersect(const Ray & ray, float * phit,
                          Surface_interaction * psurface_interaction) const
   {
+    if (m_world_space) return intersect_world_space(ray, phit, psurface_interaction);
+
     // Transform Ray to Object Space
     const Transform & object_to_world = get_object_to_world();
     const Ray r = object_to_world.apply_inverse_on_ray(ray);
@@ -74,39 +164,51 @@ namespace lux {
     return true;
   }
 
+  Bounds3 Sphere::world_bound() const
+  {
+    if (m_world_space) {
+      const Vec3 kextent(m_radius, m_radius, m_radius);
+      return Bounds3(m_center_wld - kextent, m_center_wld + kextent);
+    }
+
+    const Bounds3 kobject_bound(Vec3(-m_radius, -m_radius, -m_radius),
+                                Vec3(m_radius, m_radius, m_radius));
+
+    return get_object_to_world().apply_on_bounds(kobject_bound);
+  }
+
   RGB_spectrum Sphere::sample_li(const Surface_interaction & interaction, const Vec2 & u_sample,
                                  Vec3 *pwi_world, Vec3 * point_on_shape, float * pdf) const
   {
-    const Transform & object_to_world = get_object_to_world();
-    const Vec3 korigin_wld = object_to_world.apply_on_point(Vec3(0.0f, 0.0f, 0.0f));
-    const float kdistance_squared = distance_squared(interaction.hit_point, korigin_wld);
+    const float kdistance_squared = distance_squared(interaction.hit_point, m_center_wld);
+    const float kradius_squared = m_radius * m_radius;
 
     // Check if the point is inside the sphere
-    if (kdistance_squared - kray_epsilon <= m_radius * m_radius) return RGB_spectrum(0.0f);
+    if (kdistance_squared - kray_epsilon <= kradius_squared) return RGB_spectrum(0.0f);
 
-    Vec3 r = normalize(korigin_wld - interaction.hit_point);
+    Vec3 r = normalize(m_center_wld - interaction.hit_point);
     Vec3 p, q;
     orthonormal_basis(&p, &q, r);
 
     // Calculate theta and phi
-    const float ksin_theta_max_squared = m_radius * m_radius / kdistance_squared;
+    const float ksin_theta_max_squared = kradius_squared / kdistance_squared;
     const float kcos_theta_max = std::sqrt(1 - ksin_theta_max_squared);
     const float kcos_theta = (1 - u_sample.x) + u_sample.x * kcos_theta_max;
     const float ksin_theta = std::sqrt(1 - kcos_theta * kcos_theta);
     const float kphi = u_sample.y * 2.0f * kpi; 
 
-    const float dc = distance(interaction.hit_point, korigin_wld);
+    const float dc = distance(interaction.hit_point, m_center_wld);
     const float ds = dc * kcos_theta - 
-                     std::sqrt(m_radius * m_radius - dc * dc * ksin_theta * ksin_theta);
+                     std::sqrt(kradius_squared - dc * dc * ksin_theta * ksin_theta);
 
-    const float kcos_alpha = (dc * dc + m_radius * m_radius - ds * ds) / (2 * dc * m_radius);
+    const float kcos_alpha = (dc * dc + kradius_squared - ds * ds) / (2 * dc * m_radius);
     const float ksin_alpha = std::sqrt(1 - kcos_alpha * kcos_alpha);
 
     const Vec3 normal_wld = ksin_alpha * std::cos(kphi) * (-p) +
                             ksin_alpha * std::sin(kphi) * (-q) + 
                             kcos_alpha * (-r);
 
-    const Vec3 sampled_point_wld = korigin_wld + m_radius * normal_wld;
+    const Vec3 sampled_point_wld = m_center_wld + m_radius * normal_wld;
 
     *pwi_world = normalize(sampled_point_wld - interaction.hit_point);
     *point_on_shape = sampled_point_wld;
@@ -121,13 +223,16 @@ namespace lux {
 
   float Sphere::PDF(const Surface_interaction & interaction, const Vec3 & wi_world) const
   {
-    const Transform & object_to_world = get_object_to_world();
-    const Vec3 korigin_wld = object_to_world.apply_on_point(Vec3(0.0f, 0.0f, 0.0f));
-    const float kdistance_squared = distance_squared(interaction.hit_point, korigin_wld);
+    const float kdistance_squared = distance_squared(interaction.hit_point, m_center_wld);
 
     const float ksin_theta_max_squared = m_radius * m_radius / kdistance_squared;
     const float kcos_theta_max = std::sqrt(1 - ksin_theta_max_squared);
 
     return 1.0f / (2.0f * kpi * (1 - kcos_theta_max));
   }
+
+  void Sphere::add_memory(Memory_stats * pstats) const
+  {
+    add_shape_memory(*this, sizeof(*this), pstats);
+  }
 }
@@ -1,33 +1,38 @@
 #ifndef LUX_SHAPES_SPHERE_H_
 #define LUX_SHAPES_SPHERE_H_
 
+#include <cstdint>
+
 #include <memory>
 
 #include "core/rgb_spectrum.h"
+#include "core/vec3.h"
 #include "core/shape.h"
 
-namespace lux { struct Vec2; struct Vec3; class Ray; struct Surface_interaction;
-                      class Material; class Transform; }
+namespace lux { struct Vec2; class Ray; struct Surface_interaction;
+                      class Material; class Transform; class Memory_stats; }
 
 namespace lux {
   class Sphere final : public Shape {
     public:
-      Sphere(const Transform & object_to_world, std::shared_ptr<Material> pmaterial,
-             const RGB_spectrum & emitted_radiance, const float kradius)
-          : Shape(object_to_world, pmaterial, emitted_radiance), m_radius(kradius) {}
+      // If object_to_world is only a translation and a uniform scale, it is folded into the
+      // sphere's center and radius and the sphere is stored with the identity transform.
+      Sphere(const Transform & object_to_world, const std::shared_ptr<Material> & pmaterial,
+             const RGB_spectrum & emitted_radiance, const float kradius);
 
-      Sphere(const Sphere & sphere) : Shape(sphere), m_radius(sphere.m_radius) {}
 
-      Sphere & operator=(const Sphere & sphere)
-      {
-        Shape::operator=(sphere);
-        m_radius = sphere.m_radius;
+      virtual bool intersect(const Ray & ray, float * phit, 
+                             Surface_interaction * psurface_interaction) const override;
 
-        return *this;
+      // Called by the BVH, skips the second virtual call of the default
+      virtual bool intersect_primitive(const Ray & ray, const std::uint32_t primitive,
+                                       float * phit,
+                                       Surface_interaction * psurface_interaction) const override
+      {
+        return Sphere::intersect(ray, phit, psurface_interaction);
       }
 
-      virtual bool intersect(const Ray & ray, float * phit, 
-                             Surface_interaction * psurface_interaction) const override;
+      virtual Bounds3 world_bound() const override;
 
       virtual RGB_spectrum sample_li(const Surface_interaction & interaction,
                                      const Vec2 & u_sample, Vec3 * pwi_world,
@@ -36,10 +41,23 @@ namespace lux {
       virtual float PDF(const Surface_interaction & interaction,
                         const Vec3 & wi_world) const override;
 
+      virtual void add_memory(Memory_stats * pstats) const override;
+
+      // Object Space radius, the World Space one if is_world_space()
       float get_radius() const { return m_radius; }
+
+      // True if the transform was folded into the center and radius, the sphere is then
+      // intersected directly in World Space
+      bool is_world_space() const { return m_world_space; }
+      const Vec3 & get_world_center() const { return m_center_wld; }
       
     private:
+      bool intersect_world_space(const Ray & ray, float * phit,
+                                 Surface_interaction * psurface_interaction) const;
+
       float m_radius;
+      Vec3 m_center_wld;
+      bool m_world_space;
   };
 }
 
@@ -5,18 +5,15 @@
 #include "core/ray.h"
 #include "core/vec3.h"
 #include "core/rgb_spectrum.h"
+#include "core/bounds3.h"
+#include "core/memory_stats.h"
 
 //TODO: Implement sampling and PDF
 namespace lux {
-  bool Triangle::intersect(const Ray & ray, float *phit,
-                           Surface_interaction *psurface_interaction) const
+  bool intersect_triangle(const Ray & ray, const Vec3 & v1_wld, const Vec3 & v2_wld,
+                          const Vec3 & v3_wld, float * phit,
+                          Surface_interaction * psurface_interaction)
   {
-    // Transform triangle vertices to World Space
-    const Transform & object_to_world = get_object_to_world();
-    const Vec3 v1_wld = object_to_world.apply_on_point(m_v1);
-    const Vec3 v2_wld = object_to_world.apply_on_point(m_v2);
-    const Vec3 v3_wld = object_to_world.apply_on_point(m_v3);
-
     // Compute the plane/triangle normal
     Vec3 normal(cross(v2_wld - v1_wld, v3_wld - v2_wld));
     normal.normalize();
@@ -121,17 +118,107 @@ namespace lux {
     psurface_interaction->wo_world = Vec3(-ray.get_direction());
     psurface_interaction->hit_point = p;
     psurface_interaction->n = normal;
-    psurface_interaction->pshape = this;
 
     // Compute tangent vectors
     orthonormal_basis(&(psurface_interaction -> s), &(psurface_interaction -> t),
                       psurface_interaction ->n);
 
-    psurface_interaction -> pmaterial = get_material();
+    return true;
+  }
+
+  bool Triangle::intersect(const Ray & ray, float *phit,
+                           Surface_interaction *psurface_interaction) const
+  {
+    // Transform triangle vertices to World Space
+    const Transform & object_to_world = get_object_to_world();
+    const Vec3 v1_wld = object_to_world.apply_on_point(m_v1);
+    const Vec3 v2_wld = object_to_world.apply_on_point(m_v2);
+    const Vec3 v3_wld = object_to_world.apply_on_point(m_v3);
+
+    if (!intersect_triangle(ray, v1_wld, v2_wld, v3_wld, phit, psurface_interaction)) {
+      return false;
+    }
+
+    if (psurface_interaction && phit) {
+      psurface_interaction->pshape = this;
+      psurface_interaction -> pmaterial = get_material();
+    }
 
     return true;
   }
 
+  Bounds3 Triangle::world_bound() const
+  {
+    const Transform & object_to_world = get_object_to_world();
+    const Bounds3 kbound(object_to_world.apply_on_point(m_v1));
+
+    return bounds_union(bounds_union(kbound, object_to_world.apply_on_point(m_v2)),
+                        object_to_world.apply_on_point(m_v3));
+  }
+
+  void Triangle::add_memory(Memory_stats * pstats) const
+  {
+    add_shape_memory(*this, sizeof(*this), pstats);
+  }
+
+  // Clips the triangle against each plane of the box in turn, the clipped polygon's
+  // vertices bound the part of the triangle inside it.
+  Bounds3 clipped_triangle_bound(const Vec3 & v1, const Vec3 & v2, const Vec3 & v3,
+                                 const Bounds3 & box)
+  {
+    // Every plane adds at most one vertex to the polygon
+    const unsigned kmax_vertices = 9;
+    Vec3 vertices[2][kmax_vertices];
+    vertices[0][0] = v1;
+    vertices[0][1] = v2;
+    vertices[0][2] = v3;
+    unsigned num_vertices = 3;
+
+    unsigned current = 0;
+    for (unsigned plane = 0; plane != 6 && num_vertices != 0; ++plane) {
+      const unsigned kaxis = plane >> 1;
+      const bool kis_max = plane & 1;
+      const float kposition = box[kis_max][kaxis];
+      const auto inside = [&](const Vec3 & p)
+          {
+            return kis_max ? p[kaxis] <= kposition : p[kaxis] >= kposition;
+          };
+
+      const Vec3 * polygon = vertices[current];
+      Vec3 * clipped = vertices[1 - current];
+      unsigned num_clipped = 0;
+      for (unsigned i = 0; i != num_vertices; ++i) {
+        const Vec3 & a = polygon[i];
+        const Vec3 & b = polygon[(i + 1 == num_vertices) ? 0 : i + 1];
+        if (inside(a)) clipped[num_clipped++] = a;
+        if (inside(a) != inside(b)) {
+          const float kt = (kposition - a[kaxis]) / (b[kaxis] - a[kaxis]);
+          Vec3 p = a + kt * (b - a);
+          p[kaxis] = kposition;
+          clipped[num_clipped++] = p;
+        }
+      }
+
+      num_vertices = num_clipped;
+      current = 1 - current;
+    }
+
+    Bounds3 bounds;
+    for (unsigned i = 0; i != num_vertices; ++i) {
+      bounds = bounds_union(bounds, vertices[current][i]);
+    }
+
+    return bounds_intersect(bounds, box);
+  }
+
+  Bounds3 Triangle::clipped_world_bound(const Bounds3 & box) const
+  {
+    const Transform & object_to_world = get_object_to_world();
+    return clipped_triangle_bound(object_to_world.apply_on_point(m_v1),
+                                  object_to_world.apply_on_point(m_v2),
+                                  object_to_world.apply_on_point(m_v3), box);
+  }
+
   RGB_spectrum Triangle::sample_li(const Surface_interaction & interaction,
                                    const Vec2 & u_sample, Vec3 * pwi_world,
                                    Vec3 * point_on_shape, float * pdf) const
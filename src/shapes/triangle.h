@@ -1,13 +1,29 @@
 #ifndef LUX_SHAPES_TRIANGLE_H
 #define LUX_SHAPES_TRIANGLE_H
 
+#include <cstdint>
+
 #include <memory>
 
 #include "core/shape.h"
 #include "core/vec3.h"
 #include "core/error.h"
 
-namespace lux { class RGB_spectrum; class Ray; class Material; class Transform; }
+namespace lux { class RGB_spectrum; class Ray; class Material; class Transform;
+                class Memory_stats; }
+
+namespace lux {
+  // Intersects the World Space triangle (v1, v2, v3). On a hit, the hit point, normal
+  // and tangents of psurface_interaction are filled, the shape and material are left to
+  // the caller.
+  bool intersect_triangle(const Ray & ray, const Vec3 & v1_wld, const Vec3 & v2_wld,
+                          const Vec3 & v3_wld, float * phit,
+                          Surface_interaction * psurface_interaction);
+
+  // Bounds the part of the triangle (v1, v2, v3) inside box.
+  Bounds3 clipped_triangle_bound(const Vec3 & v1, const Vec3 & v2, const Vec3 & v3,
+                                 const Bounds3 & box);
+}
 
 namespace lux {
   class Triangle : public Shape {
@@ -34,6 +50,17 @@ namespace lux {
       virtual bool intersect(const Ray & ray, float * phit,
                              Surface_interaction *psurface_interation) const override;
 
+      // Called by the BVH, skips the second virtual call of the default
+      virtual bool intersect_primitive(const Ray & ray, const std::uint32_t primitive,
+                                       float * phit,
+                                       Surface_interaction * psurface_interaction) const override
+      {
+        return Triangle::intersect(ray, phit, psurface_interaction);
+      }
+
+      virtual Bounds3 world_bound() const override;
+      virtual Bounds3 clipped_world_bound(const Bounds3 & box) const override;
+
       virtual RGB_spectrum sample_li(const Surface_interaction & interaction,
                                      const Vec2 & u_sample, Vec3 * pwi_world,
                                      Vec3 * point_on_shape, float * pdf) const override;
@@ -41,6 +68,8 @@ namespace lux {
       virtual float PDF(const Surface_interaction & interaction,
                         const Vec3 & wi_world) const override;
 
+      virtual void add_memory(Memory_stats * pstats) const override;
+
       const Vec3 & operator[](const unsigned i) const;
       Vec3 & operator[](const unsigned i);
 
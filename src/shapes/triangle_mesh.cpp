@@ -0,0 +1,300 @@
+#include "shapes/triangle_mesh.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <atomic>
+
+#include "core/ray.h"
+#include "core/vec2.h"
+#include "core/vec3.h"
+#include "core/bounds3.h"
+#include "core/morton.h"
+#include "core/mapped_file.h"
+#include "core/memory_stats.h"
+#include "core/parallel.h"
+#include "shapes/triangle.h"
+
+namespace lux {
+  namespace {
+    const char kmagic[8] = { 'L', 'U', 'X', 'M', 'E', 'S', 'H', '\0' };
+    const std::uint32_t kversion = 1;
+
+    struct Header {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t pad;
+      std::uint64_t num_vertices;
+      std::uint64_t num_triangles;
+    };
+  }
+
+  Triangle_mesh::Triangle_mesh(const Transform & object_to_world,
+                               std::shared_ptr<Material> pmaterial,
+                               const RGB_spectrum & emitted_radiance,
+                               std::vector<float> positions, std::vector<std::uint32_t> indices)
+      : Shape(object_to_world, pmaterial, emitted_radiance),
+        m_positions(std::move(positions)),
+        m_indices(std::move(indices)),
+        m_pfile(),
+        m_ppositions(m_positions.data()),
+        m_num_vertices(m_positions.size() / 3),
+        m_pindices(m_indices.data()),
+        m_num_triangles(m_indices.size() / 3)
+  {
+    ASSERT(m_indices.size() / 3 <= std::numeric_limits<std::uint32_t>::max(),
+           "Too many triangles in a mesh");
+  }
+
+  Triangle_mesh::Triangle_mesh(const Transform & object_to_world,
+                               std::shared_ptr<Material> pmaterial,
+                               const RGB_spectrum & emitted_radiance,
+                               std::shared_ptr<const Mapped_file> pfile, const float * ppositions,
+                               const std::size_t num_vertices, const std::uint32_t * pindices,
+                               const std::size_t num_triangles)
+      : Shape(object_to_world, pmaterial, emitted_radiance),
+        m_positions(),
+        m_indices(),
+        m_pfile(pfile),
+        m_ppositions(ppositions),
+        m_num_vertices(num_vertices),
+        m_pindices(pindices),
+        m_num_triangles(num_triangles)
+  {
+    ASSERT(num_triangles <= std::numeric_limits<std::uint32_t>::max(),
+           "Too many triangles in a mesh");
+  }
+
+  void Triangle_mesh::world_vertices(const std::size_t i, Vec3 * pv1, Vec3 * pv2,
+                                     Vec3 * pv3) const
+  {
+    const Transform & object_to_world = get_object_to_world();
+    *pv1 = object_to_world.apply_on_point(vertex(vertex_index(i, 0)));
+    *pv2 = object_to_world.apply_on_point(vertex(vertex_index(i, 1)));
+    *pv3 = object_to_world.apply_on_point(vertex(vertex_index(i, 2)));
+  }
+
+  bool Triangle_mesh::intersect(const Ray & ray, float * phit,
+                                Surface_interaction * psurface_interaction) const
+  {
+    // Each hit shortens the ray, which is restored afterwards
+    const float kt_max = ray.get_t_max();
+    bool hit = false;
+    for (std::uint32_t i = 0; i != m_num_triangles; ++i) {
+      float t;
+      if (!intersect_primitive(ray, i, phit ? &t : nullptr, psurface_interaction)) continue;
+      hit = true;
+      if (!phit) break;
+      *phit = t;
+      ray.set_t_max(t);
+    }
+    ray.set_t_max(kt_max);
+
+    return hit;
+  }
+
+  Bounds3 Triangle_mesh::world_bound() const
+  {
+    Bounds3 bounds;
+    for (std::uint32_t i = 0; i != m_num_triangles; ++i) {
+      bounds = bounds_union(bounds, primitive_world_bound(i));
+    }
+
+    return bounds;
+  }
+
+  Bounds3 Triangle_mesh::primitive_world_bound(const std::uint32_t primitive) const
+  {
+    Vec3 v1_wld, v2_wld, v3_wld;
+    world_vertices(primitive, &v1_wld, &v2_wld, &v3_wld);
+
+    return bounds_union(bounds_union(Bounds3(v1_wld), v2_wld), v3_wld);
+  }
+
+  Bounds3 Triangle_mesh::clipped_primitive_bound(const std::uint32_t primitive,
+                                                 const Bounds3 & box) const
+  {
+    Vec3 v1_wld, v2_wld, v3_wld;
+    world_vertices(primitive, &v1_wld, &v2_wld, &v3_wld);
+
+    return clipped_triangle_bound(v1_wld, v2_wld, v3_wld, box);
+  }
+
+  bool Triangle_mesh::intersect_primitive(const Ray & ray, const std::uint32_t primitive,
+                                          float * phit,
+                                          Surface_interaction * psurface_interaction) const
+  {
+    Vec3 v1_wld, v2_wld, v3_wld;
+    world_vertices(primitive, &v1_wld, &v2_wld, &v3_wld);
+
+    if (!intersect_triangle(ray, v1_wld, v2_wld, v3_wld, phit, psurface_interaction)) {
+      return false;
+    }
+
+    if (psurface_interaction && phit) {
+      psurface_interaction -> pshape = this;
+      psurface_interaction -> pmaterial = get_material();
+    }
+
+    return true;
+  }
+
+  RGB_spectrum Triangle_mesh::sample_li(const Surface_interaction & interaction,
+                                        const Vec2 & u_sample, Vec3 * pwi_world,
+                                        Vec3 * point_on_shape, float * pdf) const
+  {
+    *pdf = 0.0f;
+    return RGB_spectrum(0.0f);
+  }
+
+  float Triangle_mesh::PDF(const Surface_interaction & interaction, const Vec3 & wi_world) const
+  {
+    return 0.0f;
+  }
+
+  void Triangle_mesh::add_memory(Memory_stats * pstats) const
+  {
+    add_shape_memory(*this, sizeof(*this) + m_positions.capacity() * sizeof(float) +
+                            m_indices.capacity() * sizeof(std::uint32_t), pstats);
+  }
+
+  void morton_order_triangles(std::vector<float> * ppositions,
+                              std::vector<std::uint32_t> * pindices)
+  {
+    std::vector<float> & positions = *ppositions;
+    std::vector<std::uint32_t> & indices = *pindices;
+    const std::size_t knum_triangles = indices.size() / 3;
+    const std::size_t knum_vertices = positions.size() / 3;
+
+    const auto vertex = [&positions](const std::uint32_t i)
+        {
+          return Vec3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+        };
+
+    std::vector<Vec3> centroids(knum_triangles);
+    Bounds3 centroid_bounds;
+    for (std::size_t i = 0; i != knum_triangles; ++i) {
+      centroids[i] = (1.0f / 3.0f) * (vertex(indices[3 * i]) + vertex(indices[3 * i + 1]) +
+                                      vertex(indices[3 * i + 2]));
+      centroid_bounds = bounds_union(centroid_bounds, centroids[i]);
+    }
+
+    std::vector<std::uint64_t> keys(knum_triangles);
+    for (std::size_t i = 0; i != knum_triangles; ++i) {
+      const std::uint64_t kcode = morton_code_3D(centroid_bounds.offset(centroids[i]));
+      keys[i] = (kcode << 32) | i;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    const std::uint32_t kunused = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> new_vertex_index(knum_vertices, kunused);
+    std::vector<float> sorted_positions;
+    std::vector<std::uint32_t> sorted_indices;
+    sorted_positions.reserve(positions.size());
+    sorted_indices.reserve(indices.size());
+    for (std::size_t i = 0; i != knum_triangles; ++i) {
+      const std::size_t ktriangle = keys[i] & 0xffffffff;
+      for (unsigned v = 0; v != 3; ++v) {
+        const std::uint32_t kold_index = indices[3 * ktriangle + v];
+        if (new_vertex_index[kold_index] == kunused) {
+          new_vertex_index[kold_index] = sorted_positions.size() / 3;
+          sorted_positions.insert(sorted_positions.end(), &positions[3 * kold_index],
+                                  &positions[3 * kold_index] + 3);
+        }
+        sorted_indices.push_back(new_vertex_index[kold_index]);
+      }
+    }
+
+    // Vertices no triangle uses are dropped
+    positions.swap(sorted_positions);
+    indices.swap(sorted_indices);
+  }
+
+  bool save_mesh_file(const std::string & path, const std::vector<float> & positions,
+                      const std::vector<std::uint32_t> & indices)
+  {
+    Header header;
+    std::memcpy(header.magic, kmagic, sizeof(kmagic));
+    header.version = kversion;
+    header.pad = 0;
+    header.num_vertices = positions.size() / 3;
+    header.num_triangles = indices.size() / 3;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(positions.data()),
+               header.num_vertices * 3 * sizeof(float));
+    file.write(reinterpret_cast<const char *>(indices.data()),
+               header.num_triangles * 3 * sizeof(std::uint32_t));
+    file.close();
+
+    return static_cast<bool>(file);
+  }
+
+  bool mesh_indices_valid(const std::uint32_t * pindices, const std::size_t num_triangles,
+                          const std::size_t num_vertices, const unsigned num_threads)
+  {
+    std::atomic<bool> valid(true);
+    parallel_for(num_triangles, [&](std::size_t first, std::size_t last)
+        {
+          for (std::size_t i = 3 * first; i != 3 * last; ++i) {
+            if (pindices[i] >= num_vertices) {
+              valid = false;
+              return;
+            }
+          }
+        }, num_threads);
+
+    return valid;
+  }
+
+  std::shared_ptr<Triangle_mesh> load_mesh_file(const std::string & path,
+                                                const Transform & object_to_world,
+                                                std::shared_ptr<Material> pmaterial,
+                                                const RGB_spectrum & emitted_radiance,
+                                                unsigned num_threads)
+  {
+    std::shared_ptr<const Mapped_file> pfile = std::make_shared<const Mapped_file>(path);
+    if (!pfile->is_open() || pfile->size() < sizeof(Header)) return nullptr;
+
+    Header header;
+    std::memcpy(&header, pfile->data(), sizeof(header));
+    if (std::memcmp(header.magic, kmagic, sizeof(kmagic)) != 0 || header.version != kversion) {
+      return nullptr;
+    }
+
+    const std::size_t kpositions_size = 3 * sizeof(float);
+    const std::size_t kindices_size = 3 * sizeof(std::uint32_t);
+    const std::size_t kavailable = pfile->size() - sizeof(header);
+    if (header.num_vertices > kavailable / kpositions_size ||
+        header.num_triangles > (kavailable - header.num_vertices * kpositions_size) /
+                               kindices_size ||
+        header.num_triangles > std::numeric_limits<std::uint32_t>::max()) {
+      return nullptr;
+    }
+
+    // The header and both arrays are 4 byte aligned inside the page aligned mapping
+    const unsigned char * pdata = pfile->data() + sizeof(header);
+    const float * ppositions = reinterpret_cast<const float *>(pdata);
+    const std::uint32_t * pindices =
+        reinterpret_cast<const std::uint32_t *>(pdata + header.num_vertices * kpositions_size);
+
+    // Reads the index array in, which the BVH build does next anyway
+    if (!mesh_indices_valid(pindices, header.num_triangles, header.num_vertices, num_threads)) {
+      return nullptr;
+    }
+
+    return std::make_shared<Triangle_mesh>(object_to_world, pmaterial, emitted_radiance, pfile,
+                                           ppositions, header.num_vertices, pindices,
+                                           header.num_triangles);
+  }
+}
@@ -0,0 +1,143 @@
+#ifndef LUX_SHAPES_TRIANGLE_MESH_H_
+#define LUX_SHAPES_TRIANGLE_MESH_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "core/shape.h"
+#include "core/vec3.h"
+#include "core/transform.h"
+#include "core/rgb_spectrum.h"
+#include "core/error.h"
+
+namespace lux { class Ray; class Material; class Mapped_file; struct Vec2;
+                class Memory_stats; }
+
+namespace lux {
+  // Indexed triangle mesh. The mesh is a single shape whose triangles are the primitives
+  // the BVH is built over, so its leaves refer to (mesh, triangle index) pairs and no
+  // object is allocated per triangle. The position and index arrays are either owned by
+  // the mesh or point into a memory mapped mesh file, whose pages are only read in when
+  // traversal touches them, so meshes larger than the available memory can be rendered.
+  // Vertices are transformed to World Space when needed, like Triangle does.
+  class Triangle_mesh final : public Shape {
+    public:
+      // positions holds 3 floats per vertex, indices 3 vertex indices per triangle
+      Triangle_mesh(const Transform & object_to_world, std::shared_ptr<Material> pmaterial,
+                    const RGB_spectrum & emitted_radiance, std::vector<float> positions,
+                    std::vector<std::uint32_t> indices);
+
+      // References arrays inside pfile, which is kept mapped while the mesh lives
+      Triangle_mesh(const Transform & object_to_world, std::shared_ptr<Material> pmaterial,
+                    const RGB_spectrum & emitted_radiance,
+                    std::shared_ptr<const Mapped_file> pfile, const float * ppositions,
+                    const std::size_t num_vertices, const std::uint32_t * pindices,
+                    const std::size_t num_triangles);
+
+      // The arrays may point into the mesh's own vectors
+      Triangle_mesh(const Triangle_mesh &) = delete;
+      Triangle_mesh & operator=(const Triangle_mesh &) = delete;
+
+      // Test and bound every triangle, the BVH handles them one at a time instead
+      virtual bool intersect(const Ray & ray, float * phit,
+                             Surface_interaction * psurface_interaction) const override;
+      virtual Bounds3 world_bound() const override;
+
+      virtual std::uint32_t num_primitives() const override { return m_num_triangles; }
+
+      virtual Bounds3 primitive_world_bound(const std::uint32_t primitive) const override;
+      virtual Bounds3 clipped_primitive_bound(const std::uint32_t primitive,
+                                              const Bounds3 & box) const override;
+
+      virtual bool intersect_primitive(const Ray & ray, const std::uint32_t primitive,
+                                       float * phit,
+                                       Surface_interaction * psurface_interaction) const override;
+      virtual bool intersect_p_primitive(const Ray & ray,
+                                         const std::uint32_t primitive) const override
+      {
+        return intersect_primitive(ray, primitive, nullptr, nullptr);
+      }
+
+      virtual RGB_spectrum sample_li(const Surface_interaction & interaction,
+                                     const Vec2 & u_sample, Vec3 * pwi_world,
+                                     Vec3 * point_on_shape, float * pdf) const override;
+
+      virtual float PDF(const Surface_interaction & interaction,
+                        const Vec3 & wi_world) const override;
+
+      // The mesh object and the arrays it owns
+      virtual void add_memory(Memory_stats * pstats) const override;
+
+      std::size_t num_vertices() const { return m_num_vertices; }
+      std::size_t num_triangles() const { return m_num_triangles; }
+
+      // 3 floats per vertex and 3 vertex indices per triangle, e.g. to save the mesh
+      const float * get_positions() const { return m_ppositions; }
+      const std::uint32_t * get_indices() const { return m_pindices; }
+
+      // Object Space position of vertex i
+      Vec3 vertex(const std::size_t i) const;
+
+      // Index of vertex v, in [0, 3), of triangle i
+      std::uint32_t vertex_index(const std::size_t i, const unsigned v) const;
+
+    private:
+      void world_vertices(const std::size_t i, Vec3 * pv1, Vec3 * pv2, Vec3 * pv3) const;
+
+      std::vector<float> m_positions;
+      std::vector<std::uint32_t> m_indices;
+      std::shared_ptr<const Mapped_file> m_pfile;
+
+      const float * m_ppositions;
+      std::size_t m_num_vertices;
+      const std::uint32_t * m_pindices;
+      std::uint32_t m_num_triangles;
+  };
+
+  inline Vec3 Triangle_mesh::vertex(const std::size_t i) const
+  {
+    ASSERT(i < m_num_vertices, "Trying to access a non existent mesh vertex");
+
+    const float * p = m_ppositions + 3 * i;
+    return Vec3(p[0], p[1], p[2]);
+  }
+
+  inline std::uint32_t Triangle_mesh::vertex_index(const std::size_t i, const unsigned v) const
+  {
+    ASSERT(i < m_num_triangles && v < 3, "Trying to access a non existent mesh vertex");
+
+    return m_pindices[3 * i + v];
+  }
+
+  // Sorts the triangles along a Morton curve over their centroids, then renumbers the
+  // vertices in the order the triangles first use them. Neighbouring triangles end up
+  // close in memory, so BVH leaves that are close in space share pages.
+  void morton_order_triangles(std::vector<float> * ppositions,
+                              std::vector<std::uint32_t> * pindices);
+
+  // True if the num_triangles triangles of pindices only reference vertices below
+  // num_vertices. The indices are checked in one chunk per thread, passing 0 as num_threads
+  // uses every core.
+  bool mesh_indices_valid(const std::uint32_t * pindices, const std::size_t num_triangles,
+                          const std::size_t num_vertices, const unsigned num_threads);
+
+  // The mesh file format is a 32 byte header followed by the positions, 3 floats per
+  // vertex, and the indices, 3 per triangle, both in native byte order, so the arrays are
+  // used straight from the mapped file.
+  bool save_mesh_file(const std::string & path, const std::vector<float> & positions,
+                      const std::vector<std::uint32_t> & indices);
+
+  // Returns nullptr if the file can't be mapped or isn't a valid mesh file, including
+  // when a triangle references a vertex that doesn't exist, see mesh_indices_valid.
+  std::shared_ptr<Triangle_mesh> load_mesh_file(const std::string & path,
+                                                const Transform & object_to_world,
+                                                std::shared_ptr<Material> pmaterial,
+                                                const RGB_spectrum & emitted_radiance,
+                                                unsigned num_threads = 0);
+}
+
+#endif